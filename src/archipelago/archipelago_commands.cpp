@@ -1,9 +1,13 @@
 #include "archipelago_socket.h"
+#include "archipelago_outbox.h"
+#include "archipelago_integration.h"
 #include "c_dispatch.h"
 #include "c_cvars.h"
 #include "doomtype.h"
+#include "serializer.h"
 #include <memory>
 #include <sstream>
+#include <chrono>
 
 
 // Add socket headers for raw test command
@@ -28,6 +32,9 @@
 // Global Archipelago socket instance
 std::unique_ptr<ArchipelagoSocket> g_archipelagoSocket;
 
+// Outgoing checks outlive the socket, they are part of the savegame.
+static ArchipelagoOutbox s_outbox;
+
 // CVars for Archipelago settings
 CVAR(String, archipelago_host, "localhost", CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
 CVAR(Int, archipelago_port, 38281, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
@@ -59,55 +66,197 @@ void Archipelago_Init() {
 // Shutdown Archipelago system
 void Archipelago_Shutdown() {
     if (g_archipelagoSocket) {
+        s_outbox.Flush(*g_archipelagoSocket, true);
         g_archipelagoSocket->Disconnect();
         g_archipelagoSocket.reset();
     }
 }
 
+// Time in milliseconds the game thread may spend on received packets per
+// frame. Whatever is left over waits in the queue until the next frame.
+CVAR(Float, archipelago_budget, 2.f, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+// A ReceivedItems packet can be too big for one frame, so it is kept here
+// until all of its items have been handled.
+static ArchipelagoMessage s_currentMessage;
+static size_t s_currentItem;
+static bool s_hasCurrentMessage;
+static uint64_t s_messagesProcessed;
+static uint64_t s_itemsProcessed;
+
+// The server resends every item from index 0 after connecting, only the
+// ones past this are new. The index belongs to one seed and slot and is
+// stored in the savegame along with them.
+static int s_nextItemIndex;
+static FString s_itemSlot;      // "seed/slot", empty before the first Connected
+
+// Returns false if the budget ran out before the message was done.
+template <typename Budget>
+static bool HandleMessage(ArchipelagoMessage& msg, Budget overBudget) {
+    if (archipelago_debug && s_currentItem == 0) {
+        Printf("Archipelago: Received message type %d, size %zu\n", 
+               static_cast<int>(msg.type), msg.data.size());
+    }
+    
+    // Handle different message types
+    switch (msg.type) {
+        case ArchipelagoMessageType::CONNECTED:
+            Printf(TEXTCOLOR_GREEN "Archipelago: Successfully connected as '%s'\n", 
+                   g_archipelagoSocket->GetSlotName().c_str());
+            if (archipelago_debug) {
+                Printf("Archipelago: Slot %d, %zu locations checked, %zu missing\n", msg.slot,
+                       msg.checkedLocations.size(), msg.missingLocations.size());
+            }
+            {
+                FString slot;
+                slot.Format("%s/%d", msg.seedName.c_str(), msg.slot);
+                if (slot.Compare(s_itemSlot) != 0) {
+                    // Another multiworld or slot, all its items are new.
+                    if (archipelago_debug && s_itemSlot.IsNotEmpty()) {
+                        Printf("Archipelago: Slot changed from %s to %s, item index reset\n",
+                               s_itemSlot.GetChars(), slot.GetChars());
+                    }
+                    s_itemSlot = slot;
+                    s_nextItemIndex = 0;
+                }
+            }
+            s_outbox.Resync(msg.checkedLocations);
+            break;
+            
+        case ArchipelagoMessageType::ROOM_UPDATE:
+            s_outbox.Acknowledge(msg.checkedLocations);
+            break;
+            
+        case ArchipelagoMessageType::REJECTED:
+            Printf(TEXTCOLOR_RED "Archipelago: Connection rejected: %s\n", msg.data.c_str());
+            g_archipelagoSocket->Disconnect();
+            break;
+            
+        case ArchipelagoMessageType::DATA:
+            for (; s_currentItem < msg.items.size(); s_currentItem++) {
+                if (overBudget()) {
+                    return false;
+                }
+                const auto& item = msg.items[s_currentItem];
+                int index = msg.itemIndex + (int)s_currentItem;
+                if (index >= s_nextItemIndex) {
+                    ArchipelagoEvents::OnItemReceived(item.item, item.itemName, item.player, item.locationName);
+                    s_nextItemIndex = index + 1;
+                }
+                s_itemsProcessed++;
+            }
+            if (archipelago_debug) {
+                Printf("Archipelago: Received %zu items\n", msg.items.size());
+            }
+            break;
+            
+        case ArchipelagoMessageType::PRINT:
+        case ArchipelagoMessageType::PRINT_JSON:
+            Printf("Archipelago: %s\n", msg.data.c_str());
+            break;
+            
+        case ArchipelagoMessageType::MSG_ERROR:
+            Printf(TEXTCOLOR_RED "Archipelago error: %s\n", msg.data.c_str());
+            break;
+            
+        default:
+            if (archipelago_debug) {
+                Printf("Archipelago: Unhandled message type %d\n", static_cast<int>(msg.type));
+            }
+            break;
+    }
+    return true;
+}
+
 // Process incoming messages (call from main game loop)
 void Archipelago_ProcessMessages() {
-    if (!g_archipelagoSocket || !g_archipelagoSocket->IsConnected()) {
+    if (!g_archipelagoSocket) {
         return;
     }
     
-    ArchipelagoMessage msg;
-    while (g_archipelagoSocket->ReceiveMessage(msg)) {
-        if (archipelago_debug) {
-            Printf("Archipelago: Received message type %d, size %zu\n", 
-                   static_cast<int>(msg.type), msg.data.size());
+    g_archipelagoSocket->Update();
+    if (!g_archipelagoSocket->IsConnected()) {
+        s_hasCurrentMessage = false;
+        return;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    auto budget = std::chrono::microseconds(static_cast<int>(archipelago_budget * 1000));
+    auto overBudget = [&]() {
+        return archipelago_budget > 0 && std::chrono::steady_clock::now() - start >= budget;
+    };
+    
+    for (;;) {
+        if (!s_hasCurrentMessage) {
+            if (!g_archipelagoSocket->ReceiveMessage(s_currentMessage)) {
+                break;
+            }
+            s_hasCurrentMessage = true;
+            s_currentItem = 0;
         }
         
-        // Handle different message types
-        switch (msg.type) {
-            case ArchipelagoMessageType::CONNECTED:
-                Printf(TEXTCOLOR_GREEN "Archipelago: Successfully connected as '%s'\n", 
-                       g_archipelagoSocket->GetSlotName().c_str());
-                break;
-                
-            case ArchipelagoMessageType::REJECTED:
-                Printf(TEXTCOLOR_RED "Archipelago: Connection rejected: %s\n", msg.data.c_str());
-                g_archipelagoSocket->Disconnect();
-                break;
-                
-            case ArchipelagoMessageType::DATA:
-                Printf("Archipelago: Data received: %s\n", msg.data.c_str());
-                break;
-                
-            case ArchipelagoMessageType::PRINT:
-            case ArchipelagoMessageType::PRINT_JSON:
-                Printf("Archipelago: %s\n", msg.data.c_str());
-                break;
-                
-            case ArchipelagoMessageType::MSG_ERROR:
-                Printf(TEXTCOLOR_RED "Archipelago error: %s\n", msg.data.c_str());
-                break;
-                
-            default:
-                if (archipelago_debug) {
-                    Printf("Archipelago: Unhandled message type %d\n", static_cast<int>(msg.type));
-                }
-                break;
+        if (!HandleMessage(s_currentMessage, overBudget)) {
+            break;
         }
+        s_hasCurrentMessage = false;
+        s_messagesProcessed++;
+        
+        // HandleMessage may have disconnected
+        if (!g_archipelagoSocket->IsConnected() || overBudget()) {
+            break;
+        }
+    }
+    
+    s_outbox.Flush(*g_archipelagoSocket);
+}
+
+// Checks are batched, see ArchipelagoOutbox.
+void Archipelago_CheckLocation(int64_t location) {
+    s_outbox.CheckLocation(location);
+    
+    const char* name = nullptr;
+    if (g_archipelagoSocket) {
+        name = g_archipelagoSocket->GetDataPackages().GetLocationName(location, g_archipelagoSocket->GetSlotGame());
+    }
+    ArchipelagoEvents::OnLocationChecked(location, name);
+}
+
+namespace ArchipelagoEvents {
+    void OnItemReceived(int64_t itemId, const char* itemName, int fromPlayer, const char* locationName) {
+        if (itemName == nullptr) {
+            Printf("Archipelago: Received item %lld\n", (long long)itemId);
+        } else if (locationName == nullptr || !archipelago_debug) {
+            Printf("Archipelago: Received %s\n", itemName);
+        } else {
+            Printf("Archipelago: Received %s from %s, player %d\n", itemName, locationName, fromPlayer);
+        }
+    }
+    
+    void OnLocationChecked(int64_t locationId, const char* locationName) {
+        if (locationName != nullptr) {
+            Printf("Archipelago: Checked %s\n", locationName);
+        } else if (archipelago_debug) {
+            Printf("Archipelago: Checked location %lld\n", (long long)locationId);
+        }
+    }
+}
+
+void Archipelago_SetStatus(int status) {
+    s_outbox.SetStatus(status);
+}
+
+void Archipelago_Serialize(FSerializer& arc) {
+    if (arc.BeginObject("archipelago")) {
+        arc("itemslot", s_itemSlot)
+            ("nextitem", s_nextItemIndex);
+        s_outbox.Serialize(arc);
+        arc.EndObject();
+    } else if (arc.isReading()) {
+        // Saved without Archipelago, or before it was stored. Don't keep
+        // the state of whatever was played before the load.
+        s_outbox.Clear();
+        s_itemSlot = "";
+        s_nextItemIndex = 0;
     }
 }
 
@@ -145,8 +294,9 @@ CCMD(archipelago_connect) {
     // Parse host:port if provided
     if (argv.argc() >= 3) {
         std::string hostPort = argv[2];
-        size_t colonPos = hostPort.find(':');
-        if (colonPos != std::string::npos) {
+        // The last colon, the host may start with ws:// or wss://
+        size_t colonPos = hostPort.rfind(':');
+        if (colonPos != std::string::npos && hostPort.compare(colonPos, 3, "://") != 0) {
             host = hostPort.substr(0, colonPos);
             port = static_cast<uint16_t>(atoi(hostPort.substr(colonPos + 1).c_str()));
         } else {
@@ -170,7 +320,7 @@ CCMD(archipelago_connect) {
 }
 
 CCMD(archipelago_disconnect) {
-    if (!g_archipelagoSocket || !g_archipelagoSocket->IsConnected()) {
+    if (!g_archipelagoSocket || g_archipelagoSocket->GetState() == ArchipelagoConnectionState::DISCONNECTED) {
         Printf("Not connected to Archipelago server\n");
         return;
     }
@@ -188,6 +338,9 @@ CCMD(archipelago_status) {
     if (g_archipelagoSocket->IsConnected()) {
         Printf(TEXTCOLOR_GREEN "Status: Connected\n");
         Printf("  %s\n", g_archipelagoSocket->GetConnectionInfo().c_str());
+    } else if (g_archipelagoSocket->GetState() != ArchipelagoConnectionState::DISCONNECTED) {
+        Printf(TEXTCOLOR_YELLOW "Status: Connecting\n");
+        Printf("  %s\n", g_archipelagoSocket->GetConnectionInfo().c_str());
     } else {
         Printf(TEXTCOLOR_ORANGE "Status: Not connected\n");
         Printf("  Default server: %s:%d\n", (const char*)archipelago_host, (int)archipelago_port);
@@ -195,6 +348,11 @@ CCMD(archipelago_status) {
                strlen(archipelago_slot) > 0 ? (const char*)archipelago_slot : "<not set>");
     }
     
+    Printf("  Backlog: %d packets (peak %d), %llu packets and %llu items processed\n",
+           g_archipelagoSocket->GetBacklog(), g_archipelagoSocket->GetPeakBacklog(),
+           (unsigned long long)s_messagesProcessed, (unsigned long long)s_itemsProcessed);
+    s_outbox.PrintStats();
+    
     Printf("\nSettings:\n");
     Printf("  Auto-connect: %s\n", archipelago_autoconnect ? "enabled" : "disabled");
     Printf("  Debug mode: %s\n", archipelago_debug ? "enabled" : "disabled");
@@ -465,6 +623,8 @@ CCMD(archipelago_help) {
     Printf("    Test connection to current host:port\n");
     Printf(TEXTCOLOR_GOLD "  archipelago_test_raw [host:port]\n");
     Printf("    Raw WebSocket connection test\n");
+    Printf(TEXTCOLOR_GOLD "  archipelago_standin start [port] | stop | drop | mute | refuse\n");
+    Printf("    Local test server, connect to it with ws://localhost:port\n");
     Printf("\n=== CVars ===\n");
     Printf("  archipelago_host - Server hostname (current: %s)\n", 
            (const char*)archipelago_host);
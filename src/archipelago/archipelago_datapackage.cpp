@@ -0,0 +1,396 @@
+#include "archipelago_datapackage.h"
+#include "c_cvars.h"
+#include "doomtype.h"
+#include "cmdlib.h"
+#include "files.h"
+#include "i_specialpaths.h"
+#include "utf8.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+EXTERN_CVAR(Bool, archipelago_debug)
+
+static const char DATAPACKAGE_MAGIC[4] = { 'A', 'P', 'D', 'P' };
+static const uint32_t DATAPACKAGE_VERSION = 1;
+
+struct ArchipelagoDataPackage::Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t numItems;
+    uint32_t numLocations;
+    uint32_t itemSlots;         // power of two
+    uint32_t locationSlots;     // power of two
+    uint32_t namesSize;
+    uint32_t reserved;
+};
+
+struct ArchipelagoDataPackage::Entry {
+    int64_t id;
+    uint32_t name;              // offset into the names
+    uint32_t reserved;
+};
+
+static_assert(sizeof(int64_t) + 2 * sizeof(uint32_t) == 16, "DataPackage entries must be 16 bytes");
+
+static uint32_t HashID(int64_t id) {
+    uint64_t h = (uint64_t)id;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+// At most half full so probe chains stay short.
+static uint32_t SlotCount(uint32_t entries) {
+    uint32_t slots = 16;
+    while (slots < entries * 2) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+ArchipelagoDataPackage::~ArchipelagoDataPackage() {
+    Unmap();
+}
+
+//==========================================================================
+//
+// Build
+//
+// Converts one game of a DataPackage reply into the cache file layout.
+//
+//==========================================================================
+
+std::vector<uint8_t> ArchipelagoDataPackage::Build(const Json::Value& package) {
+    const auto& items = package["item_name_to_id"];
+    const auto& locations = package["location_name_to_id"];
+
+    std::vector<Entry> entries;
+    std::string names;
+    auto addNames = [&](const Json::Value& table) {
+        for (auto it = table.begin(); it != table.end(); ++it) {
+            Entry entry;
+            entry.id = it->asInt64();
+            entry.name = (uint32_t)names.size();
+            entry.reserved = 0;
+            names += it.name();
+            names += '\0';
+            entries.push_back(entry);
+        }
+    };
+    addNames(items);
+    uint32_t numItems = (uint32_t)entries.size();
+    addNames(locations);
+    uint32_t numLocations = (uint32_t)entries.size() - numItems;
+
+    Header header;
+    memcpy(header.magic, DATAPACKAGE_MAGIC, 4);
+    header.version = DATAPACKAGE_VERSION;
+    header.numItems = numItems;
+    header.numLocations = numLocations;
+    header.itemSlots = SlotCount(numItems);
+    header.locationSlots = SlotCount(numLocations);
+    header.namesSize = (uint32_t)names.size();
+    header.reserved = 0;
+
+    std::vector<uint32_t> slots(header.itemSlots + header.locationSlots, 0);
+    auto insert = [&](uint32_t* table, uint32_t numSlots, uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t slot = HashID(entries[i].id) & (numSlots - 1);
+            while (table[slot] != 0) {
+                slot = (slot + 1) & (numSlots - 1);
+            }
+            table[slot] = i - first + 1;
+        }
+    };
+    insert(slots.data(), header.itemSlots, 0, numItems);
+    insert(slots.data() + header.itemSlots, header.locationSlots, numItems, numLocations);
+
+    std::vector<uint8_t> image(sizeof(Header) + entries.size() * sizeof(Entry) + slots.size() * sizeof(uint32_t) + names.size());
+    uint8_t* p = image.data();
+    memcpy(p, &header, sizeof(Header));
+    p += sizeof(Header);
+    memcpy(p, entries.data(), entries.size() * sizeof(Entry));
+    p += entries.size() * sizeof(Entry);
+    memcpy(p, slots.data(), slots.size() * sizeof(uint32_t));
+    p += slots.size() * sizeof(uint32_t);
+    memcpy(p, names.data(), names.size());
+    return image;
+}
+
+//==========================================================================
+//
+// Map / Adopt
+//
+//==========================================================================
+
+bool ArchipelagoDataPackage::Map(const std::string& path) {
+    Unmap();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(WideString(path.c_str()).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    m_mapping = view;
+    m_data = (const uint8_t*)view;
+    m_size = (size_t)info.st_size;
+#endif
+
+    if (!Validate()) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+bool ArchipelagoDataPackage::Adopt(std::vector<uint8_t>&& image) {
+    Unmap();
+    m_owned = std::move(image);
+    m_data = m_owned.data();
+    m_size = m_owned.size();
+    if (!Validate()) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+void ArchipelagoDataPackage::Unmap() {
+    if (m_mapping != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+        CloseHandle((HANDLE)m_mapping);
+#else
+        munmap(m_mapping, m_size);
+#endif
+        m_mapping = nullptr;
+    }
+    m_owned.clear();
+    m_data = nullptr;
+    m_size = 0;
+}
+
+// Makes sure a truncated or foreign file can't send lookups out of bounds.
+bool ArchipelagoDataPackage::Validate() {
+    if (m_size < sizeof(Header)) {
+        return false;
+    }
+    const Header* header = (const Header*)m_data;
+    if (memcmp(header->magic, DATAPACKAGE_MAGIC, 4) != 0 || header->version != DATAPACKAGE_VERSION) {
+        return false;
+    }
+    if ((header->itemSlots & (header->itemSlots - 1)) != 0 || (header->locationSlots & (header->locationSlots - 1)) != 0 ||
+        header->itemSlots <= header->numItems || header->locationSlots <= header->numLocations) {
+        return false;
+    }
+    uint64_t expected = sizeof(Header) + ((uint64_t)header->numItems + header->numLocations) * sizeof(Entry) +
+        ((uint64_t)header->itemSlots + header->locationSlots) * sizeof(uint32_t) + header->namesSize;
+    if (expected != m_size) {
+        return false;
+    }
+    // The last name must be terminated. A game without any names has none.
+    if (header->namesSize == 0 ? header->numItems + header->numLocations != 0 : m_data[m_size - 1] != 0) {
+        return false;
+    }
+
+    // Probing stops at an empty slot and follows slot values into the
+    // entries, so every table needs one and no value may point past them.
+    const Entry* entries = (const Entry*)(header + 1);
+    const uint32_t* slots = (const uint32_t*)(entries + header->numItems + header->numLocations);
+    auto validSlots = [](const uint32_t* table, uint32_t numSlots, uint32_t numEntries) {
+        bool empty = false;
+        for (uint32_t i = 0; i < numSlots; i++) {
+            if (table[i] > numEntries) {
+                return false;
+            }
+            empty |= table[i] == 0;
+        }
+        return empty;
+    };
+    return validSlots(slots, header->itemSlots, header->numItems) &&
+        validSlots(slots + header->itemSlots, header->locationSlots, header->numLocations);
+}
+
+//==========================================================================
+//
+// Lookups
+//
+//==========================================================================
+
+const char* ArchipelagoDataPackage::Find(const Entry* entries, const uint32_t* slots, uint32_t numSlots, int64_t id) const {
+    const Header* header = (const Header*)m_data;
+    const char* names = (const char*)m_data + m_size - header->namesSize;
+    uint32_t slot = HashID(id) & (numSlots - 1);
+    while (slots[slot] != 0) {
+        const Entry& entry = entries[slots[slot] - 1];
+        if (entry.id == id) {
+            return entry.name < header->namesSize ? names + entry.name : nullptr;
+        }
+        slot = (slot + 1) & (numSlots - 1);
+    }
+    return nullptr;
+}
+
+const char* ArchipelagoDataPackage::GetItemName(int64_t id) const {
+    if (m_data == nullptr) {
+        return nullptr;
+    }
+    const Header* header = (const Header*)m_data;
+    const Entry* entries = (const Entry*)(header + 1);
+    const uint32_t* slots = (const uint32_t*)(entries + header->numItems + header->numLocations);
+    return Find(entries, slots, header->itemSlots, id);
+}
+
+const char* ArchipelagoDataPackage::GetLocationName(int64_t id) const {
+    if (m_data == nullptr) {
+        return nullptr;
+    }
+    const Header* header = (const Header*)m_data;
+    const Entry* entries = (const Entry*)(header + 1);
+    const uint32_t* slots = (const uint32_t*)(entries + header->numItems + header->numLocations);
+    return Find(entries + header->numItems, slots + header->itemSlots, header->locationSlots, id);
+}
+
+//==========================================================================
+//
+// ArchipelagoDataPackageCache
+//
+//==========================================================================
+
+std::string ArchipelagoDataPackageCache::CachePath(const std::string& checksum) {
+    // Checksums are hex strings, but don't trust the server with a file name.
+    std::string name;
+    for (char c : checksum) {
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            name += c;
+        }
+    }
+    if (name.empty()) {
+        return name;
+    }
+    FString path = M_GetCachePath(true);
+    path += "/archipelago";
+    CreatePath(path.GetChars());
+    return std::string(path.GetChars()) + "/" + name + ".apdp";
+}
+
+std::vector<std::string> ArchipelagoDataPackageCache::LoadChecksums(const Json::Value& checksums) {
+    std::vector<std::string> missing;
+    if (!checksums.isObject()) {
+        return missing;
+    }
+
+    for (auto it = checksums.begin(); it != checksums.end(); ++it) {
+        std::string game = it.name();
+        std::string path = CachePath(it->asString());
+
+        auto package = std::make_unique<ArchipelagoDataPackage>();
+        if (path.empty() || !package->Map(path)) {
+            missing.push_back(game);
+            continue;
+        }
+
+        if (archipelago_debug) {
+            Printf("Archipelago: Using cached DataPackage for %s\n", game.c_str());
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& slot = m_games[game];
+        if (slot) {
+            m_replaced.push_back(std::move(slot));
+        }
+        slot = std::move(package);
+    }
+    return missing;
+}
+
+void ArchipelagoDataPackageCache::Store(const Json::Value& games) {
+    for (auto it = games.begin(); it != games.end(); ++it) {
+        std::string game = it.name();
+        std::vector<uint8_t> image = ArchipelagoDataPackage::Build(*it);
+
+        // Packages without a checksum come from old servers and can't be
+        // told apart from other versions, so they are only kept in memory.
+        std::string path = CachePath((*it).get("checksum", "").asString());
+        if (!path.empty()) {
+            std::unique_ptr<FileWriter> writer(FileWriter::Open(path.c_str()));
+            if (writer != nullptr) {
+                writer->Write(image.data(), image.size());
+            }
+        }
+
+        auto package = std::make_unique<ArchipelagoDataPackage>();
+        if (!package->Adopt(std::move(image))) {
+            continue;
+        }
+
+        if (archipelago_debug) {
+            Printf("Archipelago: Received DataPackage for %s\n", game.c_str());
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& slot = m_games[game];
+        if (slot) {
+            m_replaced.push_back(std::move(slot));
+        }
+        slot = std::move(package);
+    }
+}
+
+const char* ArchipelagoDataPackageCache::GetItemName(int64_t id, const std::string& game) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_games.find(game);
+    return it != m_games.end() ? it->second->GetItemName(id) : nullptr;
+}
+
+const char* ArchipelagoDataPackageCache::GetLocationName(int64_t id, const std::string& game) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_games.find(game);
+    return it != m_games.end() ? it->second->GetLocationName(id) : nullptr;
+}
+
+size_t ArchipelagoDataPackageCache::NumGames() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_games.size();
+}
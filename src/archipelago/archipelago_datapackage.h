@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <json/json.h>  // vcpkg style include
+
+// One game's item and location names, in the binary layout of the cache
+// file. Either memory-mapped from the cache or built from a DataPackage
+// the server just sent.
+//
+// File layout:
+//   header
+//   item entries, location entries     (id, name offset)
+//   item hash slots, location hash slots (entry index + 1, 0 = empty)
+//   zero terminated names
+class ArchipelagoDataPackage {
+public:
+    ArchipelagoDataPackage() = default;
+    ~ArchipelagoDataPackage();
+    ArchipelagoDataPackage(const ArchipelagoDataPackage&) = delete;
+    ArchipelagoDataPackage& operator=(const ArchipelagoDataPackage&) = delete;
+
+    bool Map(const std::string& path);
+    bool Adopt(std::vector<uint8_t>&& image);
+
+    const char* GetItemName(int64_t id) const;
+    const char* GetLocationName(int64_t id) const;
+
+    static std::vector<uint8_t> Build(const Json::Value& package);
+
+private:
+    struct Header;
+    struct Entry;
+
+    bool Validate();
+    void Unmap();
+    const char* Find(const Entry* entries, const uint32_t* slots, uint32_t numSlots, int64_t id) const;
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<uint8_t> m_owned;
+    void* m_mapping = nullptr;      // platform mapping handle
+};
+
+// All DataPackages of the current multiworld, keyed by game name. The
+// websocket thread fills this while the game thread looks up names.
+class ArchipelagoDataPackageCache {
+public:
+    // Maps the cached packages for the room's checksums and returns the
+    // games that have to be requested from the server.
+    std::vector<std::string> LoadChecksums(const Json::Value& checksums);
+
+    // Stores the games of a DataPackage reply.
+    void Store(const Json::Value& games);
+
+    // IDs are only unique within a game. Item IDs belong to the game of the
+    // player who owns the item, location IDs to the game of the player whose
+    // world the location is in. Returns nullptr for unknown games or IDs.
+    const char* GetItemName(int64_t id, const std::string& game) const;
+    const char* GetLocationName(int64_t id, const std::string& game) const;
+
+    size_t NumGames() const;
+
+private:
+    static std::string CachePath(const std::string& checksum);
+
+    std::map<std::string, std::unique_ptr<ArchipelagoDataPackage>> m_games;
+    std::vector<std::unique_ptr<ArchipelagoDataPackage>> m_replaced;   // names handed out may still be in use
+    mutable std::mutex m_mutex;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 // Main header for Archipelago integration into Selaco
 // Include this in your main game loop and initialization code
 
@@ -8,12 +10,20 @@ extern void Archipelago_Init();
 extern void Archipelago_Shutdown();
 extern void Archipelago_ProcessMessages();
 
+// Location checks and client status are sent in batches and kept in the
+// savegame until the server confirms them.
+class FSerializer;
+extern void Archipelago_CheckLocation(int64_t location);
+extern void Archipelago_SetStatus(int status);
+extern void Archipelago_Serialize(FSerializer& arc);
+
 // Optional: Register Archipelago-specific game events
 // These would be implemented based on your game's specific needs
 namespace ArchipelagoEvents {
     // Event handlers - implement in archipelago_selaco.cpp
-    void OnItemReceived(int itemId, const char* itemName);
-    void OnLocationChecked(int locationId, const char* locationName);
+    // Names come from the DataPackages and are nullptr if unknown
+    void OnItemReceived(int64_t itemId, const char* itemName, int fromPlayer, const char* locationName);
+    void OnLocationChecked(int64_t locationId, const char* locationName);
     void OnGoalCompleted(int goalId);
     void OnPlayerConnected(const char* playerName);
     void OnPlayerDisconnected(const char* playerName);
@@ -34,7 +44,7 @@ namespace ArchipelagoEvents {
 // 4. Console commands are automatically registered
 //
 // 5. To check a location in your game code:
-//    ArchipelagoEvents::OnLocationChecked(locationId, locationName);
+//    Archipelago_CheckLocation(locationId);
 //
 // 6. Items will be automatically received and processed
 //    through the message processing system
\ No newline at end of file
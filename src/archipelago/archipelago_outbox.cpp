@@ -0,0 +1,181 @@
+#include "archipelago_outbox.h"
+#include "archipelago_socket.h"
+#include "c_cvars.h"
+#include "doomtype.h"
+#include "serializer.h"
+#include <algorithm>
+
+EXTERN_CVAR(Bool, archipelago_debug)
+
+// Milliseconds to wait for more events before sending. Clearing an area or
+// loading a savegame checks many locations at once, and they all end up in
+// the same packet.
+CVAR(Int, archipelago_send_window, 100, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+void ArchipelagoOutbox::Touch() {
+    if (!HasPending()) {
+        m_firstPending = std::chrono::steady_clock::now();
+    }
+}
+
+void ArchipelagoOutbox::CheckLocation(int64_t location) {
+    if (m_acknowledged.count(location) || !m_journal.insert(location).second) {
+        m_duplicates++;
+        return;
+    }
+    Touch();
+    m_pending.push_back(location);
+}
+
+void ArchipelagoOutbox::SetStatus(int status) {
+    if (status == m_status && !m_statusPending) {
+        return;
+    }
+    Touch();
+    m_status = status;
+    m_statusPending = true;
+}
+
+void ArchipelagoOutbox::Bounce(const Json::Value& bounce) {
+    // A newer bounce to the same receivers replaces one that hasn't gone out
+    // yet, a second DeathLink within the window tells nobody anything new.
+    for (auto& pending : m_bounces) {
+        if (pending["games"] == bounce["games"] && pending["slots"] == bounce["slots"] && pending["tags"] == bounce["tags"]) {
+            pending = bounce;
+            m_duplicates++;
+            return;
+        }
+    }
+    Touch();
+    m_bounces.push_back(bounce);
+}
+
+void ArchipelagoOutbox::Resync(const std::vector<int64_t>& checked) {
+    m_acknowledged.clear();
+    m_acknowledged.insert(checked.begin(), checked.end());
+    for (auto it = m_journal.begin(); it != m_journal.end();) {
+        if (m_acknowledged.count(*it)) {
+            it = m_journal.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Whatever was sent over the lost connection may never have arrived.
+    Touch();
+    m_pending.assign(m_journal.begin(), m_journal.end());
+    if (archipelago_debug && !m_pending.empty()) {
+        Printf("Archipelago: Resending %zu unconfirmed location checks\n", m_pending.size());
+    }
+}
+
+void ArchipelagoOutbox::Acknowledge(const std::vector<int64_t>& checked) {
+    for (int64_t location : checked) {
+        m_acknowledged.insert(location);
+        m_journal.erase(location);
+    }
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+        [&](int64_t location) { return m_acknowledged.count(location) > 0; }), m_pending.end());
+}
+
+//==========================================================================
+//
+// Flush
+//
+// Everything pending goes out as one packet; Archipelago packets are
+// arrays of commands.
+//
+//==========================================================================
+
+void ArchipelagoOutbox::Flush(ArchipelagoSocket& socket, bool force) {
+    if (!HasPending() || !socket.IsConnected()) {
+        return;
+    }
+    auto waited = std::chrono::steady_clock::now() - m_firstPending;
+    if (!force && waited < std::chrono::milliseconds(*archipelago_send_window)) {
+        return;
+    }
+
+    Json::Value packet(Json::arrayValue);
+    if (!m_pending.empty()) {
+        Json::Value& cmd = packet.append(Json::objectValue);
+        cmd["cmd"] = "LocationChecks";
+        Json::Value& locations = cmd["locations"] = Json::arrayValue;
+        for (int64_t location : m_pending) {
+            locations.append(Json::Int64(location));
+        }
+    }
+    if (m_statusPending) {
+        Json::Value& cmd = packet.append(Json::objectValue);
+        cmd["cmd"] = "StatusUpdate";
+        cmd["status"] = m_status;
+    }
+    for (const auto& bounce : m_bounces) {
+        Json::Value& cmd = packet.append(bounce);
+        cmd["cmd"] = "Bounce";
+    }
+
+    size_t bytes = 0;
+    if (!socket.SendJson(packet, &bytes)) {
+        // Stays pending, the next frame tries again.
+        return;
+    }
+
+    if (archipelago_debug) {
+        Printf("Archipelago: Sent %u commands, %zu locations (%zu bytes)\n", packet.size(), m_pending.size(), bytes);
+    }
+    m_packetsSent++;
+    m_commandsSent += packet.size();
+    m_locationsSent += m_pending.size();
+    m_bytesSent += bytes;
+
+    // Sent locations stay in the journal until the server confirms them.
+    m_pending.clear();
+    m_statusPending = false;
+    m_bounces.clear();
+}
+
+//==========================================================================
+//
+// Serialize
+//
+// Only the journal and the client status are saved, the acknowledged set
+// is rebuilt from the server on every connect.
+//
+//==========================================================================
+
+void ArchipelagoOutbox::Serialize(FSerializer& arc) {
+    TArray<int64_t> journal;
+    if (arc.isWriting()) {
+        for (int64_t location : m_journal) {
+            journal.Push(location);
+        }
+    }
+    arc("journal", journal)
+        ("status", m_status);
+
+    if (arc.isReading()) {
+        m_journal.clear();
+        m_pending.clear();
+        for (int64_t location : journal) {
+            CheckLocation(location);
+        }
+        m_statusPending = m_status != 0;
+    }
+}
+
+void ArchipelagoOutbox::Clear() {
+    m_pending.clear();
+    m_journal.clear();
+    m_bounces.clear();
+    m_status = 0;
+    m_statusPending = false;
+}
+
+void ArchipelagoOutbox::PrintStats() const {
+    Printf("  Outbox: %zu pending, %zu unconfirmed, %llu duplicates dropped\n",
+           m_pending.size(), m_journal.size(), (unsigned long long)m_duplicates);
+    Printf("  Sent: %llu packets, %llu commands, %llu locations, %llu bytes\n",
+           (unsigned long long)m_packetsSent, (unsigned long long)m_commandsSent,
+           (unsigned long long)m_locationsSent, (unsigned long long)m_bytesSent);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_set>
+#include <chrono>
+#include <cstdint>
+#include <json/json.h>  // vcpkg style include
+
+class ArchipelagoSocket;
+class FSerializer;
+
+// Collects everything the game wants to tell the server and sends it as one
+// packet per send window instead of one packet per event.
+//
+// Checked locations stay in the journal until the server lists them as
+// checked, either in Connected or in a RoomUpdate. The journal is stored in
+// the savegame, so checks made while offline or right before a crash are
+// sent again on the next connect.
+class ArchipelagoOutbox {
+public:
+    void CheckLocation(int64_t location);
+    void SetStatus(int status);
+    void Bounce(const Json::Value& bounce);
+
+    // Connected: the server's complete list, everything else in the journal is resent.
+    void Resync(const std::vector<int64_t>& checked);
+    // RoomUpdate: locations that were checked since.
+    void Acknowledge(const std::vector<int64_t>& checked);
+
+    // Sends the pending commands once the oldest has waited out the window.
+    void Flush(ArchipelagoSocket& socket, bool force = false);
+    void Serialize(FSerializer& arc);
+    // Loaded a savegame without Archipelago data: nothing of the previous game is sent.
+    void Clear();
+    void PrintStats() const;
+
+private:
+    bool HasPending() const { return !m_pending.empty() || m_statusPending || !m_bounces.empty(); }
+    void Touch();
+
+    std::vector<int64_t> m_pending;             // not sent since the last (re)connect
+    std::set<int64_t> m_journal;                // checked here, not confirmed by the server
+    std::unordered_set<int64_t> m_acknowledged;
+    std::vector<Json::Value> m_bounces;
+    int m_status = 0;
+    bool m_statusPending = false;
+    std::chrono::steady_clock::time_point m_firstPending;
+
+    uint64_t m_packetsSent = 0;
+    uint64_t m_commandsSent = 0;
+    uint64_t m_locationsSent = 0;
+    uint64_t m_duplicates = 0;
+    uint64_t m_bytesSent = 0;
+};
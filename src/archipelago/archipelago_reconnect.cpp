@@ -0,0 +1,78 @@
+#include "archipelago_reconnect.h"
+#include <algorithm>
+
+void ArchipelagoReconnect::Begin(bool sslFallback) {
+    m_sslFallback = sslFallback;
+    m_retryDelayMs = RETRY_MIN_DELAY_MS;
+}
+
+void ArchipelagoReconnect::Attempt(bool ssl, Clock::time_point now) {
+    m_useSsl = ssl;
+    SetState(ArchipelagoConnectionState::CONNECTING, now);
+}
+
+void ArchipelagoReconnect::Disconnect(Clock::time_point now) {
+    SetState(ArchipelagoConnectionState::DISCONNECTED, now);
+}
+
+void ArchipelagoReconnect::SetState(ArchipelagoConnectionState state, Clock::time_point now) {
+    m_state = state;
+    m_stateTime = now;
+}
+
+ArchipelagoConnectionAction ArchipelagoReconnect::Fail(const char* reason, Clock::time_point now) {
+    m_failReason = reason;
+    SetState(ArchipelagoConnectionState::RECONNECT_WAIT, now);
+    return ArchipelagoConnectionAction::FAIL;
+}
+
+ArchipelagoConnectionAction ArchipelagoReconnect::Update(const ArchipelagoConnectionEvents& events, Clock::time_point now) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_stateTime).count();
+
+    switch (m_state) {
+        case ArchipelagoConnectionState::DISCONNECTED:
+            break;
+
+        case ArchipelagoConnectionState::CONNECTING:
+            if (events.open) {
+                // Connected! Now wait for RoomInfo, the handshake is sent when it arrives
+                SetState(ArchipelagoConnectionState::AUTHENTICATING, now);
+            } else if (events.sslFailed && m_useSsl && m_sslFallback) {
+                return ArchipelagoConnectionAction::RETRY_WITHOUT_SSL;
+            } else if (events.socketError) {
+                return Fail("Failed to connect to server", now);
+            } else if (elapsed >= CONNECT_TIMEOUT_MS) {
+                return Fail("Connection timeout", now);
+            }
+            break;
+
+        case ArchipelagoConnectionState::AUTHENTICATING:
+            if (events.authenticated) {
+                m_retryDelayMs = RETRY_MIN_DELAY_MS;
+                SetState(ArchipelagoConnectionState::CONNECTED, now);
+            } else if (events.refused) {
+                // Wrong slot or password, trying again won't help.
+                SetState(ArchipelagoConnectionState::DISCONNECTED, now);
+                return ArchipelagoConnectionAction::GIVE_UP;
+            } else if (!events.open) {
+                return Fail("Connection lost during authentication", now);
+            } else if (elapsed >= AUTH_TIMEOUT_MS) {
+                return Fail("Authentication timeout", now);
+            }
+            break;
+
+        case ArchipelagoConnectionState::CONNECTED:
+            if (!events.open) {
+                return Fail("Connection lost", now);
+            }
+            break;
+
+        case ArchipelagoConnectionState::RECONNECT_WAIT:
+            if (elapsed >= m_retryDelayMs) {
+                m_retryDelayMs = std::min(m_retryDelayMs * 2, RETRY_MAX_DELAY_MS);
+                return ArchipelagoConnectionAction::RETRY;
+            }
+            break;
+    }
+    return ArchipelagoConnectionAction::NONE;
+}
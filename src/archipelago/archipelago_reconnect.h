@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Connecting and authenticating never block the game thread. Connect() only
+// starts the attempt, Update() advances it and is polled once per frame.
+enum class ArchipelagoConnectionState : uint8_t {
+    DISCONNECTED,       // idle, or given up after the server refused us
+    CONNECTING,         // waiting for the websocket to open
+    AUTHENTICATING,     // socket open, waiting for RoomInfo and Connected
+    CONNECTED,
+    RECONNECT_WAIT      // attempt failed or connection lost, retrying after a delay
+};
+
+// What the websocket reported for the current attempt.
+struct ArchipelagoConnectionEvents {
+    bool open = false;              // the websocket is open
+    bool authenticated = false;     // Connected arrived
+    bool refused = false;           // ConnectionRefused arrived
+    bool socketError = false;
+    bool sslFailed = false;
+};
+
+// What the socket has to do after an Update().
+enum class ArchipelagoConnectionAction : uint8_t {
+    NONE,
+    RETRY_WITHOUT_SSL,  // stop the socket and start a ws:// attempt
+    FAIL,               // stop the socket, the next attempt follows after GetRetryDelay()
+    GIVE_UP,            // stop the socket, the server refused us
+    RETRY               // start the next attempt, with SSL if UseSsl()
+};
+
+// The connection state machine of ArchipelagoSocket: states, timeouts and
+// the retry backoff. It does not touch the socket and is given the time, so
+// the reconnect behaviour can be tested without a server.
+class ArchipelagoReconnect {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int CONNECT_TIMEOUT_MS = 5000;
+    static constexpr int AUTH_TIMEOUT_MS = 30000;
+    static constexpr int RETRY_MIN_DELAY_MS = 1000;
+    static constexpr int RETRY_MAX_DELAY_MS = 30000;
+
+    // A new connection, the backoff starts over.
+    void Begin(bool sslFallback);
+    // The socket started an attempt.
+    void Attempt(bool ssl, Clock::time_point now);
+    void Disconnect(Clock::time_point now);
+
+    ArchipelagoConnectionAction Update(const ArchipelagoConnectionEvents& events, Clock::time_point now);
+
+    ArchipelagoConnectionState GetState() const { return m_state; }
+    bool UseSsl() const { return m_useSsl; }
+    int GetRetryDelay() const { return m_retryDelayMs; }
+    const char* GetFailReason() const { return m_failReason; }
+
+private:
+    void SetState(ArchipelagoConnectionState state, Clock::time_point now);
+    ArchipelagoConnectionAction Fail(const char* reason, Clock::time_point now);
+
+    ArchipelagoConnectionState m_state = ArchipelagoConnectionState::DISCONNECTED;
+    Clock::time_point m_stateTime;      // when m_state was entered
+    bool m_useSsl = true;
+    bool m_sslFallback = true;          // may still retry without SSL
+    int m_retryDelayMs = RETRY_MIN_DELAY_MS;
+    const char* m_failReason = "";
+};
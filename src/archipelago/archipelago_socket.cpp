@@ -8,6 +8,8 @@
 #include <iomanip>
 #include <thread>
 #include <cstdarg>
+#include <algorithm>
+#include <cstdlib>
 
 EXTERN_CVAR(Bool, archipelago_debug)
 
@@ -26,6 +28,8 @@ ArchipelagoSocket::ArchipelagoSocket()
     : m_connected(false)
     , m_authenticated(false)
     , m_sslFailed(false)
+    , m_refused(false)
+    , m_socketError(false)
     , m_port(0)
     , m_serverVersionMajor(0)
     , m_serverVersionMinor(5)
@@ -58,13 +62,13 @@ ArchipelagoSocket::~ArchipelagoSocket() {
 bool ArchipelagoSocket::Connect(const std::string& host, uint16_t port, 
                                const std::string& slotName, 
                                const std::string& password) {
-    if (m_connected) {
-        m_lastError = "Already connected";
+    if (GetState() != ArchipelagoConnectionState::DISCONNECTED) {
+        SetLastError(GetState() == ArchipelagoConnectionState::CONNECTED ? "Already connected" : "Already connecting");
         return false;
     }
     
     if (slotName.empty()) {
-        m_lastError = "Slot name cannot be empty";
+        SetLastError("Slot name cannot be empty");
         return false;
     }
     
@@ -72,12 +76,20 @@ bool ArchipelagoSocket::Connect(const std::string& host, uint16_t port,
     m_port = port;
     m_slotName = slotName;
     m_password = password;
-    m_sslFailed = false;
-    
-    // Try SSL first
-    std::string url = "wss://" + host + ":" + std::to_string(port);
     
-    Printf("Connecting to Archipelago server at %s...\n", url.c_str());
+    // Try SSL first, unless the host says which one to use. A plain ws://
+    // host is also the way to point this at a local test server.
+    bool ssl = true;
+    bool sslFallback = true;
+    if (m_host.compare(0, 5, "ws://") == 0) {
+        m_host = m_host.substr(5);
+        ssl = false;
+        sslFallback = false;
+    } else if (m_host.compare(0, 6, "wss://") == 0) {
+        m_host = m_host.substr(6);
+        sslFallback = false;
+    }
+    m_reconnect.Begin(sslFallback);
     
     // Set up WebSocket callbacks
     m_webSocket.setOnMessageCallback([this](const ix::WebSocketMessagePtr& msg) {
@@ -85,60 +97,90 @@ bool ArchipelagoSocket::Connect(const std::string& host, uint16_t port,
     });
     
     // Configure WebSocket
-    m_webSocket.setUrl(url);
     m_webSocket.enablePerMessageDeflate();
     m_webSocket.setPingInterval(45);
-    m_webSocket.disableAutomaticReconnection(); // We'll handle reconnection
+    m_webSocket.disableAutomaticReconnection(); // Update() reconnects with a backoff
     
-    // Start connection
+    StartAttempt(ssl);
+    return true;
+}
+
+void ArchipelagoSocket::StartAttempt(bool ssl) {
+    m_connected = false;
+    m_authenticated = false;
+    m_sslFailed = false;
+    m_refused = false;
+    m_socketError = false;
+    
+    std::string url = (ssl ? "wss://" : "ws://") + m_host + ":" + std::to_string(m_port);
+    Printf("Connecting to Archipelago server at %s...\n", url.c_str());
+    
+    // Start connection, the result arrives through OnMessage
+    m_webSocket.setUrl(url);
     m_webSocket.start();
+    m_reconnect.Attempt(ssl, std::chrono::steady_clock::now());
+}
+
+void ArchipelagoSocket::FailAttempt(const std::string& reason) {
+    SetLastError(reason);
+    m_webSocket.stop();
+    m_connected = false;
+    m_authenticated = false;
     
-    // Wait for connection
-    if (!WaitForConnection()) {
-        // If SSL failed, try without SSL
-        if (m_sslFailed && url.find("wss://") == 0) {
+    Printf(TEXTCOLOR_RED "Archipelago: %s, retrying in %d seconds\n", reason.c_str(), m_reconnect.GetRetryDelay() / 1000);
+}
+
+void ArchipelagoSocket::SetLastError(const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    m_lastError = error;
+}
+
+void ArchipelagoSocket::Update() {
+    ArchipelagoConnectionEvents events;
+    events.open = m_connected;
+    events.authenticated = m_authenticated;
+    events.refused = m_refused;
+    events.socketError = m_socketError;
+    events.sslFailed = m_sslFailed;
+    
+    switch (m_reconnect.Update(events, std::chrono::steady_clock::now())) {
+        case ArchipelagoConnectionAction::NONE:
+            break;
+            
+        case ArchipelagoConnectionAction::RETRY_WITHOUT_SSL:
             Printf("SSL connection failed, trying without SSL...\n");
             m_webSocket.stop();
+            StartAttempt(false);
+            break;
             
-            url = "ws://" + host + ":" + std::to_string(port);
-            m_webSocket.setUrl(url);
-            m_webSocket.start();
+        case ArchipelagoConnectionAction::FAIL:
+            FailAttempt(m_reconnect.GetFailReason());
+            break;
             
-            if (!WaitForConnection()) {
-                m_lastError = "Failed to connect to server";
-                return false;
-            }
-        } else {
-            return false;
-        }
-    }
-    
-    // Connected! Now wait for RoomInfo and send handshake
-    // The handshake will be sent when we receive RoomInfo
-    if (!WaitForAuthentication()) {
-        Disconnect();
-        return false;
+        case ArchipelagoConnectionAction::GIVE_UP:
+            m_webSocket.stop();
+            m_connected = false;
+            break;
+            
+        case ArchipelagoConnectionAction::RETRY:
+            StartAttempt(m_reconnect.UseSsl());
+            break;
     }
-    
-    return true;
 }
 
 void ArchipelagoSocket::Disconnect() {
-    if (!m_connected) {
+    if (GetState() == ArchipelagoConnectionState::DISCONNECTED && !m_connected) {
         return;
     }
     
+    m_reconnect.Disconnect(std::chrono::steady_clock::now());
     m_connected = false;
     m_authenticated = false;
     m_webSocket.stop();
     
     // Clear receive queue
-    {
-        std::lock_guard<std::mutex> lock(m_recvMutex);
-        while (!m_recvQueue.empty()) {
-            m_recvQueue.pop();
-        }
-    }
+    ArchipelagoMessage msg;
+    while (m_recvQueue.Pop(msg)) {}
     
     Printf("Disconnected from Archipelago server\n");
 }
@@ -166,7 +208,8 @@ void ArchipelagoSocket::OnOpen() {
 
 void ArchipelagoSocket::OnError(const std::string& error) {
     Printf(TEXTCOLOR_RED "WebSocket error: %s\n", error.c_str());
-    m_lastError = error;
+    SetLastError(error);
+    m_socketError = true;
     
     // Check if this is an SSL error
     if (error.find("SSL") != std::string::npos || 
@@ -185,9 +228,9 @@ void ArchipelagoSocket::OnClose() {
 bool ArchipelagoSocket::ProcessMessage(const std::string& message) {
     Json::Value root;
     std::string errs;
-    std::istringstream stream(message);
     
-    if (!Json::parseFromStream(m_jsonReaderBuilder, stream, &root, &errs)) {
+    // Only ever called on the websocket thread, so the reader can be reused.
+    if (!m_jsonReader->parse(message.data(), message.data() + message.size(), &root, &errs)) {
         Printf(TEXTCOLOR_RED "Failed to parse JSON message: %s\n", errs.c_str());
         return false;
     }
@@ -218,6 +261,26 @@ bool ArchipelagoSocket::ProcessMessage(const std::string& message) {
                 Printf("Server version: %d.%d.%d\n", 
                        m_serverVersionMajor, m_serverVersionMinor, m_serverVersionBuild);
             }
+            m_seedName = cmd.get("seed_name", "").asString();
+            
+            // Only ask for the DataPackages that aren't cached yet. Servers
+            // older than 0.4 don't send checksums, so everything is missing.
+            std::vector<std::string> missing;
+            if (cmd.isMember("datapackage_checksums")) {
+                missing = m_dataPackages.LoadChecksums(cmd["datapackage_checksums"]);
+            } else {
+                for (const auto& game : cmd["games"]) {
+                    missing.push_back(game.asString());
+                }
+            }
+            if (!missing.empty()) {
+                Json::Value request;
+                request[0]["cmd"] = "GetDataPackage";
+                for (const auto& game : missing) {
+                    request[0]["games"].append(game);
+                }
+                SendJson(request);
+            }
             
             // Send handshake after receiving RoomInfo
             SendHandshake();
@@ -234,19 +297,22 @@ bool ArchipelagoSocket::ProcessMessage(const std::string& message) {
                 Printf("Missing locations: %d\n", static_cast<int>(cmd["missing_locations"].size()));
             }
             
-            m_authenticated = true;
+            ReadSlotInfo(cmd);
             
             // Add to message queue for game processing
             ArchipelagoMessage msg;
             msg.type = ArchipelagoMessageType::CONNECTED;
-            msg.json = cmd;
-            
-            std::ostringstream oss;
-            m_jsonWriter->write(cmd, &oss);
-            msg.data = oss.str();
+            msg.slot = cmd.get("slot", -1).asInt();
+            msg.seedName = m_seedName;
+            for (const auto& id : cmd["checked_locations"]) {
+                msg.checkedLocations.push_back(id.asInt64());
+            }
+            for (const auto& id : cmd["missing_locations"]) {
+                msg.missingLocations.push_back(id.asInt64());
+            }
+            m_recvQueue.Push(std::move(msg));
             
-            std::lock_guard<std::mutex> lock(m_recvMutex);
-            m_recvQueue.push(msg);
+            m_authenticated = true;
             
         } else if (cmdType == "ConnectionRefused") {
             std::string reason = "Unknown reason";
@@ -255,35 +321,53 @@ bool ArchipelagoSocket::ProcessMessage(const std::string& message) {
                 reason = cmd["errors"][0].asString();
             }
             
-            m_lastError = "Connection refused: " + reason;
-            Printf(TEXTCOLOR_RED "%s\n", m_lastError.c_str());
+            SetLastError("Connection refused: " + reason);
+            Printf(TEXTCOLOR_RED "Connection refused: %s\n", reason.c_str());
             m_authenticated = false;
+            m_refused = true;
             
         } else if (cmdType == "PrintJSON") {
             // Add to message queue
             ArchipelagoMessage msg;
             msg.type = ArchipelagoMessageType::PRINT_JSON;
-            msg.json = cmd;
-            
-            std::ostringstream oss;
-            m_jsonWriter->write(cmd, &oss);
-            msg.data = oss.str();
-            
-            std::lock_guard<std::mutex> lock(m_recvMutex);
-            m_recvQueue.push(msg);
+            DecodePrintJSON(cmd, msg);
+            m_recvQueue.Push(std::move(msg));
             
         } else if (cmdType == "ReceivedItems") {
             // Add to message queue
             ArchipelagoMessage msg;
             msg.type = ArchipelagoMessageType::DATA;
-            msg.json = cmd;
+            msg.itemIndex = cmd.get("index", 0).asInt();
             
-            std::ostringstream oss;
-            m_jsonWriter->write(cmd, &oss);
-            msg.data = oss.str();
+            // Received items are always for our game, the location is in
+            // the world of the player who found it.
+            const auto& items = cmd["items"];
+            std::string ownGame = GetSlotGame();
+            msg.items.reserve(items.size());
+            for (const auto& item : items) {
+                ArchipelagoNetworkItem netItem;
+                netItem.item = item.get("item", 0).asInt64();
+                netItem.location = item.get("location", 0).asInt64();
+                netItem.player = item.get("player", 0).asInt();
+                netItem.flags = item.get("flags", 0).asInt();
+                netItem.itemName = m_dataPackages.GetItemName(netItem.item, ownGame);
+                netItem.locationName = m_dataPackages.GetLocationName(netItem.location, GetSlotGame(netItem.player));
+                msg.items.push_back(netItem);
+            }
+            m_recvQueue.Push(std::move(msg));
+        } else if (cmdType == "RoomUpdate") {
+            // Only the newly checked locations matter to the outbox.
+            if (cmd.isMember("checked_locations")) {
+                ArchipelagoMessage msg;
+                msg.type = ArchipelagoMessageType::ROOM_UPDATE;
+                for (const auto& id : cmd["checked_locations"]) {
+                    msg.checkedLocations.push_back(id.asInt64());
+                }
+                m_recvQueue.Push(std::move(msg));
+            }
             
-            std::lock_guard<std::mutex> lock(m_recvMutex);
-            m_recvQueue.push(msg);
+        } else if (cmdType == "DataPackage") {
+            m_dataPackages.Store(cmd["data"]["games"]);
         }
         // Add other message types as needed
     }
@@ -291,6 +375,50 @@ bool ArchipelagoSocket::ProcessMessage(const std::string& message) {
     return true;
 }
 
+void ArchipelagoSocket::DecodePrintJSON(const Json::Value& cmd, ArchipelagoMessage& msg) {
+    const auto& parts = cmd["data"];
+    msg.segments.reserve(parts.size());
+    for (const auto& part : parts) {
+        ArchipelagoPrintSegment segment;
+        segment.text = part.get("text", "").asString();
+        segment.type = part.get("type", "").asString();
+        
+        // Item and location parts carry the raw ID as their text and the
+        // slot whose game the ID belongs to as their player.
+        if (segment.type == "item_id" || segment.type == "location_id") {
+            int64_t id = strtoll(segment.text.c_str(), nullptr, 10);
+            std::string game = GetSlotGame(part.get("player", 0).asInt());
+            const char* name = segment.type == "item_id" ? m_dataPackages.GetItemName(id, game) : m_dataPackages.GetLocationName(id, game);
+            if (name != nullptr) {
+                segment.text = name;
+            }
+        }
+        msg.data += segment.text;
+        msg.segments.push_back(std::move(segment));
+    }
+}
+
+void ArchipelagoSocket::ReadSlotInfo(const Json::Value& cmd) {
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    m_slotGames.clear();
+    m_slotGames[0] = "Archipelago";     // items and locations of the server itself
+    m_slot = cmd.get("slot", -1).asInt();
+    
+    const auto& slotInfo = cmd["slot_info"];
+    if (slotInfo.isObject()) {
+        for (auto it = slotInfo.begin(); it != slotInfo.end(); ++it) {
+            int slot = atoi(it.name().c_str());
+            m_slotGames[slot] = (*it).get("game", "").asString();
+        }
+    }
+}
+
+std::string ArchipelagoSocket::GetSlotGame(int slot) const {
+    std::lock_guard<std::mutex> lock(m_slotMutex);
+    auto it = m_slotGames.find(slot < 0 ? m_slot : slot);
+    return it != m_slotGames.end() ? it->second : std::string();
+}
+
 bool ArchipelagoSocket::SendHandshake() {
     Json::Value handshake;
     handshake[0]["cmd"] = "Connect";
@@ -321,20 +449,24 @@ bool ArchipelagoSocket::SendHandshake() {
     return m_webSocket.send(jsonStr).success;
 }
 
-bool ArchipelagoSocket::SendJson(const Json::Value& json) {
+bool ArchipelagoSocket::SendJson(const Json::Value& json, size_t* bytes) {
     if (!m_connected) {
-        m_lastError = "Not connected";
+        SetLastError("Not connected");
         return false;
     }
     
     std::ostringstream oss;
     m_jsonWriter->write(json, &oss);
-    return m_webSocket.send(oss.str()).success;
+    std::string str = oss.str();
+    if (bytes != nullptr) {
+        *bytes = str.size();
+    }
+    return m_webSocket.send(str).success;
 }
 
 bool ArchipelagoSocket::SendMessage(const ArchipelagoMessage& msg) {
     if (!m_connected) {
-        m_lastError = "Not connected";
+        SetLastError("Not connected");
         return false;
     }
     
@@ -360,61 +492,11 @@ bool ArchipelagoSocket::SendMessage(const ArchipelagoMessage& msg) {
 }
 
 bool ArchipelagoSocket::ReceiveMessage(ArchipelagoMessage& msg) {
-    std::lock_guard<std::mutex> lock(m_recvMutex);
-    
-    if (m_recvQueue.empty()) {
-        return false;
-    }
-    
-    msg = m_recvQueue.front();
-    m_recvQueue.pop();
-    return true;
+    return m_recvQueue.Pop(msg);
 }
 
 bool ArchipelagoSocket::HasPendingMessages() const {
-    std::lock_guard<std::mutex> lock(m_recvMutex);
-    return !m_recvQueue.empty();
-}
-
-bool ArchipelagoSocket::WaitForConnection(int timeoutMs) {
-    auto start = std::chrono::steady_clock::now();
-    
-    while (!m_connected && !m_sslFailed) {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-        
-        if (elapsed >= timeoutMs) {
-            m_lastError = "Connection timeout";
-            return false;
-        }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    
-    return m_connected;
-}
-
-bool ArchipelagoSocket::WaitForAuthentication(int timeoutMs) {
-    auto start = std::chrono::steady_clock::now();
-    
-    while (m_connected && !m_authenticated) {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-        
-        if (elapsed >= timeoutMs) {
-            m_lastError = "Authentication timeout";
-            return false;
-        }
-        
-        if (!m_connected) {
-            m_lastError = "Connection lost during authentication";
-            return false;
-        }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    
-    return m_authenticated;
+    return m_recvQueue.Depth() > 0;
 }
 
 std::string ArchipelagoSocket::GenerateUUID() {
@@ -451,6 +533,15 @@ std::string ArchipelagoSocket::GenerateUUID() {
 }
 
 std::string ArchipelagoSocket::GetConnectionInfo() const {
+    switch (GetState()) {
+        case ArchipelagoConnectionState::CONNECTING:
+            return "Connecting to " + m_host + ":" + std::to_string(m_port);
+        case ArchipelagoConnectionState::RECONNECT_WAIT:
+            return "Waiting to reconnect to " + m_host + ":" + std::to_string(m_port);
+        default:
+            break;
+    }
+    
     if (!m_connected) {
         return "Not connected";
     }
@@ -1,13 +1,17 @@
 #pragma once
 
 #include <string>
-#include <queue>
+#include <vector>
+#include <map>
 #include <mutex>
 #include <atomic>
 #include <memory>
 #include <thread>
+#include <chrono>
 #include <json/json.h>  // vcpkg style include
 #include <ixwebsocket/IXWebSocket.h>
+#include "archipelago_datapackage.h"
+#include "archipelago_reconnect.h"
 
 // Forward declare Printf if not available
 #ifndef Printf
@@ -28,13 +32,86 @@ enum class ArchipelagoMessageType : uint8_t {
     DISCONNECT = 11,
     PING = 12,
     PONG = 13,
+    ROOM_UPDATE = 14,
     MSG_ERROR = 0xFF
 };
 
+// Received packets are decoded into these on the websocket thread, so the
+// game thread never has to walk a JSON tree.
+struct ArchipelagoNetworkItem {
+    int64_t item;
+    int64_t location;
+    int player;
+    int flags;
+    const char* itemName = nullptr;         // from the DataPackages, nullptr if unknown
+    const char* locationName = nullptr;
+};
+
+struct ArchipelagoPrintSegment {
+    std::string text;
+    std::string type;       // "player_id", "item_id", "location_id", ... or empty for plain text
+};
+
 struct ArchipelagoMessage {
     ArchipelagoMessageType type;
     std::string data;
-    Json::Value json;
+    Json::Value json;       // only for outgoing messages
+    
+    int slot = -1;                                      // CONNECTED
+    std::string seedName;                               // CONNECTED, from RoomInfo
+    int itemIndex = 0;                                  // DATA: index of the first item
+    std::vector<ArchipelagoNetworkItem> items;          // DATA (ReceivedItems)
+    std::vector<int64_t> checkedLocations;              // CONNECTED, ROOM_UPDATE
+    std::vector<int64_t> missingLocations;              // CONNECTED
+    std::vector<ArchipelagoPrintSegment> segments;      // PRINT_JSON
+};
+
+// Unbounded queue for one consumer that never takes a lock. Producers
+// exchange the head pointer, the consumer follows the links from the tail.
+class ArchipelagoMessageQueue {
+public:
+    ArchipelagoMessageQueue() : m_head(new Node), m_tail(m_head.load()) {}
+    ~ArchipelagoMessageQueue() {
+        ArchipelagoMessage msg;
+        while (Pop(msg)) {}
+        delete m_tail;
+    }
+    
+    void Push(ArchipelagoMessage&& msg) {
+        Node* node = new Node;
+        node->msg = std::move(msg);
+        int depth = ++m_depth;      // before linking so Pop can't take it below zero
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+        int peak = m_peak.load(std::memory_order_relaxed);
+        while (depth > peak && !m_peak.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {}
+    }
+    
+    bool Pop(ArchipelagoMessage& msg) {
+        Node* next = m_tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        msg = std::move(next->msg);
+        delete m_tail;
+        m_tail = next;
+        --m_depth;
+        return true;
+    }
+    
+    int Depth() const { return m_depth; }
+    int PeakDepth() const { return m_peak; }
+    
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        ArchipelagoMessage msg;
+    };
+    
+    std::atomic<Node*> m_head;      // last pushed node
+    Node* m_tail;                   // already consumed node, consumer only
+    std::atomic<int> m_depth{ 0 };
+    std::atomic<int> m_peak{ 0 };
 };
 
 class ArchipelagoSocket {
@@ -42,48 +119,81 @@ public:
     ArchipelagoSocket();
     ~ArchipelagoSocket();
     
-    // Connect with slot name and optional password
+    // Connect with slot name and optional password. Returns false if the
+    // connection attempt could not be started. host may start with ws:// or
+    // wss:// to skip trying the other one.
     bool Connect(const std::string& host, uint16_t port, 
                  const std::string& slotName, 
                  const std::string& password = "");
+    void Disconnect();
+    
+    // Advances the connection state machine, call once per frame
+    void Update();
+    ArchipelagoConnectionState GetState() const { return m_reconnect.GetState(); }
     
     bool SendMessage(const ArchipelagoMessage& msg);
-    bool SendJson(const Json::Value& json);
+    bool SendJson(const Json::Value& json, size_t* bytes = nullptr);
     bool ReceiveMessage(ArchipelagoMessage& msg);
     bool HasPendingMessages() const;
+    int GetBacklog() const { return m_recvQueue.Depth(); }
+    int GetPeakBacklog() const { return m_recvQueue.PeakDepth(); }
     
     bool IsConnected() const { return m_connected && m_authenticated; }
     bool IsSocketConnected() const { return m_connected; }
     std::string GetConnectionInfo() const;
-    std::string GetLastError() const { return m_lastError; }
+    std::string GetLastError() const { std::lock_guard<std::mutex> lock(m_errorMutex); return m_lastError; }
     std::string GetSlotName() const { return m_slotName; }
+    const ArchipelagoDataPackageCache& GetDataPackages() const { return m_dataPackages; }
+    
+    // Game of a slot in the multiworld, empty before Connected arrived.
+    // Slot 0 is the server itself. -1 is our own slot.
+    std::string GetSlotGame(int slot = -1) const;
     
 private:
     
+    void OnMessage(const ix::WebSocketMessagePtr& msg);
+    void OnOpen();
+    void OnError(const std::string& error);
+    void OnClose();
+    
     bool SendHandshake();
     bool ProcessMessage(const std::string& message);
-    bool WaitForConnection(int timeoutMs = 5000);
-    bool WaitForAuthentication(int timeoutMs = 30000);
+    void DecodePrintJSON(const Json::Value& cmd, ArchipelagoMessage& msg);
+    void ReadSlotInfo(const Json::Value& cmd);
+    void StartAttempt(bool ssl);
+    void FailAttempt(const std::string& reason);
+    void SetLastError(const std::string& error);
     std::string GenerateUUID();
     
     ix::WebSocket m_webSocket;
     std::atomic<bool> m_connected;
     std::atomic<bool> m_authenticated;
     std::atomic<bool> m_sslFailed;
+    std::atomic<bool> m_refused;
+    std::atomic<bool> m_socketError;
+    
+    ArchipelagoReconnect m_reconnect;
     
     std::string m_host;
     uint16_t m_port;
     std::string m_slotName;
     std::string m_password;
     std::string m_lastError;
+    mutable std::mutex m_errorMutex;    // m_lastError is set from the websocket thread
     
     // Server version info
     int m_serverVersionMajor;
     int m_serverVersionMinor;
     int m_serverVersionBuild;
     
-    std::queue<ArchipelagoMessage> m_recvQueue;
-    mutable std::mutex m_recvMutex;
+    ArchipelagoMessageQueue m_recvQueue;
+    ArchipelagoDataPackageCache m_dataPackages;
+    
+    // From Connected's slot_info, names are resolved against these
+    std::map<int, std::string> m_slotGames;
+    int m_slot = -1;
+    std::string m_seedName;         // of the current RoomInfo, only used on the websocket thread
+    mutable std::mutex m_slotMutex;
     
     Json::CharReaderBuilder m_jsonReaderBuilder;
     Json::StreamWriterBuilder m_jsonWriterBuilder;
@@ -0,0 +1,164 @@
+#include "c_dispatch.h"
+#include "c_cvars.h"
+#include "doomtype.h"
+#include <ixwebsocket/IXNetSystem.h>
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// A minimal Archipelago server on localhost, so the client's connect,
+// reconnect and backoff handling can be tried without a real multiworld:
+//
+//   archipelago_standin start 38281
+//   archipelago_connect Player ws://localhost:38281
+//   archipelago_standin stop      -> "Connection lost", retries after 1, 2, 4 ... 30 seconds
+//   archipelago_standin start     -> the next retry connects, the delay starts over at 1
+//   archipelago_standin drop      -> closes the connection, reconnects after 1 second
+//   archipelago_standin mute      -> no RoomInfo, "Authentication timeout" after 30 seconds
+//   archipelago_standin refuse    -> ConnectionRefused, the client gives up
+//
+// Every connection is logged with the time since the previous one, which is
+// the retry delay the client actually used.
+
+static std::unique_ptr<ix::WebSocketServer> s_standIn;
+static int s_standInPort = 38281;
+static std::atomic<bool> s_standInMute(false);
+static std::atomic<bool> s_standInRefuse(false);
+
+static std::mutex s_attemptMutex;
+static std::chrono::steady_clock::time_point s_lastAttempt;
+static int s_attempts = 0;
+
+static void StandIn_Send(ix::WebSocket& client, const Json::Value& cmd) {
+    Json::Value packet(Json::arrayValue);
+    packet.append(cmd);
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    client.sendText(Json::writeString(writer, packet));
+}
+
+static void StandIn_Open(ix::WebSocket& client) {
+    {
+        std::lock_guard<std::mutex> lock(s_attemptMutex);
+        auto now = std::chrono::steady_clock::now();
+        if (s_attempts++ == 0) {
+            Printf("Stand-in: connection #%d\n", s_attempts);
+        } else {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - s_lastAttempt).count();
+            Printf("Stand-in: connection #%d, %.1f seconds after the previous one\n", s_attempts, ms / 1000.0);
+        }
+        s_lastAttempt = now;
+    }
+
+    if (s_standInMute) {
+        return;
+    }
+
+    Json::Value room;
+    room["cmd"] = "RoomInfo";
+    room["version"]["major"] = 0;
+    room["version"]["minor"] = 5;
+    room["version"]["build"] = 0;
+    room["version"]["class"] = "Version";
+    room["games"].append("Selaco");
+    room["datapackage_checksums"] = Json::Value(Json::objectValue);    // nothing to fetch
+    StandIn_Send(client, room);
+}
+
+static void StandIn_Message(ix::WebSocket& client, const std::string& text) {
+    Json::Value root;
+    Json::CharReaderBuilder reader;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> parser(reader.newCharReader());
+    if (!parser->parse(text.data(), text.data() + text.size(), &root, &errs) || !root.isArray()) {
+        Printf(TEXTCOLOR_RED "Stand-in: unreadable packet: %s\n", errs.c_str());
+        return;
+    }
+
+    for (const auto& cmd : root) {
+        std::string type = cmd.get("cmd", "").asString();
+        if (type != "Connect") {
+            continue;
+        }
+
+        Json::Value reply;
+        if (s_standInRefuse) {
+            reply["cmd"] = "ConnectionRefused";
+            reply["errors"].append("InvalidSlot");
+        } else {
+            reply["cmd"] = "Connected";
+            reply["team"] = 0;
+            reply["slot"] = 1;
+            reply["players"] = Json::Value(Json::arrayValue);
+            reply["missing_locations"] = Json::Value(Json::arrayValue);
+            reply["checked_locations"] = Json::Value(Json::arrayValue);
+            reply["slot_info"]["1"]["name"] = cmd.get("name", "").asString();
+            reply["slot_info"]["1"]["game"] = "Selaco";
+            reply["slot_info"]["1"]["type"] = 1;
+            reply["hint_points"] = 0;
+        }
+        Printf("Stand-in: %s '%s'\n", s_standInRefuse ? "refused" : "accepted", cmd.get("name", "").asCString());
+        StandIn_Send(client, reply);
+    }
+}
+
+static bool StandIn_Start(int port) {
+    ix::initNetSystem();
+
+    auto server = std::make_unique<ix::WebSocketServer>(port, "127.0.0.1");
+    server->setOnClientMessageCallback([](std::shared_ptr<ix::ConnectionState>, ix::WebSocket& client, const ix::WebSocketMessagePtr& msg) {
+        if (msg->type == ix::WebSocketMessageType::Open) {
+            StandIn_Open(client);
+        } else if (msg->type == ix::WebSocketMessageType::Message) {
+            StandIn_Message(client, msg->str);
+        }
+    });
+
+    auto result = server->listen();
+    if (!result.first) {
+        Printf(TEXTCOLOR_RED "Stand-in: can't listen on port %d: %s\n", port, result.second.c_str());
+        return false;
+    }
+    server->start();
+    s_standIn = std::move(server);
+    s_standInPort = port;
+    Printf(TEXTCOLOR_GREEN "Stand-in: listening on ws://localhost:%d\n", port);
+    return true;
+}
+
+CCMD(archipelago_standin) {
+    std::string action = argv.argc() >= 2 ? argv[1] : "";
+
+    if (action == "start") {
+        if (s_standIn) {
+            Printf("Stand-in: already listening on port %d\n", s_standInPort);
+            return;
+        }
+        StandIn_Start(argv.argc() >= 3 ? atoi(argv[2]) : s_standInPort);
+    } else if (action == "stop") {
+        if (s_standIn) {
+            s_standIn->stop();
+            s_standIn.reset();
+            Printf("Stand-in: stopped\n");
+        }
+    } else if (action == "drop") {
+        if (s_standIn) {
+            for (const auto& client : s_standIn->getClients()) {
+                client->close();
+            }
+        }
+    } else if (action == "mute") {
+        s_standInMute = !s_standInMute;
+        Printf("Stand-in: RoomInfo %s\n", s_standInMute ? "withheld" : "sent");
+    } else if (action == "refuse") {
+        s_standInRefuse = !s_standInRefuse;
+        Printf("Stand-in: %s connections\n", s_standInRefuse ? "refusing" : "accepting");
+    } else {
+        std::lock_guard<std::mutex> lock(s_attemptMutex);
+        Printf("Usage: archipelago_standin start [port] | stop | drop | mute | refuse\n");
+        Printf("  %s, %d connections so far\n", s_standIn ? "listening" : "not running", s_attempts);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef __V_2DBATCH_H
+#define __V_2DBATCH_H
+
+#include <algorithm>
+#include <string.h>
+#include "tarray.h"
+#include "vectors.h"
+
+//==========================================================================
+//
+// Batch2DCommands
+//
+// The reordering behind F2DDrawer::Batch. It only needs the index range and
+// counts of the commands, so it is a template over the command type and can
+// be tested without the drawer or a renderer.
+//
+// compatible(a, b) tells if two commands can be drawn together, bounds(cmd,
+// box) returns false for commands that must not be moved over, otherwise it
+// fills in the screen space bounds of the command.
+//
+//==========================================================================
+
+enum
+{
+	BATCH_LOOKBACK = 64,	// how many earlier commands to check for a match
+};
+
+inline bool Batch2DOverlaps(const FVector4 &a, const FVector4 &b)
+{
+	// Touching edges do not share any pixels.
+	return a.X < b.Z && b.X < a.Z && a.Y < b.W && b.Y < a.W;
+}
+
+template<class Command, class Compatible, class Bounds>
+void Batch2DCommands(TArray<Command> &data, TArray<int> &dataIndices, Compatible compatible, Bounds bounds)
+{
+	unsigned count = data.Size();
+	if (count < 3) return;	// AddCommand already merged neighbours
+
+	struct FBatch
+	{
+		unsigned first, last;	// chained through next[]
+		FVector4 box;
+		bool movable;
+	};
+	TArray<FBatch> batches(count);
+	TArray<int> next(count, true);
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto &cmd = data[i];
+		FVector4 box;
+		bool movable = bounds(cmd, box);
+		next[i] = -1;
+
+		if (movable)
+		{
+			bool merged = false;
+			int stop = std::max(0, (int)batches.Size() - BATCH_LOOKBACK);
+			for (int b = (int)batches.Size() - 1; b >= stop; b--)
+			{
+				auto &batch = batches[b];
+				if (!batch.movable) break;
+				if (compatible(cmd, data[batch.first]))
+				{
+					next[batch.last] = i;
+					batch.last = i;
+					batch.box.X = std::min(batch.box.X, box.X);
+					batch.box.Y = std::min(batch.box.Y, box.Y);
+					batch.box.Z = std::max(batch.box.Z, box.Z);
+					batch.box.W = std::max(batch.box.W, box.W);
+					merged = true;
+					break;
+				}
+				if (Batch2DOverlaps(batch.box, box)) break;
+			}
+			if (merged) continue;
+		}
+		batches.Push({ i, i, box, movable });
+	}
+
+	if (batches.Size() == count) return;
+
+	TArray<Command> commands(batches.Size());
+	TArray<int> indices(dataIndices.Size());
+	for (auto &batch : batches)
+	{
+		Command cmd = data[batch.first];
+		cmd.mIndexIndex = indices.Size();
+		cmd.mIndexCount = 0;
+		cmd.mVertCount = 0;
+		for (int m = batch.first; m != -1; m = next[m])
+		{
+			auto &member = data[m];
+			if (member.mIndexCount > 0)
+			{
+				auto at = indices.Reserve(member.mIndexCount);
+				memcpy(&indices[at], &dataIndices[member.mIndexIndex], member.mIndexCount * sizeof(int));
+			}
+			cmd.mIndexCount += member.mIndexCount;
+			cmd.mVertCount += member.mVertCount;
+		}
+		commands.Push(cmd);
+	}
+	data = std::move(commands);
+	dataIndices = std::move(indices);
+}
+
+#endif
@@ -33,8 +33,10 @@
 */
 
 #include <stdarg.h>
+#include <float.h>
 
 #include "v_2ddrawer.h"
+#include "v_2dbatch.h"
 #include "vectors.h"
 #include "vm.h"
 #include "c_cvars.h"
@@ -235,6 +237,54 @@ int F2DDrawer::AddCommand(RenderCommand *data)
 	}
 }
 
+//==========================================================================
+//
+// Batch
+//
+// AddCommand can only merge a command with the one right before it, so a
+// HUD that alternates between textures, font pages and solid quads ends up
+// with one draw call per element. This merges each command into the latest
+// compatible earlier one, as long as none of the commands it has to be
+// moved in front of overlap it. Blending order only matters where things
+// overlap, so the result looks the same as drawing everything in order.
+//
+// Stencil and shape commands, lines, points and transformed commands are
+// never moved over. Afterwards mIndices is rebuilt so that each merged
+// command's indices are contiguous again.
+//
+// This only works on the command list, so it can run without a renderer.
+// The reordering itself is Batch2DCommands in v_2dbatch.h.
+//
+//==========================================================================
+
+bool F2DDrawer::GetBatchBounds(const RenderCommand &cmd, FVector4 &box) const
+{
+	if (cmd.isSpecial != SpecialDrawCommand::NotSpecial || cmd.shape2DBufInfo != nullptr ||
+		cmd.mType != DrawTypeTriangles || cmd.useTransform || cmd.mIndexCount == 0)
+	{
+		return false;
+	}
+
+	box = FVector4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = cmd.mIndexIndex; i < cmd.mIndexIndex + cmd.mIndexCount; i++)
+	{
+		auto &v = mVertices[mIndices[i]];
+		box.X = min(box.X, v.x);
+		box.Y = min(box.Y, v.y);
+		box.Z = max(box.Z, v.x);
+		box.W = max(box.W, v.y);
+	}
+	return true;
+}
+
+void F2DDrawer::Batch()
+{
+	mUnbatchedCount = mData.Size();
+	Batch2DCommands(mData, mIndices,
+		[](const RenderCommand &a, const RenderCommand &b) { return a.isCompatible(b); },
+		[this](const RenderCommand &cmd, FVector4 &box) { return GetBatchBounds(cmd, box); });
+}
+
 //==========================================================================
 //
 //
@@ -1189,6 +1239,182 @@ void F2DDrawer::AddClearStencil()
 	AddCommand(&dg);
 }
 
+//==========================================================================
+//
+// Recording
+//
+// Takes a copy of everything that was added between BeginRecording and
+// EndRecording. The first command may have been merged into one that was
+// already there, in which case only its own part is taken.
+//
+//==========================================================================
+
+void F2DDrawer::BeginRecording(RecordMark &mark) const
+{
+	mark.mVert = mVertices.Size();
+	mark.mIndex = mIndices.Size();
+	mark.mCommand = mData.Size();
+	if (mark.mCommand > 0) mark.mLast = mData.Last();
+}
+
+void F2DDrawer::EndRecording(const RecordMark &mark, Recording &rec) const
+{
+	unsigned numverts = mVertices.Size() - mark.mVert;
+	unsigned numindices = mIndices.Size() - mark.mIndex;
+
+	rec.mVertices.Resize(numverts);
+	if (numverts > 0) memcpy(&rec.mVertices[0], &mVertices[mark.mVert], numverts * sizeof(TwoDVertex));
+	rec.mIndices.Resize(numindices);
+	for (unsigned i = 0; i < numindices; i++)
+	{
+		rec.mIndices[i] = mIndices[mark.mIndex + i] - mark.mVert;
+	}
+
+	rec.mCommands.Clear();
+	rec.mWidth = Width;
+	rec.mHeight = Height;
+	rec.mReplayable = true;
+	rec.mHasText = false;
+	rec.mTextGeneration = TextGeneration;
+
+	unsigned cmd = mark.mCommand;
+	if (cmd > 0 && mData[cmd - 1].mIndexCount != mark.mLast.mIndexCount)
+	{
+		cmd--;
+	}
+	for (; cmd < mData.Size(); cmd++)
+	{
+		auto dg = mData[cmd];
+		if (cmd < mark.mCommand)
+		{
+			dg.mIndexCount -= mark.mLast.mIndexCount;
+			dg.mVertCount -= mark.mLast.mVertCount;
+			dg.mIndexIndex = mark.mIndex;
+			dg.mVertIndex = mark.mVert;
+		}
+		if (dg.shape2DBufInfo != nullptr) rec.mReplayable = false;
+		dg.mIndexIndex -= mark.mIndex;
+		dg.mVertIndex -= mark.mVert;
+		rec.mCommands.Push(dg);
+	}
+}
+
+//==========================================================================
+//
+// Replay
+//
+// Adds a recording again, optionally moved and faded. Since fading is done
+// through the vertex colors it works with every style that blends by
+// source alpha.
+//
+//==========================================================================
+
+void F2DDrawer::Replay(const Recording &rec, float alpha, const DVector2 &offs)
+{
+	// The vertex alpha is scaled in 8 bits and would wrap above 1.
+	alpha = clamp(alpha, 0.f, 1.f);
+	unsigned firstvert = mVertices.Size();
+	unsigned firstindex = mIndices.Size();
+	unsigned numverts = rec.mVertices.Size();
+	if (numverts > 0)
+	{
+		mVertices.Reserve(numverts);
+		TwoDVertex *dest = &mVertices[firstvert];
+		memcpy(dest, &rec.mVertices[0], numverts * sizeof(TwoDVertex));
+		if (offs.X != 0 || offs.Y != 0 || alpha != 1.f)
+		{
+			for (unsigned i = 0; i < numverts; i++)
+			{
+				dest[i].x += (float)offs.X;
+				dest[i].y += (float)offs.Y;
+				dest[i].color0.a = uint8_t(dest[i].color0.a * alpha);
+			}
+		}
+	}
+	if (rec.mIndices.Size() > 0)
+	{
+		mIndices.Reserve(rec.mIndices.Size());
+		int *dest = &mIndices[firstindex];
+		for (auto index : rec.mIndices)
+		{
+			*dest++ = index + firstvert;
+		}
+	}
+	for (auto dg : rec.mCommands)
+	{
+		dg.mIndexIndex += firstindex;
+		dg.mVertIndex += firstvert;
+		if (dg.mFlags & DTF_Scissor)
+		{
+			dg.mScissor[0] += int(offs.X);
+			dg.mScissor[1] += int(offs.Y);
+			dg.mScissor[2] += int(offs.X);
+			dg.mScissor[3] += int(offs.Y);
+		}
+		AddCommand(&dg);
+	}
+}
+
+//==========================================================================
+//
+// Retained layers
+//
+// For HUD panels and menu backgrounds that rarely change:
+//
+//	if (!Screen.DrawLayer('panel'))
+//	{
+//		Screen.BeginLayer('panel');
+//		... draw the panel ...
+//		Screen.EndLayer();
+//	}
+//
+// The first frame draws the panel normally and keeps a copy of the output,
+// every following frame just copies that into the draw list. Nothing checks
+// whether the contents would still be the same, the layer is only drawn
+// again after InvalidateLayer or when the screen size changes. Layers with
+// text are also drawn again after the fonts or their translations changed,
+// since they refer to the font textures and translations.
+//
+//==========================================================================
+
+unsigned F2DDrawer::TextGeneration;
+
+bool F2DDrawer::BeginLayer(FName id)
+{
+	if (mRecordingLayer != NAME_None) return false;	// no nesting
+	mRecordingLayer = id;
+	mLayerHasText = false;
+	BeginRecording(mLayerMark);
+	return true;
+}
+
+void F2DDrawer::EndLayer()
+{
+	if (mRecordingLayer == NAME_None) return;
+	auto &rec = mLayers[mRecordingLayer];
+	EndRecording(mLayerMark, rec);
+	rec.mHasText = mLayerHasText;
+	mRecordingLayer = NAME_None;
+}
+
+bool F2DDrawer::DrawLayer(FName id, float alpha, const DVector2 &offs)
+{
+	auto rec = mLayers.CheckKey(id);
+	if (rec == nullptr || !rec->mReplayable || rec->mWidth != Width || rec->mHeight != Height ||
+		(rec->mHasText && rec->mTextGeneration != TextGeneration))
+	{
+		return false;
+	}
+	Replay(*rec, alpha, offs);
+	return true;
+}
+
+void F2DDrawer::InvalidateLayer(FName id)
+{
+	if (id == NAME_None) mLayers.Clear();
+	else mLayers.Remove(id);
+}
+
 //==========================================================================
 //
 //
@@ -1203,6 +1429,7 @@ void F2DDrawer::Clear()
 		mIndices.Clear();
 		mData.Clear();
 		mIsFirstPass = true;
+		mRecordingLayer = NAME_None;	// unfinished layers are lost
 	}
 	screenFade = 1.f;
 }
@@ -189,6 +189,25 @@ public:
 		}
 	};
 
+	// Output of a block of draw calls that can be added again later without
+	// redoing whatever produced it. Vertex and index offsets are relative.
+	struct Recording
+	{
+		TArray<TwoDVertex> mVertices;
+		TArray<int> mIndices;
+		TArray<RenderCommand> mCommands;
+		int mWidth, mHeight;		// drawer size when recorded
+		bool mReplayable;			// false if it contains shapes, which manage their own buffers
+		bool mHasText;				// layers only: contains font glyphs
+		unsigned mTextGeneration;	// TextGeneration when recorded
+	};
+
+	struct RecordMark
+	{
+		unsigned mVert, mIndex, mCommand;
+		RenderCommand mLast;		// for finding out whether the first command was merged into it
+	};
+
 	TArray<int> mIndices;
 	TArray<TwoDVertex> mVertices;
 	TArray<RenderCommand> mData;
@@ -204,7 +223,28 @@ public:
 
 	int AddCommand(RenderCommand *data);
 	void AddIndices(int firstvert, int count, ...);
+	void Batch();
+
+	void BeginRecording(RecordMark &mark) const;
+	void EndRecording(const RecordMark &mark, Recording &rec) const;
+	void Replay(const Recording &rec, float alpha = 1.f, const DVector2 &offs = { 0, 0 });
+
+	bool BeginLayer(FName id);
+	void EndLayer();
+	bool DrawLayer(FName id, float alpha = 1.f, const DVector2 &offs = { 0, 0 });
+	void InvalidateLayer(FName id);
+	// Text drawing calls MarkText, so a layer only has to be redrawn when the fonts change.
+	void MarkText() { mLayerHasText = true; }
+	// Fonts were deleted or their translations rebuilt. Applies to all drawers, canvases included.
+	static void InvalidateText() { TextGeneration++; }
 private:
+	bool GetBatchBounds(const RenderCommand &cmd, FVector4 &box) const;
+
+	static unsigned TextGeneration;
+	TMap<FName, Recording> mLayers;
+	FName mRecordingLayer = NAME_None;
+	bool mLayerHasText = false;
+	RecordMark mLayerMark;
 	void AddIndices(int firstvert, TArray<int> &v);
 	bool SetStyle(FGameTexture *tex, DrawParms &parms, PalEntry &color0, RenderCommand &quad);
 	void SetColorOverlay(PalEntry color, float alpha, PalEntry &vertexcolor, PalEntry &overlaycolor);
@@ -274,6 +314,7 @@ public:
 	}
 
 	bool mIsFirstPass = true;
+	unsigned mUnbatchedCount = 0;	// command count before Batch()
 };
 
 // DCanvas is already taken so using FCanvas instead.
@@ -880,6 +880,7 @@ bool ParseDrawTextureTags(F2DDrawer *drawer, FGameTexture *img, double x, double
 		return false;
 	}
 
+	memset((void*)parms, 0, sizeof(*parms));	// the glyph run cache compares these as a whole
 	parms->fortext = type == DrawTexture_Text;
 	parms->windowleft = 0;
 	parms->windowright = INT_MAX;
@@ -2010,3 +2011,83 @@ DEFINE_ACTION_FUNCTION(FCanvas, ClearTransform)
 	self->Tex->NeedUpdate();
 	return 0;
 }
+
+DEFINE_ACTION_FUNCTION(_Screen, BeginLayer)
+{
+	PARAM_PROLOGUE;
+	PARAM_NAME(id);
+
+	if (!twod->HasBegun2D()) ThrowAbortException(X_OTHER, "Attempt to draw to screen outside a draw function");
+
+	ACTION_RETURN_BOOL(twod->BeginLayer(id));
+}
+
+DEFINE_ACTION_FUNCTION(FCanvas, BeginLayer)
+{
+	PARAM_SELF_PROLOGUE(FCanvas);
+	PARAM_NAME(id);
+
+	ACTION_RETURN_BOOL(self->Drawer.BeginLayer(id));
+}
+
+DEFINE_ACTION_FUNCTION(_Screen, EndLayer)
+{
+	PARAM_PROLOGUE;
+
+	if (!twod->HasBegun2D()) ThrowAbortException(X_OTHER, "Attempt to draw to screen outside a draw function");
+
+	twod->EndLayer();
+	return 0;
+}
+
+DEFINE_ACTION_FUNCTION(FCanvas, EndLayer)
+{
+	PARAM_SELF_PROLOGUE(FCanvas);
+
+	self->Drawer.EndLayer();
+	return 0;
+}
+
+DEFINE_ACTION_FUNCTION(_Screen, DrawLayer)
+{
+	PARAM_PROLOGUE;
+	PARAM_NAME(id);
+	PARAM_FLOAT(alpha);
+	PARAM_FLOAT(x);
+	PARAM_FLOAT(y);
+
+	if (!twod->HasBegun2D()) ThrowAbortException(X_OTHER, "Attempt to draw to screen outside a draw function");
+
+	ACTION_RETURN_BOOL(twod->DrawLayer(id, (float)alpha, DVector2(x, y)));
+}
+
+DEFINE_ACTION_FUNCTION(FCanvas, DrawLayer)
+{
+	PARAM_SELF_PROLOGUE(FCanvas);
+	PARAM_NAME(id);
+	PARAM_FLOAT(alpha);
+	PARAM_FLOAT(x);
+	PARAM_FLOAT(y);
+
+	bool res = self->Drawer.DrawLayer(id, (float)alpha, DVector2(x, y));
+	if (res) self->Tex->NeedUpdate();
+	ACTION_RETURN_BOOL(res);
+}
+
+DEFINE_ACTION_FUNCTION(_Screen, InvalidateLayer)
+{
+	PARAM_PROLOGUE;
+	PARAM_NAME(id);
+
+	twod->InvalidateLayer(id);
+	return 0;
+}
+
+DEFINE_ACTION_FUNCTION(FCanvas, InvalidateLayer)
+{
+	PARAM_SELF_PROLOGUE(FCanvas);
+	PARAM_NAME(id);
+
+	self->Drawer.InvalidateLayer(id);
+	return 0;
+}
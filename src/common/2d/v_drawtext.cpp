@@ -43,6 +43,11 @@
 #include "gstrings.h"
 #include "vm.h"
 #include "printf.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "stats.h"
+#include <string>
+#include <unordered_map>
 
 
 int ListGetInt(VMVa_List &tags);
@@ -189,6 +194,7 @@ void DrawChar(F2DDrawer *drawer, FFont* font, int normalcolor, double x, double
 		PalEntry color = 0xffffffff;
 		if (!palettetrans) parms.TranslationId = font->GetColorTranslation((EColorRange)normalcolor, &color);
 		parms.color = PalEntry((color.a * parms.color.a) / 255, (color.r * parms.color.r) / 255, (color.g * parms.color.g) / 255, (color.b * parms.color.b) / 255);
+		drawer->MarkText();
 		drawer->AddTexture(pic, parms);
 	}
 }
@@ -214,6 +220,7 @@ void DrawChar(F2DDrawer *drawer,  FFont *font, int normalcolor, double x, double
 		PalEntry color = 0xffffffff;
 		if (!palettetrans) parms.TranslationId = font->GetColorTranslation((EColorRange)normalcolor, &color);
 		parms.color = PalEntry((color.a * parms.color.a) / 255, (color.r * parms.color.r) / 255, (color.g * parms.color.g) / 255, (color.b * parms.color.b) / 255);
+		drawer->MarkText();
 		drawer->AddTexture(pic, parms);
 	}
 }
@@ -265,7 +272,7 @@ DEFINE_ACTION_FUNCTION(FCanvas, DrawChar)
 EColorRange V_ParseFontColor(const char32_t *&color_value, int normalcolor, int boldcolor) { return CR_UNTRANSLATED; }
 
 template<class chartype>
-void DrawTextCommon(F2DDrawer *drawer, FFont *font, int normalcolor, double x, double y, const chartype *string, DrawParms &parms)
+static void DrawTextRun(F2DDrawer *drawer, FFont *font, int normalcolor, double x, double y, const chartype *string, DrawParms &parms)
 {
 	int 		w;
 	const chartype *ch;
@@ -388,6 +395,163 @@ void DrawTextCommon(F2DDrawer *drawer, FFont *font, int normalcolor, double x, d
 	}
 }
 
+//==========================================================================
+//
+// Glyph run cache
+//
+// Most HUD and menu text is the same from one frame to the next. The first
+// time a string is drawn with a given font, color, position and set of draw
+// parameters, the vertices, indices and commands it produces are recorded.
+// After that they are copied into the drawer without looking at a single
+// glyph. The key holds everything the output depends on, so a changed
+// string or parameter simply misses. That includes the drawer size, the
+// clean scaling factors and the active aspect ratio, which the virtual
+// screen and clean modes scale by and which ScaleOverrider and vid_aspect
+// change without touching the parameters.
+//
+// Runs refer to font textures and translations, so everything is thrown
+// away when fonts are deleted or their translations are rebuilt. Retained
+// layers with text are handled by F2DDrawer::InvalidateText.
+//
+//==========================================================================
+
+CVAR(Bool, r_textcache, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+EXTERN_CVAR(Float, transsouls)
+
+enum
+{
+	MAX_GLYPH_RUNS = 1024,
+};
+
+static std::unordered_map<std::string, F2DDrawer::Recording> GlyphRuns;
+static unsigned GlyphRunHits, GlyphRunMisses;
+
+void V_ClearGlyphRuns()
+{
+	GlyphRuns.clear();
+}
+
+template<class chartype>
+static void MakeGlyphRunKey(std::string &key, F2DDrawer *drawer, FFont *font, int normalcolor, double x, double y, const chartype *string, const DrawParms &parms)
+{
+	auto add = [&](const void *data, size_t size) { key.append((const char *)data, size); };
+	float soultrans = transsouls;
+	int screen[6] = { drawer->GetWidth(), drawer->GetHeight(), CleanXfac, CleanYfac, CleanXfac_1, CleanYfac_1 };
+	float ratio = ActiveRatio(drawer->GetWidth(), drawer->GetHeight());
+
+	// ParseDrawTextureTags clears the parms, so the padding compares equal, too.
+	key.clear();
+	add(&font, sizeof(font));
+	add(&normalcolor, sizeof(normalcolor));
+	add(&x, sizeof(x));
+	add(&y, sizeof(y));
+	add(&parms, sizeof(parms));
+	add(&drawer->offset, sizeof(drawer->offset));
+	add(&drawer->transform, sizeof(drawer->transform));
+	add(&soultrans, sizeof(soultrans));
+	add(screen, sizeof(screen));
+	add(&ratio, sizeof(ratio));
+	size_t len = 0;
+	while (string[len] != 0) len++;
+	add(string, len * sizeof(chartype));
+}
+
+template<class chartype>
+void DrawTextCommon(F2DDrawer *drawer, FFont *font, int normalcolor, double x, double y, const chartype *string, DrawParms &parms)
+{
+	drawer->MarkText();
+	if (!r_textcache)
+	{
+		DrawTextRun(drawer, font, normalcolor, x, y, string, parms);
+		return;
+	}
+
+	static std::string key;
+	MakeGlyphRunKey(key, drawer, font, normalcolor, x, y, string, parms);
+	auto it = GlyphRuns.find(key);
+	if (it != GlyphRuns.end())
+	{
+		GlyphRunHits++;
+		drawer->Replay(it->second);
+		return;
+	}
+
+	GlyphRunMisses++;
+	if (GlyphRuns.size() >= MAX_GLYPH_RUNS)
+	{
+		// Text that changes all the time fills this up. Starting over is
+		// cheap since whatever is still on screen gets recorded again.
+		GlyphRuns.clear();
+	}
+
+	F2DDrawer::RecordMark mark;
+	drawer->BeginRecording(mark);
+	DrawTextRun(drawer, font, normalcolor, x, y, string, parms);
+	drawer->EndRecording(mark, GlyphRuns[key]);
+}
+
+ADD_STAT(textcache)
+{
+	FString out;
+	out.Format("Glyph runs: %zu cached, %u hits, %u misses", GlyphRuns.size(), GlyphRunHits, GlyphRunMisses);
+	return out;
+}
+
+//==========================================================================
+//
+// Draws the same text over and over into a scratch drawer, with and
+// without the glyph run cache.
+//
+//==========================================================================
+
+CCMD(drawtextbench)
+{
+	static const char *const texts[] = {
+		"100", "75", "250 / 300", "HEALTH", "ARMOR", "AMMO", "SHIELD",
+		"Press \cd[Use]\c- to interact", "Objective: Reach the elevator",
+		"\cgWARNING:\c- Low health", "Credits: 1250", "Acid Pistol", "Shotgun",
+		"Roaring Cricket", "Level 3 Security Card", "PAUSED", "Save Game", "Load Game",
+	};
+	FFont *fonts[] = { SmallFont, SmallFont2, BigFont, NewSmallFont, ConFont };
+	int count = argv.argc() > 1 ? max(1, atoi(argv[1])) : 1000;
+
+	F2DDrawer bench;
+	bench.SetSize(twod->GetWidth(), twod->GetHeight());
+
+	auto run = [&]()
+	{
+		cycle_t clock;
+		clock.Reset();
+		clock.Clock();
+		for (int i = 0; i < count; i++)
+		{
+			bench.Clear();
+			int y = 8;
+			for (auto font : fonts)
+			{
+				if (font == nullptr) continue;
+				for (auto text : texts)
+				{
+					DrawText(&bench, font, CR_UNTRANSLATED, 8, y, text, DTA_VirtualWidth, 640, DTA_VirtualHeight, 480, TAG_DONE);
+					y = (y + 12) % 480;
+				}
+			}
+		}
+		clock.Unclock();
+		return clock.TimeMS();
+	};
+
+	bool cached = r_textcache;
+	r_textcache = false;
+	double uncached = run();
+	r_textcache = true;
+	V_ClearGlyphRuns();
+	double withcache = run();
+	r_textcache = cached;
+
+	Printf("%d frames of %zu strings: %.3f ms without cache, %.3f ms with cache\n", count, countof(texts), uncached, withcache);
+}
+
 
 // For now the 'drawer' parameter is a placeholder - this should be the way to handle it later to allow different drawers.
 void DrawText(F2DDrawer *drawer, FFont* font, int normalcolor, double x, double y, const char* string, int tag_first, ...)
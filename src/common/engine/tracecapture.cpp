@@ -0,0 +1,234 @@
+/*
+** tracecapture.cpp
+** Timeline capture of scoped timing events
+**
+**---------------------------------------------------------------------------
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/
+**
+**---------------------------------------------------------------------------
+**
+** Usage:
+**   trace start          - start recording (clears the previous capture)
+**   trace stop           - stop recording
+**   trace dump [file]    - write the recorded events, default trace.json
+**
+** Events from all threads go into one ring buffer of trace_buffersize
+** entries, so a long capture only keeps the most recent events. The output
+** is the Chrome trace event format and can be opened in chrome://tracing
+** or ui.perfetto.dev.
+**
+*/
+
+#include "tracecapture.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "files.h"
+#include "printf.h"
+#include "i_time.h"
+#include "tarray.h"
+#include "zstring.h"
+#include "startupinfo.h"
+
+CUSTOM_CVAR(Int, trace_buffersize, 1 << 20, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 4096) self = 4096;
+	else if (self > (1 << 24)) self = 1 << 24;
+}
+
+struct FTraceEvent
+{
+	const char *Name;
+	uint64_t Start;
+	uint64_t End;
+	uint32_t Thread;
+	uint8_t Category;
+};
+
+struct FTraceBuffer
+{
+	TArray<FTraceEvent> Events;
+	unsigned Mask;
+};
+
+std::atomic<bool> TraceActive;
+
+static std::atomic<FTraceBuffer *> TraceBuffer;
+static std::atomic<uint64_t> TraceWriteIndex;
+static std::atomic<uint32_t> TraceNextThread;
+static thread_local uint32_t TraceThread;
+static uint32_t TraceMainThread;
+static uint64_t TraceStartTime;
+
+// Buffers that were replaced stay allocated because a scope that was opened
+// before the capture stopped may still write into them.
+static TArray<FTraceBuffer *> RetiredBuffers;
+
+static const char *const CategoryNames[NUM_TRACE_CATEGORIES] = { "playsim", "thinker", "vm", "render", "loader" };
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+uint64_t Trace_Now()
+{
+	return I_nsTime();
+}
+
+static uint32_t GetTraceThread()
+{
+	if (TraceThread == 0)
+	{
+		TraceThread = TraceNextThread.fetch_add(1) + 1;
+	}
+	return TraceThread;
+}
+
+void Trace_AddEvent(const char *name, int category, uint64_t start, uint64_t end)
+{
+	FTraceBuffer *buffer = TraceBuffer.load(std::memory_order_acquire);
+	if (buffer == nullptr) return;
+
+	uint64_t index = TraceWriteIndex.fetch_add(1, std::memory_order_relaxed);
+	FTraceEvent &ev = buffer->Events[unsigned(index) & buffer->Mask];
+	ev.Name = name;
+	ev.Start = start;
+	ev.End = end;
+	ev.Thread = GetTraceThread();
+	ev.Category = uint8_t(category);
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static void StartTrace()
+{
+	unsigned size = 1;
+	while (size < unsigned(*trace_buffersize)) size <<= 1;
+
+	TraceActive = false;
+	FTraceBuffer *buffer = TraceBuffer.load();
+	if (buffer == nullptr || buffer->Events.Size() != size)
+	{
+		if (buffer != nullptr) RetiredBuffers.Push(buffer);
+		buffer = new FTraceBuffer;
+		buffer->Events.Resize(size);
+		buffer->Mask = size - 1;
+		TraceBuffer.store(buffer, std::memory_order_release);
+	}
+	TraceWriteIndex = 0;
+	TraceMainThread = GetTraceThread();
+	TraceStartTime = Trace_Now();
+	TraceActive = true;
+	Printf("Trace capture started (%u events)\n", size);
+}
+
+static FString JsonEscape(const char *str)
+{
+	FString out;
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\') out += '\\';
+		if ((uint8_t)*str >= 0x20) out += *str;
+	}
+	return out;
+}
+
+static bool WriteTrace(const char *filename)
+{
+	FTraceBuffer *buffer = TraceBuffer.load();
+	if (buffer == nullptr)
+	{
+		Printf("Nothing has been captured\n");
+		return true;
+	}
+
+	FileWriter *fw = FileWriter::Open(filename);
+	if (fw == nullptr)
+	{
+		return false;
+	}
+
+	uint64_t count = TraceWriteIndex.load();
+	uint64_t first = count > buffer->Events.Size() ? count - buffer->Events.Size() : 0;
+	uint32_t numthreads = TraceNextThread.load();
+
+	fw->Printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fw->Printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"%s\"}}", JsonEscape(GameStartupInfo.Name.GetChars()).GetChars());
+	for (uint32_t t = 1; t <= numthreads; t++)
+	{
+		fw->Printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+			t, t == TraceMainThread ? "Main thread" : "Thread", t);
+	}
+	for (uint64_t i = first; i < count; i++)
+	{
+		const FTraceEvent &ev = buffer->Events[unsigned(i) & buffer->Mask];
+		if (ev.Name == nullptr || ev.Start < TraceStartTime) continue;
+
+		fw->Printf(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			JsonEscape(ev.Name).GetChars(), CategoryNames[ev.Category < NUM_TRACE_CATEGORIES ? ev.Category : 0],
+			(ev.Start - TraceStartTime) / 1000., (ev.End - ev.Start) / 1000., ev.Thread);
+	}
+	fw->Printf("\n]}\n");
+	delete fw;
+
+	Printf("%llu trace events written to %s\n", (unsigned long long)(count - first), filename);
+	return true;
+}
+
+//==========================================================================
+//
+// CCMD trace
+//
+//==========================================================================
+
+CCMD(trace)
+{
+	if (argv.argc() < 2)
+	{
+		Printf("Usage: trace start|stop|dump [file]\n");
+		Printf("Capture is %s, %llu events recorded\n", TraceActive ? "running" : "stopped", (unsigned long long)TraceWriteIndex.load());
+		return;
+	}
+
+	if (!stricmp(argv[1], "start"))
+	{
+		StartTrace();
+	}
+	else if (!stricmp(argv[1], "stop"))
+	{
+		TraceActive = false;
+		Printf("Trace capture stopped, %llu events recorded\n", (unsigned long long)TraceWriteIndex.load());
+	}
+	else if (!stricmp(argv[1], "dump"))
+	{
+		// Pause the capture so that the buffer does not get overwritten while writing it.
+		bool active = TraceActive.exchange(false);
+		const char *filename = argv.argc() > 2 ? argv[2] : "trace.json";
+		if (!WriteTrace(filename))
+		{
+			Printf("Could not open %s for writing\n", filename);
+		}
+		TraceActive = active;
+	}
+	else
+	{
+		Printf("Unknown trace command '%s'\n", argv[1]);
+	}
+}
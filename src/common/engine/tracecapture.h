@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Timeline capture of scoped timing events that can be written out as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev). See tracecapture.cpp.
+
+enum ETraceCategory
+{
+	TRACE_Playsim,
+	TRACE_Thinker,
+	TRACE_VM,
+	TRACE_Render,
+	TRACE_Loader,
+
+	NUM_TRACE_CATEGORIES
+};
+
+extern std::atomic<bool> TraceActive;
+
+uint64_t Trace_Now();
+void Trace_AddEvent(const char *name, int category, uint64_t start, uint64_t end);
+
+// 'name' must stay valid until the trace has been written, so only use string
+// literals, FName strings or the names of VM functions here. A null name
+// records nothing.
+class FTraceScope
+{
+	const char *Name;
+	int Category;
+	uint64_t Start;
+
+public:
+	FTraceScope(const char *name, int category)
+	{
+		Name = name;
+		if (name != nullptr)
+		{
+			Category = category;
+			Start = Trace_Now();
+		}
+	}
+
+	~FTraceScope()
+	{
+		if (Name != nullptr) Trace_AddEvent(Name, Category, Start, Trace_Now());
+	}
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+// The name expression is only evaluated while a capture is running.
+#define TRACE_SCOPE(name, category) FTraceScope TRACE_CONCAT(tracescope_, __LINE__)(TraceActive.load(std::memory_order_relaxed) ? (name) : nullptr, category)
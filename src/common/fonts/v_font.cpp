@@ -53,6 +53,7 @@
 #include "texturemanager.h"
 #include "printf.h"
 #include "palentry.h"
+#include "v_2ddrawer.h"
 
 #include "fontinternals.h"
 
@@ -882,6 +883,8 @@ void V_InitFonts()
 
 void V_LoadTranslations()
 {
+	V_ClearGlyphRuns();
+	F2DDrawer::InvalidateText();
 	for (auto font = FFont::FirstFont; font; font = font->Next)
 	{
 		if (!font->noTranslate) font->LoadTranslations();
@@ -928,6 +931,8 @@ void V_LoadTranslations()
 
 void V_ClearFonts()
 {
+	V_ClearGlyphRuns();
+	F2DDrawer::InvalidateText();
 	while (FFont::FirstFont != nullptr)
 	{
 		delete FFont::FirstFont;
@@ -70,6 +70,7 @@ void FSavegameManagerBase::ClearSaveGames()
 			delete SaveGames[i];
 	}
 	SaveGames.Clear();
+	SelectedNode = nullptr;
 }
 
 FSavegameManagerBase::~FSavegameManagerBase()
@@ -85,9 +86,11 @@ FSavegameManagerBase::~FSavegameManagerBase()
 
 int FSavegameManagerBase::RemoveSaveSlot(int index)
 {
+	index = FindSelection(index);
 	int listindex = SaveGames[0]->bNoDelete ? index - 1 : index;
 	if (listindex < 0) return index;
 
+	SaveIndex.Forget(SaveGames[index]->Filename.GetChars());
 	RemoveFile(SaveGames[index]->Filename.GetChars());
 	UnloadSaveData();
 
@@ -150,6 +153,73 @@ int FSavegameManagerBase::InsertSaveNode(FSaveGameNode *node)
 	}
 }
 
+//=============================================================================
+//
+// UpdateSaveStrings
+//
+// Adds whatever the savegame scanner found since the last call.
+//
+//=============================================================================
+
+void FSavegameManagerBase::UpdateSaveStrings()
+{
+	std::vector<FSaveIndexEntry> results;
+	SaveIndex.GetResults(results);
+	if (results.empty())
+	{
+		return;
+	}
+
+	// Inserting shifts the list, so remember what the indices point to.
+	FSaveGameNode *lastSaved = (unsigned)LastSaved < SaveGames.Size() ? SaveGames[LastSaved] : nullptr;
+	FSaveGameNode *lastAccessed = (unsigned)LastAccessed < SaveGames.Size() ? SaveGames[LastAccessed] : nullptr;
+
+	// Keep the "new savegame" entry on top.
+	bool hasNewSave = SaveGames.Size() > 0 && SaveGames[0] == &NewSaveNode;
+	if (hasNewSave) SaveGames.Delete(0);
+
+	for (auto &entry : results)
+	{
+		FSaveGameNode *node = CreateSaveNode(entry);
+		if (node != nullptr)
+		{
+			InsertSaveNode(node);
+		}
+	}
+
+	if (hasNewSave) SaveGames.Insert(0, &NewSaveNode);
+
+	if (lastSaved != nullptr) LastSaved = SaveGames.Find(lastSaved);
+	if (lastAccessed != nullptr) LastAccessed = SaveGames.Find(lastAccessed);
+}
+
+//=============================================================================
+//
+// FindSelection
+//
+// The menu keeps the selection as an index, which goes stale when the
+// scanner inserts entries above it. Returns where the entry that was last
+// extracted is now, so deleting or overwriting hits the save the player
+// was looking at.
+//
+//=============================================================================
+
+int FSavegameManagerBase::FindSelection(int index)
+{
+	if (index < 0 || SelectedNode == nullptr) return index;
+	if ((unsigned)index < SaveGames.Size() && SaveGames[index] == SelectedNode) return index;
+
+	unsigned found = SaveGames.Find(SelectedNode);
+	return found < SaveGames.Size() ? (int)found : index;
+}
+
+DEFINE_ACTION_FUNCTION(FSavegameManager, FindSelection)
+{
+	PARAM_SELF_STRUCT_PROLOGUE(FSavegameManagerBase);
+	PARAM_INT(sel);
+	ACTION_RETURN_INT(self->FindSelection(sel));
+}
+
 //=============================================================================
 //
 //
@@ -161,7 +231,11 @@ void FSavegameManagerBase::NotifyNewSave(const FString &file, const FString &tit
 	if (file.IsEmpty())
 		return;
 
+	// The list must be complete before looking for the file in it.
+	SaveIndex.Forget(file.GetChars());
 	ReadSaveStrings();
+	SaveIndex.Wait();
+	UpdateSaveStrings();
 
 	// See if the file is already in our list
 	for (unsigned i = 0; i<SaveGames.Size(); i++)
@@ -218,6 +292,7 @@ void FSavegameManagerBase::NotifyNewSave(const FString &file, const FString &tit
 
 void FSavegameManagerBase::LoadSavegame(int Selected)
 {
+	Selected = FindSelection(Selected);
 	PerformLoadGame(SaveGames[Selected]->Filename.GetChars(), true);
 	if (quickSaveSlot == (FSaveGameNode*)1)
 	{
@@ -250,6 +325,7 @@ void FSavegameManagerBase::DoSave(int Selected, const char *savegamestring)
 		return;
 	}
 
+	Selected = FindSelection(Selected);
 	if (Selected != 0)
 	{
 		auto node = SaveGames[Selected];
@@ -307,6 +383,7 @@ unsigned FSavegameManagerBase::ExtractSaveData(int index)
 	}
 
 	UnloadSaveData();
+	SelectedNode = (unsigned)index < SaveGames.Size() ? SaveGames[index] : nullptr;
 
 	if ((unsigned)index < SaveGames.Size() &&
 		(node = SaveGames[index]) &&
@@ -429,6 +506,7 @@ DEFINE_ACTION_FUNCTION(FSavegameManager, DrawSavePic)
 
 void FSavegameManagerBase::SetFileInfo(int Selected)
 {
+	Selected = FindSelection(Selected);
 	if (!SaveGames[Selected]->Filename.IsEmpty())
 	{
 		SaveCommentString.Format("File on disk:\n%s", SaveGames[Selected]->Filename.GetChars());
@@ -452,6 +530,7 @@ DEFINE_ACTION_FUNCTION(FSavegameManager, SetFileInfo)
 
 unsigned FSavegameManagerBase::SavegameCount()
 {
+	UpdateSaveStrings();
 	return SaveGames.Size();
 }
 
@@ -510,6 +589,7 @@ bool FSavegameManagerBase::RemoveNewSaveNode()
 {
 	if (SaveGames[0] == &NewSaveNode)
 	{
+		if (SelectedNode == &NewSaveNode) SelectedNode = nullptr;
 		SaveGames.Delete(0);
 		return true;
 	}
@@ -2,6 +2,7 @@
 
 #include "zstring.h"
 #include "tarray.h"
+#include "saveindex.h"
 
 class FGameTexture;
 class FSerializer;
@@ -24,7 +25,9 @@ protected:
 	FSaveGameNode NewSaveNode;
 	int LastSaved = -1;
 	int LastAccessed = -1;
+	FSaveGameNode *SelectedNode = nullptr;	// the entry last passed to ExtractSaveData, to follow it when the scanner inserts entries
 	FGameTexture *SavePic = nullptr;
+	FSaveIndex SaveIndex;
 
 public:
 	int WindowSize = 0;
@@ -38,7 +41,10 @@ protected:
 	virtual void PerformLoadGame(const char *fn, bool) = 0;
 	virtual FString ExtractSaveComment(FSerializer &arc) = 0;
 	virtual FString BuildSaveName(const char* prefix, int slot) = 0;
+	virtual FSaveGameNode *CreateSaveNode(const FSaveIndexEntry &entry) = 0;
+	void UpdateSaveStrings();
 public:
+	int FindSelection(int index);
 	void NotifyNewSave(const FString &file, const FString &title, int saveDate, bool okForQuicksave, bool forceQuicksave);
 	void ClearSaveGames();
 
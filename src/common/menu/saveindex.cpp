@@ -0,0 +1,386 @@
+/*
+** saveindex.cpp
+** Background savegame scanner with a persistent metadata cache
+**
+**---------------------------------------------------------------------------
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/
+**
+**---------------------------------------------------------------------------
+**
+** Opening a savegame means reading its zip directory and inflating and
+** parsing info.json, which adds up quickly with a few hundred saves. The
+** index file remembers the result for each file along with its size and
+** modification time, so only new or changed savegames need to be opened.
+**
+** Everything the scanner thread touches is either its own or guarded by
+** Lock. Judging whether a savegame fits the current game happens when
+** the main thread collects the results.
+**
+*/
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include "saveindex.h"
+#include "filesystem.h"
+#include "fs_findfile.h"
+#include "serializer.h"
+#include "cmdlib.h"
+#include "version.h"
+
+enum
+{
+	SAVEINDEX_VERSION = 1
+};
+
+// The index is keyed on the path so that differently spelled paths to the
+// same file still find each other.
+static std::string IndexKey(const char *filename)
+{
+	std::string key = filename;
+	std::replace(key.begin(), key.end(), '\\', '/');
+#ifndef __unix__
+	std::transform(key.begin(), key.end(), key.begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; });
+#endif
+	return key;
+}
+
+static void SerializeString(FSerializer &arc, const char *key, std::string &str)
+{
+	FString value = str.c_str();
+	arc(key, value);
+	if (arc.isReading()) str = value.GetChars();
+}
+
+static void SerializeEntry(FSerializer &arc, FSaveIndexEntry &entry)
+{
+	SerializeString(arc, "file", entry.Filename);
+	arc("size", entry.FileSize)
+		("time", entry.FileTime)
+		("savegame", entry.bIsSavegame)
+		("version", entry.SaveVersion)
+		("date", entry.SaveDate);
+	SerializeString(arc, "engine", entry.Engine);
+	SerializeString(arc, "title", entry.Title);
+	SerializeString(arc, "map", entry.Map);
+	SerializeString(arc, "gamewad", entry.GameWad);
+	SerializeString(arc, "mapwad", entry.MapWad);
+}
+
+//==========================================================================
+//
+// ReadSaveInfo
+//
+// Runs on the scanner thread.
+//
+//==========================================================================
+
+static void ReadSaveInfo(FSaveIndexEntry &entry)
+{
+	std::unique_ptr<FResourceFile> savegame(FResourceFile::OpenResourceFile(entry.Filename.c_str(), true));
+	if (savegame == nullptr)
+	{
+		return;
+	}
+	auto info = savegame->FindEntry("info.json");
+	if (info < 0)
+	{
+		return;
+	}
+	auto data = savegame->Read(info);
+	FSerializer arc;
+	if (!arc.OpenReader(data.string(), data.size()))
+	{
+		return;
+	}
+
+	auto getstring = [&](const char *key) { const char *s = arc.GetString(key); return std::string(s ? s : ""); };
+
+	entry.bIsSavegame = true;
+	arc("Save Version", entry.SaveVersion);
+	arc("Save Date", entry.SaveDate);
+	entry.Engine = getstring("Engine");
+	entry.Title = getstring("Title");
+	entry.Map = getstring("Current Map");
+	entry.GameWad = getstring("Game WAD");
+	entry.MapWad = getstring("Map WAD");
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+FSaveIndex::~FSaveIndex()
+{
+	Abort = true;
+	if (Thread.joinable())
+	{
+		Thread.join();
+	}
+}
+
+//==========================================================================
+//
+// StartScan
+//
+//==========================================================================
+
+void FSaveIndex::StartScan(const TArray<FString> &searchPaths, const char *indexFile)
+{
+	Wait();
+
+	if (!IndexRead || IndexFile.Compare(indexFile) != 0)
+	{
+		IndexFile = indexFile;
+		ReadIndex();
+	}
+
+	std::vector<std::string> paths;
+	for (auto &path : searchPaths)
+	{
+		paths.push_back(path.GetChars());
+	}
+
+	Abort = false;
+	Scanning = true;
+	Thread = std::thread([this, paths]() { ScanThread(paths); });
+}
+
+//==========================================================================
+//
+// ScanThread
+//
+//==========================================================================
+
+void FSaveIndex::ScanThread(std::vector<std::string> searchPaths)
+{
+	std::set<std::string> seen;
+
+	for (auto &path : searchPaths)
+	{
+		FileSys::FileList list;
+		if (Abort || !FileSys::ScanDirectory(list, path.c_str(), "*." SAVEGAME_EXT, true))
+		{
+			continue;
+		}
+
+		for (auto &file : list)
+		{
+			if (Abort)
+			{
+				break;
+			}
+
+			FSaveIndexEntry entry;
+			size_t size = 0;
+			time_t time = 0;
+			GetFileInfo(file.FilePath.c_str(), &size, &time);
+			entry.Filename = file.FilePath;
+			entry.FileSize = size;
+			entry.FileTime = time;
+
+			auto key = IndexKey(file.FilePath.c_str());
+			seen.insert(key);
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				auto it = Index.find(key);
+				if (it != Index.end() && it->second.FileSize == entry.FileSize && it->second.FileTime == entry.FileTime)
+				{
+					it->second.Filename = entry.Filename;
+					Pending.push_back(it->second);
+					continue;
+				}
+			}
+
+			ReadSaveInfo(entry);
+
+			std::lock_guard<std::mutex> lock(Lock);
+			Index[key] = entry;
+			IndexDirty = true;
+			Pending.push_back(std::move(entry));
+		}
+	}
+
+	if (!Abort)
+	{
+		// Forget about savegames that are gone.
+		std::lock_guard<std::mutex> lock(Lock);
+		for (auto it = Index.begin(); it != Index.end();)
+		{
+			if (seen.find(it->first) == seen.end())
+			{
+				it = Index.erase(it);
+				IndexDirty = true;
+			}
+			else ++it;
+		}
+	}
+
+	Scanning = false;
+}
+
+//==========================================================================
+//
+// GetResults
+//
+// Appends everything the scanner has found since the last call.
+//
+//==========================================================================
+
+void FSaveIndex::GetResults(std::vector<FSaveIndexEntry> &results)
+{
+	// Must be checked before collecting so that nothing found in between is lost.
+	bool done = !Scanning;
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		for (auto &entry : Pending)
+		{
+			results.push_back(std::move(entry));
+		}
+		Pending.clear();
+	}
+	if (done)
+	{
+		Wait();
+	}
+}
+
+//==========================================================================
+//
+// Wait
+//
+// Blocks until the current scan is done.
+//
+//==========================================================================
+
+void FSaveIndex::Wait()
+{
+	if (Thread.joinable())
+	{
+		Thread.join();
+	}
+	if (IndexDirty)
+	{
+		WriteIndex();
+	}
+}
+
+//==========================================================================
+//
+// Forget
+//
+// For savegames that were just written or deleted.
+//
+//==========================================================================
+
+void FSaveIndex::Forget(const char *filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		if (Index.erase(IndexKey(filename)) > 0)
+		{
+			IndexDirty = true;
+		}
+	}
+	if (!Scanning && IndexRead)
+	{
+		Wait();
+	}
+}
+
+//==========================================================================
+//
+// Index file
+//
+//==========================================================================
+
+void FSaveIndex::ReadIndex()
+{
+	Index.clear();
+	IndexRead = true;
+	IndexDirty = false;
+
+	FileReader fr;
+	if (!fr.OpenFile(IndexFile.GetChars()))
+	{
+		return;
+	}
+	auto data = fr.Read();
+	FSerializer arc;
+	if (!arc.OpenReader(data.string(), data.size()))
+	{
+		return;
+	}
+
+	int version = 0;
+	arc("version", version);
+	if (version != SAVEINDEX_VERSION)
+	{
+		return;
+	}
+
+	if (arc.BeginArray("saves"))
+	{
+		unsigned count = arc.ArraySize();
+		for (unsigned i = 0; i < count; i++)
+		{
+			if (arc.BeginObject(nullptr))
+			{
+				FSaveIndexEntry entry;
+				SerializeEntry(arc, entry);
+				arc.EndObject();
+				if (!entry.Filename.empty())
+				{
+					Index[IndexKey(entry.Filename.c_str())] = std::move(entry);
+				}
+			}
+		}
+		arc.EndArray();
+	}
+}
+
+void FSaveIndex::WriteIndex()
+{
+	FSerializer arc;
+	if (!arc.OpenWriter(false))
+	{
+		return;
+	}
+
+	int version = SAVEINDEX_VERSION;
+	arc("version", version);
+	if (arc.BeginArray("saves"))
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		for (auto &pair : Index)
+		{
+			arc.BeginObject(nullptr);
+			SerializeEntry(arc, pair.second);
+			arc.EndObject();
+		}
+		arc.EndArray();
+	}
+
+	unsigned len;
+	auto output = arc.GetOutput(&len);
+	std::unique_ptr<FileWriter> fw(FileWriter::Open(IndexFile.GetChars()));
+	if (fw != nullptr)
+	{
+		fw->Write(output, len);
+		IndexDirty = false;
+	}
+}
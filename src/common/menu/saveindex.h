@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "zstring.h"
+#include "tarray.h"
+
+// What the save menu needs to know about a savegame, as read from its info.json.
+// Only std::string here because these get passed between threads.
+struct FSaveIndexEntry
+{
+	std::string Filename;
+	int64_t FileSize = 0;
+	int64_t FileTime = 0;
+	bool bIsSavegame = false;	// false if the file has no info.json
+	int SaveVersion = 0;
+	int SaveDate = 0;
+	std::string Engine;
+	std::string Title;
+	std::string Map;
+	std::string GameWad;
+	std::string MapWad;
+};
+
+//==========================================================================
+//
+// FSaveIndex
+//
+// Scans the savegame folders on a background thread. Savegames whose size
+// and modification time match the index file are not opened at all, all
+// others get their info.json read and are added to the index.
+//
+//==========================================================================
+
+class FSaveIndex
+{
+public:
+	~FSaveIndex();
+
+	void StartScan(const TArray<FString> &searchPaths, const char *indexFile);
+	void GetResults(std::vector<FSaveIndexEntry> &results);
+	void Wait();
+	bool IsScanning() const { return Scanning; }
+	void Forget(const char *filename);
+
+private:
+	void ScanThread(std::vector<std::string> searchPaths);
+	void ReadIndex();
+	void WriteIndex();
+
+	std::thread Thread;
+	std::mutex Lock;
+	std::vector<FSaveIndexEntry> Pending;			// found by the thread, not yet collected
+	std::map<std::string, FSaveIndexEntry> Index;
+	std::atomic<bool> Scanning{ false };
+	std::atomic<bool> Abort{ false };
+	bool IndexRead = false;
+	bool IndexDirty = false;
+	FString IndexFile;
+};
@@ -0,0 +1,327 @@
+/*
+** dobjalloc.cpp
+** Size-class slab allocator for DObject memory
+**
+**---------------------------------------------------------------------------
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/
+**
+**---------------------------------------------------------------------------
+**
+** Every object gets a small header in front of it that points back to the
+** slab it came from, so freeing needs neither the size nor a lookup. Objects
+** up to 8K are carved out of 64K slabs with one free list per slab, so
+** objects of similar size (most importantly actors) end up next to each
+** other instead of being scattered across the heap. Larger objects and
+** anything allocated off the main thread go to M_Malloc as before.
+**
+** Frees from other threads are pushed onto a lock-free list per size class
+** and handed back to their slab by the main thread on its next allocation
+** of that size.
+**
+*/
+
+#include <atomic>
+#include <thread>
+#include "dobject.h"
+#include "engineerrors.h"
+#include "printf.h"
+
+namespace GC
+{
+
+enum
+{
+	SLAB_SIZE = 65536,
+	SLAB_HEADER = 64,
+	MAX_SLAB_OBJECT = 8192,
+	MAX_SIZE_CLASSES = 64,
+};
+
+struct FObjectSlab;
+
+struct alignas(16) FObjectHeader
+{
+	FObjectSlab *Slab;		// nullptr if the object came from M_Malloc
+	size_t Size;			// bytes reported to the collector
+};
+
+struct FFreeObject
+{
+	FFreeObject *Next;
+};
+
+struct FObjectSlab
+{
+	FObjectSlab *Prev, *Next;	// links in the size class's list of slabs with free space
+	FFreeObject *FreeList;
+	uint8_t *Bump;				// never used memory starts here
+	uint8_t *End;
+	unsigned Class;
+	unsigned Live;
+	bool Listed;
+};
+
+static_assert(sizeof(FObjectSlab) <= SLAB_HEADER, "Slab header too large");
+
+struct FSizeClass
+{
+	unsigned Stride;
+	FObjectSlab *Partial;
+	unsigned NumSlabs;
+	unsigned NumPartial;
+	size_t Live;
+	size_t Allocs;
+	std::atomic<FFreeObject *> Remote;
+};
+
+static FSizeClass SizeClasses[MAX_SIZE_CLASSES];
+static int NumSizeClasses;
+static uint8_t ClassForSize[MAX_SLAB_OBJECT / 16 + 1];
+static std::thread::id OwnerThread;
+static std::atomic<size_t> LargeAllocs;
+
+//==========================================================================
+//
+// InitSizeClasses
+//
+// 16 byte steps up to 256 bytes, then 8 classes per power of two.
+//
+//==========================================================================
+
+static void InitSizeClasses()
+{
+	unsigned size = 32, step = 16;
+	while (size <= MAX_SLAB_OBJECT)
+	{
+		assert(NumSizeClasses < MAX_SIZE_CLASSES);
+		SizeClasses[NumSizeClasses++].Stride = size;
+		if (size >= step * 16) step <<= 1;
+		size += step;
+	}
+
+	int c = 0;
+	for (unsigned i = 0; i < sizeof(ClassForSize); i++)
+	{
+		while (SizeClasses[c].Stride < i * 16) c++;
+		ClassForSize[i] = c;
+	}
+	OwnerThread = std::this_thread::get_id();
+}
+
+//==========================================================================
+//
+// Slab list handling
+//
+//==========================================================================
+
+static void LinkSlab(FSizeClass &sc, FObjectSlab *slab)
+{
+	slab->Prev = nullptr;
+	slab->Next = sc.Partial;
+	if (sc.Partial != nullptr) sc.Partial->Prev = slab;
+	sc.Partial = slab;
+	slab->Listed = true;
+	sc.NumPartial++;
+}
+
+static void UnlinkSlab(FSizeClass &sc, FObjectSlab *slab)
+{
+	if (slab->Prev != nullptr) slab->Prev->Next = slab->Next;
+	else sc.Partial = slab->Next;
+	if (slab->Next != nullptr) slab->Next->Prev = slab->Prev;
+	slab->Prev = slab->Next = nullptr;
+	slab->Listed = false;
+	sc.NumPartial--;
+}
+
+static FObjectSlab *NewSlab(FSizeClass &sc)
+{
+	// Slab memory is not reported to the collector, only the objects in it are.
+	auto slab = (FObjectSlab *)malloc(SLAB_SIZE);
+	if (slab == nullptr)
+	{
+		I_FatalError("Could not allocate object slab");
+	}
+	slab->FreeList = nullptr;
+	slab->Bump = (uint8_t *)slab + SLAB_HEADER;
+	slab->End = (uint8_t *)slab + SLAB_SIZE;
+	slab->Class = unsigned(&sc - SizeClasses);
+	slab->Live = 0;
+	LinkSlab(sc, slab);
+	sc.NumSlabs++;
+	return slab;
+}
+
+//==========================================================================
+//
+// FreeToSlab
+//
+// Main thread only.
+//
+//==========================================================================
+
+static void FreeToSlab(FObjectHeader *header)
+{
+	FObjectSlab *slab = header->Slab;
+	FSizeClass &sc = SizeClasses[slab->Class];
+	ReportDealloc(sc.Stride);
+
+	auto entry = (FFreeObject *)header;
+	entry->Next = slab->FreeList;
+	slab->FreeList = entry;
+	slab->Live--;
+	sc.Live--;
+
+	if (!slab->Listed)
+	{
+		LinkSlab(sc, slab);
+	}
+	else if (slab->Live == 0 && sc.NumPartial > 1)
+	{
+		// Keep one empty slab around so that a single object being created
+		// and destroyed over and over does not hit the system allocator.
+		UnlinkSlab(sc, slab);
+		free(slab);
+		sc.NumSlabs--;
+	}
+}
+
+static void DrainRemoteFrees(FSizeClass &sc)
+{
+	FFreeObject *entry = sc.Remote.exchange(nullptr, std::memory_order_acquire);
+	while (entry != nullptr)
+	{
+		FFreeObject *next = entry->Next;
+		FreeToSlab((FObjectHeader *)entry - 1);
+		entry = next;
+	}
+}
+
+//==========================================================================
+//
+// AllocObject
+//
+// Returns uninitialized memory for an object of the given size.
+//
+//==========================================================================
+
+void *AllocObject(size_t size)
+{
+	if (NumSizeClasses == 0)
+	{
+		InitSizeClasses();
+	}
+
+	size_t total = size + sizeof(FObjectHeader);
+	FObjectHeader *header;
+	if (total > MAX_SLAB_OBJECT || std::this_thread::get_id() != OwnerThread)
+	{
+		header = (FObjectHeader *)M_Malloc(total);
+		header->Slab = nullptr;
+		header->Size = total;
+		LargeAllocs++;
+		return header + 1;
+	}
+
+	FSizeClass &sc = SizeClasses[ClassForSize[(total + 15) >> 4]];
+	if (sc.Remote.load(std::memory_order_relaxed) != nullptr)
+	{
+		DrainRemoteFrees(sc);
+	}
+
+	FObjectSlab *slab = sc.Partial;
+	if (slab == nullptr)
+	{
+		slab = NewSlab(sc);
+	}
+	if (slab->FreeList != nullptr)
+	{
+		header = (FObjectHeader *)slab->FreeList;
+		slab->FreeList = slab->FreeList->Next;
+	}
+	else
+	{
+		header = (FObjectHeader *)slab->Bump;
+		slab->Bump += sc.Stride;
+	}
+	if (slab->FreeList == nullptr && slab->Bump + sc.Stride > slab->End)
+	{
+		UnlinkSlab(sc, slab);	// full
+	}
+
+	header->Slab = slab;
+	header->Size = sc.Stride;
+	slab->Live++;
+	sc.Live++;
+	sc.Allocs++;
+	ReportAlloc(sc.Stride);
+	return header + 1;
+}
+
+//==========================================================================
+//
+// FreeObject
+//
+//==========================================================================
+
+void FreeObject(void *mem)
+{
+	if (mem == nullptr) return;
+
+	auto header = (FObjectHeader *)mem - 1;
+	if (header->Slab == nullptr)
+	{
+		M_Free(header);
+	}
+	else if (std::this_thread::get_id() == OwnerThread)
+	{
+		FreeToSlab(header);
+	}
+	else
+	{
+		// The header must stay intact, so link through the object's own memory.
+		auto &sc = SizeClasses[header->Slab->Class];
+		auto entry = (FFreeObject *)mem;
+		entry->Next = sc.Remote.load(std::memory_order_relaxed);
+		while (!sc.Remote.compare_exchange_weak(entry->Next, entry, std::memory_order_release, std::memory_order_relaxed));
+	}
+}
+
+//==========================================================================
+//
+// PrintObjectMemory
+//
+// For 'gc memory'.
+//
+//==========================================================================
+
+void PrintObjectMemory()
+{
+	size_t used = 0, slabs = 0;
+	for (int i = 0; i < NumSizeClasses; i++)
+	{
+		auto &sc = SizeClasses[i];
+		if (sc.NumSlabs == 0 && sc.Allocs == 0) continue;
+		Printf("%5u bytes: %7zu live %4u slabs (%u with free space) %9zu allocations\n",
+			sc.Stride, sc.Live, sc.NumSlabs, sc.NumPartial, sc.Allocs);
+		used += sc.Live * sc.Stride;
+		slabs += sc.NumSlabs;
+	}
+	Printf("%zuK of %zuK slab memory in use (%.1f%%), %zu allocations outside of slabs\n",
+		(used + 1023) >> 10, (slabs * SLAB_SIZE) >> 10,
+		slabs > 0 ? 100. * used / (slabs * SLAB_SIZE) : 0., LargeAllocs.load());
+}
+
+}
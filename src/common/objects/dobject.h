@@ -204,7 +204,7 @@ private:
 public:
 	DObject *ObjNext;			// Keep track of all allocated objects
 	DObject *GCNext;			// Next object in this collection list
-	uint32_t ObjectFlags;			// Flags for this object
+	FObjectFlags ObjectFlags;		// Flags for this object
 
 	void *ScriptVar(FName field, PType *type);
 
@@ -266,18 +266,20 @@ private:
 
 	void *operator new(size_t len, nonew&)
 	{
-		return M_Calloc(len, 1);
+		void *mem = GC::AllocObject(len);
+		memset(mem, 0, len);
+		return mem;
 	}
 public:
 
 	void operator delete (void *mem, nonew&)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	void operator delete (void *mem)
 	{
-		M_Free(mem);
+		GC::FreeObject(mem);
 	}
 
 	// GC fiddling
@@ -344,7 +346,7 @@ protected:
 
 	void operator delete (void *mem, EInPlace *)
 	{
-		M_Free (mem);
+		GC::FreeObject (mem);
 	}
 
 	template<typename T, typename... Args>
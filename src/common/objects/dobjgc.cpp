@@ -56,9 +56,16 @@
 
 // HEADER FILES ------------------------------------------------------------
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "dobject.h"
 
 #include "c_dispatch.h"
+#include "c_cvars.h"
 #include "menu.h"
 #include "stats.h"
 #include "printf.h"
@@ -107,6 +114,16 @@
 // Cost of destroying an object
 #define GCDESTROYCOST		15
 
+// Most helper threads the parallel marker will use
+#define GCMAXMARKTHREADS	16
+
+// Most objects a marking thread takes from the shared pool at once
+#define GCMARKCHUNK			256
+
+// Smallest step budget (in bytes) that is worth waking up the helper threads
+// for. Below it, the handoff costs more than the marking itself.
+#define GCMINPARALLELSTEP	(256 * 1024)
+
 // TYPES -------------------------------------------------------------------
 
 class FAveragizer
@@ -130,11 +147,42 @@ struct FStepStats
 	cycle_t Clock[GC::GCS_COUNT];
 	size_t BytesCovered[GC::GCS_COUNT];
 	int Count[GC::GCS_COUNT];
+	double MaxPause;
 
 	void Format(FString &out);
 	void Reset();
 };
 
+class FParallelMarker
+{
+public:
+	~FParallelMarker();
+	size_t Propagate(size_t budget);
+
+private:
+	void SetThreads(int count);
+	void StopThreads();
+	void ThreadProc(unsigned round);
+	void Work();
+	bool TakeWork(std::vector<DObject *> &stack, bool &busy);
+	void GiveWork(std::vector<DObject *> &stack);
+
+	std::vector<std::thread> Threads;
+	std::mutex Lock;
+	std::condition_variable StartRound;
+	std::condition_variable MoreWork;
+	std::condition_variable RoundDone;
+	std::vector<DObject *> Pool;		// Gray objects up for grabs
+	std::vector<DObject *> Deferred;	// Gray objects the game thread has to propagate
+	std::atomic<ptrdiff_t> Budget;
+	std::atomic<size_t> Marked;
+	std::atomic<int> Hungry;			// Threads waiting for the pool to fill up
+	int Busy = 0;						// Threads that have objects to propagate
+	int Running = 0;					// Helpers that have not finished the round
+	unsigned Round = 0;
+	bool Quit = false;
+};
+
 // EXTERNAL FUNCTION PROTOTYPES --------------------------------------------
 
 // PUBLIC FUNCTION PROTOTYPES ----------------------------------------------
@@ -147,6 +195,18 @@ static size_t CalcStepSize();
 
 // PUBLIC DATA DEFINITIONS -------------------------------------------------
 
+// Number of helper threads that mark objects alongside the game thread.
+// 0 does all marking on the game thread.
+CUSTOM_CVAR(Int, gc_parallelmark, 0, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+{
+	if (self < 0) self = 0;
+	else if (self > GCMAXMARKTHREADS) self = GCMAXMARKTHREADS;
+}
+
+// Reruns the mark phase of every full collection on the game thread alone
+// and reports any object the two markers disagree on.
+CVAR(Bool, gc_verifymark, false, 0)
+
 namespace GC
 {
 size_t AllocBytes;
@@ -172,6 +232,9 @@ bool HadToDestroy;
 
 static FAveragizer AllocHistory;// Tracks allocation rate over time
 static cycle_t GCTime;			// Track time spent in GC
+static FParallelMarker ParallelMarker;
+static bool MarkingInParallel;	// Set while the helper threads are running
+static thread_local DObject *ParallelGray;	// Each marking thread's own gray list during a round
 
 // CODE --------------------------------------------------------------------
 
@@ -307,6 +370,29 @@ static size_t DestroyObjects(size_t count)
 	return bytes_destroyed;
 }
 
+//==========================================================================
+//
+// ClaimWhite
+//
+// Turns a white object gray while other threads may be trying the same.
+// Only one of them succeeds and gets to put the object on its gray list.
+//
+//==========================================================================
+
+static bool ClaimWhite(DObject *obj)
+{
+	auto &flags = obj->ObjectFlags.Atomic();
+	uint32_t old = flags.load(std::memory_order_relaxed);
+	while (old & OF_WhiteBits)
+	{
+		if (flags.compare_exchange_weak(old, old & ~OF_WhiteBits, std::memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 //==========================================================================
 //
 // Mark
@@ -318,19 +404,32 @@ static size_t DestroyObjects(size_t count)
 void Mark(DObject **obj)
 {
 	DObject *lobj = *obj;
+	if (lobj == nullptr)
+	{
+		return;
+	}
+	uint32_t flags = lobj->ObjectFlags;
 
-	//assert(lobj == nullptr || !(lobj->ObjectFlags & OF_Released));
-	if (lobj != nullptr && !(lobj->ObjectFlags & OF_Released))
+	//assert(!(flags & OF_Released));
+	if (!(flags & OF_Released))
 	{
-		if (lobj->ObjectFlags & OF_EuthanizeMe)
+		if (flags & OF_EuthanizeMe)
 		{
 			*obj = (DObject *)NULL;
 		}
-		else if (lobj->IsWhite())
+		else if (flags & OF_WhiteBits)
 		{
-			lobj->White2Gray();
-			lobj->GCNext = Gray;
-			Gray = lobj;
+			if (!MarkingInParallel)
+			{
+				lobj->White2Gray();
+				lobj->GCNext = Gray;
+				Gray = lobj;
+			}
+			else if (ClaimWhite(lobj))	// Another thread may have got to it first.
+			{
+				lobj->GCNext = ParallelGray;
+				ParallelGray = lobj;
+			}
 		}
 	}
 }
@@ -380,13 +479,8 @@ void AddMarkerFunc(GCMarkerFunc func)
 		markers.Push(func);
 }
 
-static void MarkRoot()
+static void MarkRootObjects()
 {
-	PrevStepStats = StepStats;
-	StepStats.Reset();
-
-	Gray = nullptr;
-
 	for (auto func : markers) func();
 
 	// Mark soft roots.
@@ -403,6 +497,16 @@ static void MarkRoot()
 			}
 		}
 	}
+}
+
+static void MarkRoot()
+{
+	PrevStepStats = StepStats;
+	StepStats.Reset();
+
+	Gray = nullptr;
+	MarkRootObjects();
+
 	// Time to propagate the marks.
 	State = GCS_Propagate;
 }
@@ -523,7 +627,8 @@ void Step()
 
 	do
 	{
-		size_t done = SingleStep();
+		size_t done = (State == GCS_Propagate && Gray != nullptr && gc_parallelmark > 0 && lim >= GCMINPARALLELSTEP) ?
+			ParallelMarker.Propagate(lim) : SingleStep();
 		did += done;
 		if (done < lim)
 		{
@@ -550,6 +655,61 @@ void Step()
 	StepStats.Clock[enter_state].Unclock();
 	StepStats.BytesCovered[enter_state] += did;
 	GCTime.Unclock();
+	StepStats.MaxPause = std::max(StepStats.MaxPause, GCTime.TimeMS());
+}
+
+//==========================================================================
+//
+// VerifyMark
+//
+// Called once the parallel marker has finished a full collection's mark
+// phase. Redoes the marking on the game thread and compares the results.
+// The collection continues with what the serial marker found.
+//
+//==========================================================================
+
+static void VerifyMark()
+{
+	std::vector<DObject *> reached;
+	DObject *obj;
+
+	for (obj = Root; obj != nullptr; obj = obj->ObjNext)
+	{
+		if (obj->IsBlack())
+		{
+			reached.push_back(obj);
+			obj->MakeWhite();
+		}
+	}
+	std::sort(reached.begin(), reached.end());
+
+	MarkRootObjects();
+	while (Gray != nullptr)
+	{
+		PropagateMark();
+	}
+
+	unsigned count = 0, missed = 0, extra = 0;
+	for (obj = Root; obj != nullptr; obj = obj->ObjNext)
+	{
+		bool parallel = std::binary_search(reached.begin(), reached.end(), obj);
+		if (obj->IsBlack()) count++;
+		if (parallel == obj->IsBlack()) continue;
+		if (parallel) extra++;
+		else missed++;
+		if (missed + extra <= 10)
+		{
+			Printf(TEXTCOLOR_RED "%s %p was only reached by the %s marker\n", obj->GetClass()->TypeName.GetChars(), (void *)obj, parallel ? "parallel" : "serial");
+		}
+	}
+	if (missed + extra == 0)
+	{
+		Printf("Parallel mark verified: %u objects reached\n", count);
+	}
+	else
+	{
+		Printf(TEXTCOLOR_RED "Parallel mark failed: %u of %u objects missed, %u reached in excess\n", missed, count, extra);
+	}
 }
 
 //==========================================================================
@@ -583,6 +743,17 @@ void FullGC()
 		do
 		{
 			MarkRoot();
+			if (gc_parallelmark > 0)
+			{
+				while (Gray != nullptr)
+				{
+					ParallelMarker.Propagate(~(size_t)0);
+				}
+				if (gc_verifymark)
+				{
+					VerifyMark();
+				}
+			}
 			while (State != GCS_Pause)
 			{
 				SingleStep();
@@ -710,6 +881,256 @@ void DelSoftRoot(DObject *obj)
 
 }
 
+//==========================================================================
+//
+// FParallelMarker :: Propagate
+//
+// Propagates marks across the game thread and gc_parallelmark helper
+// threads until the gray list is empty or roughly <budget> bytes have been
+// covered. The game thread's gray list is put into a shared pool. Every
+// thread takes objects from it and pushes what it marks onto a stack of its
+// own, which it shares with the pool again whenever another thread runs out
+// of work. Mark() decides which thread gets an object by atomically clearing
+// its white bits, so each object is propagated by one thread at a time.
+//
+// Building a class's pointer tables is not thread safe, so objects whose
+// class has not been propagated before are left to the game thread until
+// all helpers are done.
+//
+// Returns the number of bytes covered. Anything not propagated yet goes
+// back onto the gray list.
+//
+//==========================================================================
+
+size_t FParallelMarker::Propagate(size_t budget)
+{
+	SetThreads(gc_parallelmark);
+
+	Pool.clear();
+	Deferred.clear();
+	for (DObject *obj = GC::Gray; obj != nullptr; obj = obj->GCNext)
+	{
+		Pool.push_back(obj);
+	}
+	GC::Gray = nullptr;
+
+	Budget = (ptrdiff_t)std::min<size_t>(budget, PTRDIFF_MAX);
+	Marked = 0;
+	Hungry = 0;
+	Busy = 0;
+	GC::MarkingInParallel = true;
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Running = (int)Threads.size();
+		Round++;
+	}
+	StartRound.notify_all();
+	Work();
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		RoundDone.wait(lock, [this] { return Running == 0; });
+	}
+	GC::MarkingInParallel = false;
+
+	for (auto obj : Pool)
+	{
+		obj->GCNext = GC::Gray;
+		GC::Gray = obj;
+	}
+	size_t marked = Marked;
+	for (auto obj : Deferred)
+	{
+		obj->GCNext = GC::Gray;
+		GC::Gray = obj;
+		marked += GC::PropagateMark();
+	}
+	return marked;
+}
+
+//==========================================================================
+//
+// FParallelMarker :: Work
+//
+// Runs on every thread taking part in the round.
+//
+//==========================================================================
+
+void FParallelMarker::Work()
+{
+	std::vector<DObject *> stack;
+	size_t marked = 0;
+	bool busy = false;
+
+	while (TakeWork(stack, busy))
+	{
+		while (!stack.empty() && Budget.load(std::memory_order_relaxed) > 0)
+		{
+			DObject *obj = stack.back();
+			stack.pop_back();
+
+			const PClass *info = obj->GetClass();
+			bool dying = !!(obj->ObjectFlags & OF_EuthanizeMe);
+			if (!dying && !PClass::bShutdown &&
+				(info->FlatPointers == nullptr || info->ArrayPointers == nullptr || info->MapPointers == nullptr))
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				Deferred.push_back(obj);
+				continue;
+			}
+
+			obj->ObjectFlags.Atomic().fetch_or(OF_Black, std::memory_order_relaxed);
+			size_t size = dying ? info->Size : obj->PropagateMark();
+			Budget.fetch_sub(size, std::memory_order_relaxed);
+			marked += size;
+
+			for (DObject *gray = GC::ParallelGray; gray != nullptr; gray = gray->GCNext)
+			{
+				stack.push_back(gray);
+			}
+			GC::ParallelGray = nullptr;
+
+			if (stack.size() > 1 && Hungry.load(std::memory_order_relaxed) > 0)
+			{
+				GiveWork(stack);
+			}
+		}
+		if (!stack.empty())
+		{ // Out of budget
+			std::lock_guard<std::mutex> lock(Lock);
+			Pool.insert(Pool.end(), stack.begin(), stack.end());
+			stack.clear();
+		}
+	}
+	Marked += marked;
+}
+
+//==========================================================================
+//
+// FParallelMarker :: TakeWork
+//
+// Refills an empty stack from the pool, waiting for other threads to share
+// some of theirs if necessary. Returns false once the round is over, either
+// because the budget is used up or because nobody has anything left.
+//
+//==========================================================================
+
+bool FParallelMarker::TakeWork(std::vector<DObject *> &stack, bool &busy)
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	if (busy)
+	{
+		Busy--;
+		busy = false;
+	}
+	for (;;)
+	{
+		if (Budget.load(std::memory_order_relaxed) <= 0 || (Pool.empty() && Busy == 0))
+		{
+			MoreWork.notify_all();
+			return false;
+		}
+		if (!Pool.empty())
+		{
+			size_t count = std::min<size_t>(GCMARKCHUNK, std::max<size_t>(1, Pool.size() / (Threads.size() + 1)));
+			stack.assign(Pool.end() - count, Pool.end());
+			Pool.resize(Pool.size() - count);
+			Busy++;
+			busy = true;
+			return true;
+		}
+		Hungry++;
+		MoreWork.wait(lock);
+		Hungry--;
+	}
+}
+
+//==========================================================================
+//
+// FParallelMarker :: GiveWork
+//
+// Moves the older half of a thread's stack to the pool for a thread that
+// is waiting for work. The older entries tend to lead to more objects.
+//
+//==========================================================================
+
+void FParallelMarker::GiveWork(std::vector<DObject *> &stack)
+{
+	size_t half = stack.size() / 2;
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Pool.insert(Pool.end(), stack.begin(), stack.begin() + half);
+	}
+	stack.erase(stack.begin(), stack.begin() + half);
+	MoreWork.notify_all();
+}
+
+//==========================================================================
+//
+// FParallelMarker :: ThreadProc
+//
+//==========================================================================
+
+void FParallelMarker::ThreadProc(unsigned round)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(Lock);
+			StartRound.wait(lock, [&] { return Quit || Round != round; });
+			if (Quit)
+			{
+				return;
+			}
+			round = Round;
+		}
+		Work();
+		std::lock_guard<std::mutex> lock(Lock);
+		if (--Running == 0)
+		{
+			RoundDone.notify_one();
+		}
+	}
+}
+
+//==========================================================================
+//
+// FParallelMarker :: SetThreads
+//
+//==========================================================================
+
+void FParallelMarker::SetThreads(int count)
+{
+	if (count == (int)Threads.size())
+	{
+		return;
+	}
+	StopThreads();
+	for (int i = 0; i < count; i++)
+	{
+		Threads.emplace_back([this, round = Round] { ThreadProc(round); });
+	}
+}
+
+void FParallelMarker::StopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Quit = true;
+	}
+	StartRound.notify_all();
+	for (auto &thread : Threads)
+	{
+		thread.join();
+	}
+	Threads.clear();
+	Quit = false;
+}
+
+FParallelMarker::~FParallelMarker()
+{
+	StopThreads();
+}
+
 //==========================================================================
 //
 // FAveragizer - Constructor
@@ -804,6 +1225,7 @@ void FStepStats::Reset()
 		BytesCovered[i] = 0;
 		Clock[i].Reset();
 	}
+	MaxPause = 0;
 }
 
 //==========================================================================
@@ -827,7 +1249,8 @@ void FStepStats::Format(FString &out)
 			"-PSD"[i],	/* Stage prefixes: (P)ropagate, (S)weep, (D)estroy */
 			(BytesCovered[i] + 1023) >> 10, count, count != 0 ? time / count : time);
 	}
-	out << TEXTCOLOR_GREEN;
+	// The longest incremental step of this cycle.
+	out.AppendFormat(TEXTCOLOR_GREEN " Max:%.2fms", MaxPause);
 }
 
 //==========================================================================
@@ -842,7 +1265,7 @@ CCMD(gc)
 {
 	if (argv.argc() == 1)
 	{
-		Printf ("Usage: gc stop|now|full|count|pause [size]|stepmul [size]\n");
+		Printf ("Usage: gc stop|now|full|count|memory|pause [size]|stepmul [size]\n");
 		return;
 	}
 	if (stricmp(argv[1], "stop") == 0)
@@ -863,6 +1286,10 @@ CCMD(gc)
 		for (DObject *obj = GC::Root; obj; obj = obj->ObjNext, cnt++);
 		Printf("%d active objects counted\n", cnt);
 	}
+	else if (stricmp(argv[1], "memory") == 0)
+	{
+		GC::PrintObjectMemory();
+	}
 	else if (stricmp(argv[1], "pause") == 0)
 	{
 		if (argv.argc() == 2)
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <atomic>
 #include "tarray.h"
 class DObject;
 class FSerializer;
@@ -29,6 +30,28 @@ enum EObjectFlags
 	OF_Networked		= 1 << 14,		// Object has a unique network identifier that makes it synchronizable between all clients.
 };
 
+// The parallel marker's threads change the mark bits while a mark round is
+// running, so the flags are atomic. Outside of a round only the game thread
+// touches them, so the operators are relaxed loads and stores rather than
+// read-modify-write instructions and cost the same as a plain uint32_t.
+// The marker uses Atomic() for its own compare-exchanges.
+class FObjectFlags
+{
+	std::atomic<uint32_t> Value;
+
+public:
+	FObjectFlags(uint32_t value = 0) noexcept : Value(value) {}
+
+	operator uint32_t() const noexcept { return Value.load(std::memory_order_relaxed); }
+	FObjectFlags &operator=(uint32_t value) noexcept { Value.store(value, std::memory_order_relaxed); return *this; }
+	FObjectFlags &operator|=(uint32_t value) noexcept { return *this = *this | value; }
+	FObjectFlags &operator&=(uint32_t value) noexcept { return *this = *this & value; }
+	FObjectFlags &operator^=(uint32_t value) noexcept { return *this = *this ^ value; }
+
+	std::atomic<uint32_t> &Atomic() noexcept { return Value; }
+};
+static_assert(sizeof(FObjectFlags) == sizeof(uint32_t), "Scripts access ObjectFlags as a 32 bit field");
+
 template<class T> class TObjPtr;
 
 namespace GC
@@ -175,6 +198,11 @@ namespace GC
 	using GCMarkerFunc = void(*)();
 	void AddMarkerFunc(GCMarkerFunc func);
 
+	// Memory for DObjects comes from size-class slabs. See dobjalloc.cpp.
+	void *AllocObject(size_t size);
+	void FreeObject(void *mem);
+	void PrintObjectMemory();
+
 	// Report an allocation to the GC
 	static inline void ReportAlloc(size_t alloc)
 	{
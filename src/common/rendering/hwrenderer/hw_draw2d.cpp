@@ -42,6 +42,7 @@
 #include "hw_renderstate.h"
 #include "r_videoscale.h"
 #include "v_draw.h"
+#include "stats.h"
 
 //===========================================================================
 // 
@@ -50,6 +51,16 @@
 //===========================================================================
 
 CVAR(Bool, gl_aalines, false, CVAR_ARCHIVE) 
+CVAR(Bool, gl_2dbatching, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+static unsigned Commands2D, Batched2D;
+
+ADD_STAT(draw2d)
+{
+	FString out;
+	out.Format("2D commands: %u submitted, %u after batching", Commands2D, Batched2D);
+	return out;
+}
 
 void Draw2D(F2DDrawer* drawer, FRenderState& state)
 {
@@ -83,12 +94,21 @@ void Draw2D(F2DDrawer* drawer, FRenderState& state, int x, int y, int width, int
 
 	if (drawer->mIsFirstPass)
 	{
+		if (gl_2dbatching) drawer->Batch();
+		else drawer->mUnbatchedCount = commands.Size();
+
 		for (auto &v : vertices)
 		{
 			// Change from BGRA to RGBA
 			std::swap(v.color0.r, v.color0.b);
 		}
 	}
+	if (drawer == twod)
+	{
+		Commands2D = drawer->mUnbatchedCount;
+		Batched2D = commands.Size();
+	}
+
 	F2DVertexBuffer vb;
 	vb.UploadData(&vertices[0], vertices.Size(), &indices[0], indices.Size());
 	state.SetVertexBuffer(&vb);
@@ -2,6 +2,8 @@
 #include "jit.h"
 #include "jitintern.h"
 #include "printf.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
 
 extern PString *TypeString;
 extern PStruct *TypeVector2;
@@ -12,7 +14,7 @@ extern PStruct* TypeFQuaternion;
 
 static void OutputJitLog(const asmjit::StringLogger &logger);
 
-JitFuncPtr JitCompile(VMScriptFunction *sfunc)
+JitFuncPtr JitCompile(VMScriptFunction *sfunc, bool optimize)
 {
 #if 0
 	if (strcmp(sfunc->PrintableName, "StatusScreen.drawNum") != 0)
@@ -29,7 +31,7 @@ JitFuncPtr JitCompile(VMScriptFunction *sfunc)
 		code.setErrorHandler(&errorHandler);
 		code.setLogger(&logger);
 
-		JitCompiler compiler(&code, sfunc);
+		JitCompiler compiler(&code, sfunc, optimize);
 		return reinterpret_cast<JitFuncPtr>(AddJitFunction(&code, &compiler));
 	}
 	catch (const CRecoverableError &e)
@@ -109,6 +111,11 @@ asmjit::CCFunc *JitCompiler::Codegen()
 {
 	Setup();
 
+	if (optimize)
+	{
+		FindJumpTargets();
+	}
+
 	int lastLine = -1;
 
 	pc = sfunc->Code;
@@ -141,8 +148,18 @@ asmjit::CCFunc *JitCompiler::Codegen()
 		}
 
 		labels[i].cursor = cc.getCursor();
+		if (optimize && jumpTargets[i])
+		{
+			ForgetChecks();
+		}
+
+		const VMOP *instr = pc;
 		ResetTemp();
 		EmitOpcode();
+		if (optimize)
+		{
+			UpdateChecks(instr);
+		}
 
 		pc++;
 	}
@@ -275,6 +292,7 @@ void JitCompiler::Setup()
 	CreateRegisters();
 	IncrementVMCalls();
 	SetupFrame();
+	EmitTierCounter();
 }
 
 void JitCompiler::SetupFrame()
@@ -446,6 +464,179 @@ void JitCompiler::IncrementVMCalls()
 	cc.mov(asmjit::x86::dword_ptr(vmcallsptr), vmcalls);
 }
 
+//==========================================================================
+//
+// Tiered compilation
+//
+// Baseline code counts calls and backward jumps of its function. Once the
+// count reaches vm_jit_tierup the function is compiled again with the
+// optimizing tier and ScriptCall is swapped over to the new code. Calls
+// always load ScriptCall from the function, so anything already running
+// in the baseline code just finishes there.
+//
+// The generated code reads the threshold from TierUpThreshold, so changing
+// vm_jit_tierup also applies to functions that are already compiled. The
+// counters themselves are only emitted while it is positive: functions
+// compiled with vm_jit_tierup 0 never tier up.
+//
+//==========================================================================
+
+static int TierUpThreshold = 1000;
+
+CUSTOM_CVAR(Int, vm_jit_tierup, 1000, CVAR_ARCHIVE|CVAR_GLOBALCONFIG)
+{
+	TierUpThreshold = self > 0 ? *self : INT_MAX;
+}
+
+static TArray<VMScriptFunction *> TieredFunctions;
+static int RemovedChecks;
+
+static void JitTierUp(VMScriptFunction *sfunc)
+{
+	if (sfunc->JitOptimized || vm_jit_tierup <= 0)
+		return;
+
+	// Set this first so a function that fails to compile is not tried again.
+	sfunc->JitOptimized = true;
+	TieredFunctions.Push(sfunc);
+
+	auto code = JitCompile(sfunc, true);
+	if (code != nullptr)
+	{
+		sfunc->ScriptCall = code;
+	}
+}
+
+void JitReleaseTiers()
+{
+	TieredFunctions.Clear();
+	RemovedChecks = 0;
+}
+
+bool JitCompiler::CountsTiers()
+{
+	return !optimize && !sfunc->JitOptimized && vm_jit_tierup > 0;
+}
+
+void JitCompiler::EmitTierCounter()
+{
+	if (!CountsTiers())
+		return;
+
+	// if (++sfunc->JitTierCount >= TierUpThreshold) JitTierUp(sfunc)
+	auto countptr = newTempIntPtr();
+	auto count = newTempInt32();
+	auto skip = cc.newLabel();
+	cc.mov(countptr, asmjit::imm_ptr(&sfunc->JitTierCount));
+	cc.mov(count, asmjit::x86::dword_ptr(countptr));
+	cc.add(count, (int)1);
+	cc.mov(asmjit::x86::dword_ptr(countptr), count);
+	cc.mov(countptr, asmjit::imm_ptr(&TierUpThreshold));
+	cc.cmp(count, asmjit::x86::dword_ptr(countptr));
+	cc.jl(skip);
+	auto call = CreateCall<void, VMScriptFunction *>(JitTierUp);
+	call->setArg(0, asmjit::imm_ptr(sfunc));
+	cc.bind(skip);
+}
+
+void JitCompiler::FindJumpTargets()
+{
+	jumpTargets.Resize(sfunc->CodeSize);
+	knownNonNull.Resize(sfunc->NumRegA);
+	knownBound.Resize(sfunc->NumRegD);
+	for (auto &t : jumpTargets) t = false;
+	ForgetChecks();
+
+	for (int i = 0; i < sfunc->CodeSize; i++)
+	{
+		const VMOP *instr = &sfunc->Code[i];
+		int target = -1;
+		if (instr->op == OP_JMP)
+			target = i + 1 + JMPOFS(instr);
+		else if (instr->op == OP_TEST || instr->op == OP_TESTN)
+			target = i + 2;
+
+		if (target >= 0 && target < sfunc->CodeSize)
+			jumpTargets[target] = true;
+	}
+}
+
+void JitCompiler::ForgetChecks()
+{
+	for (auto &n : knownNonNull) n = false;
+	for (auto &b : knownBound) b = 0;
+}
+
+void JitCompiler::UpdateChecks(const VMOP *instr)
+{
+	switch (instr->op)
+	{
+	case OP_CALL:
+	case OP_CALL_K:
+	case OP_RET:
+	case OP_RETI:
+	case OP_JMP:
+	case OP_IJMP:
+	case OP_THROW:
+	case OP_CAST:
+		ForgetChecks();
+		return;
+
+	case OP_TEST:
+	case OP_TESTN:
+	case OP_BOUND:
+	case OP_BOUND_K:
+	case OP_BOUND_R:
+	case OP_NULLCHECK:
+	case OP_SCOPE:
+		return;		// only read register A
+
+	default:
+		break;
+	}
+
+	if (instr->op >= OP_SB && instr->op <= OP_SBIT)
+		return;		// stores use register A as the address
+
+	switch (OpInfo[instr->op].Mode & MODE_ATYPE)
+	{
+	case MODE_AI:
+		knownBound[instr->a] = 0;
+		break;
+
+	case MODE_AP:
+		knownNonNull[instr->a] = false;
+		break;
+
+	case MODE_AF:
+	case MODE_AS:
+	case MODE_AV:
+	case MODE_ACMP:
+		break;
+
+	default:
+		// Don't know what this writes to.
+		ForgetChecks();
+		break;
+	}
+}
+
+// An index that already passed a check against a bound no larger than this
+// one cannot fail it.
+bool JitCompiler::SkipBoundsCheck(int index, unsigned int bound)
+{
+	if (!optimize)
+		return false;
+
+	if (knownBound[index] != 0 && knownBound[index] <= bound)
+	{
+		RemovedChecks++;
+		return true;
+	}
+	knownBound[index] = bound;
+	return false;
+}
+
 void JitCompiler::CreateRegisters()
 {
 	regD.Resize(sfunc->NumRegD);
@@ -480,6 +671,16 @@ void JitCompiler::CreateRegisters()
 
 void JitCompiler::EmitNullPointerThrow(int index, EVMAbortException reason)
 {
+	if (optimize)
+	{
+		if (knownNonNull[index])
+		{
+			RemovedChecks++;
+			return;
+		}
+		knownNonNull[index] = true;
+	}
+
 	auto label = EmitThrowExceptionLabel(reason);
 	cc.test(regA[index], regA[index]);
 	cc.je(label);
@@ -614,3 +815,20 @@ void JitCompiler::EmitNOP()
 {
 	cc.nop();
 }
+
+//==========================================================================
+//
+// CCMD jittierstats
+//
+// Lists the functions that were recompiled by the optimizing tier.
+//
+//==========================================================================
+
+CCMD(jittierstats)
+{
+	for (auto sfunc : TieredFunctions)
+	{
+		Printf("%s\n", sfunc->PrintableName);
+	}
+	Printf("%u functions recompiled, %d null and bounds checks removed\n", TieredFunctions.Size(), RemovedChecks);
+}
@@ -1,8 +1,58 @@
 
 #include "jitintern.h"
+#include "c_dispatch.h"
+#include "printf.h"
+#include <algorithm>
 #include <map>
 #include <memory>
 
+// Inline cache of a virtual call site. The generated code compares the
+// receiver's class against the cached ones and only does the vtable lookup
+// if none of them match. The cache is filled on misses until it is full,
+// after which the site just pays for the comparisons.
+//
+// A cached target that is a native function with a direct entry point is
+// called through that entry point with the arguments in registers, the
+// same way a non-virtual native call is. Everything else goes through
+// ScriptCall with the parameters stored as VMValues.
+struct JitCallCache
+{
+	enum { NUM_ENTRIES = 4 };
+
+	PClass *Classes[NUM_ENTRIES];
+	VMFunction *Targets[NUM_ENTRIES];
+	void *DirectCalls[NUM_ENTRIES];	// DirectNativeCall of the target, or null
+	int NumEntries;
+	uint32_t Hits;
+	uint32_t Misses;
+
+	VMScriptFunction *Caller;
+	const VMOP *Site;
+};
+
+static TArray<JitCallCache *> JitCallCaches;
+
+static void FillCallCache(JitCallCache *cache, PClass *cls, VMFunction *target)
+{
+	if (cache->NumEntries < JitCallCache::NUM_ENTRIES)
+	{
+		cache->Classes[cache->NumEntries] = cls;
+		cache->Targets[cache->NumEntries] = target;
+		cache->DirectCalls[cache->NumEntries] = (target->VarFlags & VARF_Native) ?
+			static_cast<VMNativeFunction *>(target)->DirectNativeCall : nullptr;
+		cache->NumEntries++;
+	}
+}
+
+void JitReleaseCallCaches()
+{
+	for (auto cache : JitCallCaches)
+	{
+		delete cache;
+	}
+	JitCallCaches.Clear();
+}
+
 void JitCompiler::EmitPARAM()
 {
 	ParamOpcodes.Push(pc);
@@ -25,8 +75,10 @@ void JitCompiler::EmitVTBL()
 	// This instruction is handled in the CALL/CALL_K instruction following it
 }
 
-void JitCompiler::EmitVtbl(const VMOP *op)
+void JitCompiler::EmitVtbl(const VMOP *op, asmjit::X86Gp scriptcall, asmjit::X86Gp *directcall)
 {
+	using namespace asmjit;
+
 	int a = op->a;
 	int b = op->b;
 	int c = op->c;
@@ -35,9 +87,51 @@ void JitCompiler::EmitVtbl(const VMOP *op)
 	cc.test(regA[b], regA[b]);
 	cc.jz(label);
 
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[b], myoffsetof(DObject, Class)));
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[a], myoffsetof(PClass, Virtuals) + myoffsetof(FArray, Array)));
-	cc.mov(regA[a], asmjit::x86::qword_ptr(regA[a], c * (int)sizeof(void*)));
+	auto cache = new JitCallCache();
+	cache->Caller = sfunc;
+	cache->Site = op;
+	JitCallCaches.Push(cache);
+
+	auto cls = newTempIntPtr();
+	auto cacheptr = newTempIntPtr();
+	auto hit = cc.newLabel();
+	auto done = cc.newLabel();
+	cc.mov(cls, x86::qword_ptr(regA[b], myoffsetof(DObject, Class)));
+	cc.mov(cacheptr, imm_ptr(cache));
+	for (int i = 0; i < JitCallCache::NUM_ENTRIES; i++)
+	{
+		auto next = cc.newLabel();
+		cc.cmp(cls, x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, Classes) + i * (int)sizeof(void*)));
+		cc.jne(next);
+		cc.mov(regA[a], x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, Targets) + i * (int)sizeof(void*)));
+		if (directcall)
+			cc.mov(*directcall, x86::qword_ptr(cacheptr, myoffsetof(JitCallCache, DirectCalls) + i * (int)sizeof(void*)));
+		cc.jmp(hit);
+		cc.bind(next);
+	}
+
+	// Miss: look the function up in the vtable and remember it if there is room left.
+	auto full = cc.newLabel();
+	cc.mov(regA[a], x86::qword_ptr(cls, myoffsetof(PClass, Virtuals) + myoffsetof(FArray, Array)));
+	cc.mov(regA[a], x86::qword_ptr(regA[a], c * (int)sizeof(void*)));
+	if (directcall)
+		cc.xor_(*directcall, *directcall);	// Misses always take the VM calling convention.
+	cc.add(x86::dword_ptr(cacheptr, myoffsetof(JitCallCache, Misses)), 1);
+	cc.cmp(x86::dword_ptr(cacheptr, myoffsetof(JitCallCache, NumEntries)), JitCallCache::NUM_ENTRIES);
+	cc.jae(full);
+	auto fill = CreateCall<void, JitCallCache *, PClass *, VMFunction *>(FillCallCache);
+	fill->setArg(0, cacheptr);
+	fill->setArg(1, cls);
+	fill->setArg(2, regA[a]);
+	cc.bind(full);
+	cc.jmp(done);
+
+	cc.bind(hit);
+	cc.add(x86::dword_ptr(cacheptr, myoffsetof(JitCallCache, Hits)), 1);
+	cc.bind(done);
+
+	// Functions get compiled on their first call, so the entry point cannot be cached.
+	cc.mov(scriptcall, x86::ptr(regA[a], myoffsetof(VMFunction, ScriptCall)));
 }
 
 void JitCompiler::EmitCALL()
@@ -74,21 +168,51 @@ void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
 
 	CheckVMFrame();
 
+	auto scriptcall = newTempIntPtr();
+	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
+	{
+		if (CanCallNativeDirectly())
+		{
+			auto directcall = newTempIntPtr();
+			auto viavm = cc.newLabel();
+			auto done = cc.newLabel();
+			EmitVtbl(pc - 1, scriptcall, &directcall);
+			cc.test(directcall, directcall);
+			cc.jz(viavm);
+			EmitDirectNativeCall(directcall, "cached native virtual");
+			cc.jmp(done);
+			cc.bind(viavm);
+			EmitScriptCall(vmfunc, scriptcall, target);
+			cc.bind(done);
+		}
+		else
+		{
+			EmitVtbl(pc - 1, scriptcall, nullptr);
+			EmitScriptCall(vmfunc, scriptcall, target);
+		}
+	}
+	else
+	{
+		cc.mov(scriptcall, x86::ptr(vmfunc, myoffsetof(VMScriptFunction, ScriptCall)));
+		EmitScriptCall(vmfunc, scriptcall, target);
+	}
+
+	ParamOpcodes.Clear();
+}
+
+void JitCompiler::EmitScriptCall(asmjit::X86Gp vmfunc, asmjit::X86Gp scriptcall, VMFunction *target)
+{
+	using namespace asmjit;
+
 	int numparams = StoreCallParams();
 	if (numparams != B)
 		I_Error("OP_CALL parameter count does not match the number of preceding OP_PARAM instructions");
 
-	if (pc > sfunc->Code && (pc - 1)->op == OP_VTBL)
-		EmitVtbl(pc - 1);
-
 	FillReturns(pc + 1, C);
 
 	X86Gp paramsptr = newTempIntPtr();
 	cc.lea(paramsptr, x86::ptr(vmframe, offsetParams));
 
-	auto scriptcall = newTempIntPtr();
-	cc.mov(scriptcall, x86::ptr(vmfunc, myoffsetof(VMScriptFunction, ScriptCall)));
-
 	auto result = newResultInt32();
 	auto call = cc.call(scriptcall, FuncSignature5<int, VMFunction *, VMValue*, int, VMReturn*, int>());
 	call->setRet(0, result);
@@ -101,8 +225,18 @@ void JitCompiler::EmitVMCall(asmjit::X86Gp vmfunc, VMFunction *target)
 
 	LoadInOuts();
 	LoadReturns(pc + 1, C);
+}
 
-	ParamOpcodes.Clear();
+// Can the parameters and returns of this call be passed the way a direct
+// native call expects them? Only int, pointer and float references are not.
+bool JitCompiler::CanCallNativeDirectly()
+{
+	for (auto param : ParamOpcodes)
+	{
+		if (param->op == OP_PARAM && (param->a & REGT_ADDROF) && (param->a & REGT_TYPE) != REGT_STRING)
+			return false;
+	}
+	return true;
 }
 
 int JitCompiler::StoreCallParams()
@@ -358,9 +492,17 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 		cc.jz(label);
 	}
 
+	EmitDirectNativeCall(imm_ptr(target->DirectNativeCall), target->PrintableName);
+	ParamOpcodes.Clear();
+}
+
+void JitCompiler::EmitDirectNativeCall(const asmjit::Operand_ &func, const char *comment)
+{
+	using namespace asmjit;
+
 	asmjit::CBNode *cursorBefore = cc.getCursor();
-	auto call = cc.call(imm_ptr(target->DirectNativeCall), CreateFuncSignature());
-	call->setInlineComment(target->PrintableName);
+	auto call = cc.addCall(X86Inst::kIdCall, func, CreateFuncSignature());
+	call->setInlineComment(comment);
 	asmjit::CBNode *cursorAfter = cc.getCursor();
 	cc.setCursor(cursorBefore);
 
@@ -585,8 +727,6 @@ void JitCompiler::EmitNativeCall(VMNativeFunction *target)
 			break;
 		}
 	}
-
-	ParamOpcodes.Clear();
 }
 
 static std::map<FString, std::unique_ptr<TArray<uint8_t>>> argsCache;
@@ -723,4 +863,42 @@ asmjit::FuncSignature JitCompiler::CreateFuncSignature()
 void JitCompiler::EmitNULLCHECK()
 {
 	EmitNullPointerThrow(A, X_READ_NIL);
-}
\ No newline at end of file
+}
+
+//==========================================================================
+//
+// CCMD jitcallstats
+//
+// Lists the virtual call sites in JIT compiled code that were called most.
+//
+//==========================================================================
+
+CCMD(jitcallstats)
+{
+	int count = argv.argc() > 1 ? std::max(1, atoi(argv[1])) : 20;
+
+	TArray<JitCallCache *> sites = JitCallCaches;
+	std::sort(sites.begin(), sites.end(), [](JitCallCache *a, JitCallCache *b)
+	{
+		return uint64_t(a->Hits) + a->Misses > uint64_t(b->Hits) + b->Misses;
+	});
+
+	uint64_t hits = 0, calls = 0;
+	for (auto cache : sites)
+	{
+		hits += cache->Hits;
+		calls += uint64_t(cache->Hits) + cache->Misses;
+	}
+	for (int i = 0; i < count && i < (int)sites.Size(); i++)
+	{
+		auto cache = sites[i];
+		uint64_t sitecalls = uint64_t(cache->Hits) + cache->Misses;
+		if (sitecalls == 0) break;
+		Printf("%s line %d: %s, %llu calls, %.1f%% hits, %d class%s\n",
+			cache->Caller->PrintableName, cache->Caller->PCToLine(cache->Site),
+			cache->NumEntries > 0 ? cache->Targets[0]->PrintableName : "?",
+			(unsigned long long)sitecalls, 100. * cache->Hits / sitecalls,
+			cache->NumEntries, cache->NumEntries == 1 ? "" : "es");
+	}
+	Printf("%u call sites, %llu calls, %.1f%% hits\n", sites.Size(), (unsigned long long)calls, calls > 0 ? 100. * hits / calls : 0.);
+}
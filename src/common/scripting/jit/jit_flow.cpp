@@ -20,6 +20,8 @@ void JitCompiler::EmitJMP()
 {
 	auto dest = pc + JMPOFS(pc) + 1;
 	int i = (int)(ptrdiff_t)(dest - sfunc->Code);
+	if (dest <= pc)
+		EmitTierCounter();	// loop back-edge
 	cc.jmp(GetLabel(i));
 }
 
@@ -272,6 +274,9 @@ void JitCompiler::EmitTHROW()
 
 void JitCompiler::EmitBOUND()
 {
+	if (SkipBoundsCheck(A, BC))
+		return;
+
 	auto cursor = cc.getCursor();
 	auto label = cc.newLabel();
 	cc.bind(label);
@@ -291,6 +296,9 @@ void JitCompiler::EmitBOUND()
 
 void JitCompiler::EmitBOUND_K()
 {
+	if (SkipBoundsCheck(A, konstd[BC]))
+		return;
+
 	auto cursor = cc.getCursor();
 	auto label = cc.newLabel();
 	cc.bind(label);
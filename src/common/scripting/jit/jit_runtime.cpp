@@ -758,6 +758,8 @@ void JitRelease()
 	JitBlocks.Clear();
 	JitBlockPos = 0;
 	JitBlockSize = 0;
+	JitReleaseCallCaches();
+	JitReleaseTiers();
 }
 
 static int CaptureStackTrace(int max_frames, void **out_frames)
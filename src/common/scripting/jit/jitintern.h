@@ -35,7 +35,7 @@ struct JitLineInfo
 class JitCompiler
 {
 public:
-	JitCompiler(asmjit::CodeHolder *code, VMScriptFunction *sfunc) : cc(code), sfunc(sfunc) { }
+	JitCompiler(asmjit::CodeHolder *code, VMScriptFunction *sfunc, bool optimize = false) : cc(code), sfunc(sfunc), optimize(optimize) { }
 
 	asmjit::CCFunc *Codegen();
 	VMScriptFunction *GetScriptFunction() { return sfunc; }
@@ -53,6 +53,8 @@ private:
 	void Setup();
 	void CreateRegisters();
 	void IncrementVMCalls();
+	void EmitTierCounter();
+	bool CountsTiers();
 	void SetupFrame();
 	void SetupSimpleFrame();
 	void SetupFullVMFrame();
@@ -61,8 +63,11 @@ private:
 	void EmitPopFrame();
 
 	void EmitNativeCall(VMNativeFunction *target);
+	void EmitDirectNativeCall(const asmjit::Operand_ &func, const char *comment);
+	bool CanCallNativeDirectly();
 	void EmitVMCall(asmjit::X86Gp ptr, VMFunction *target);
-	void EmitVtbl(const VMOP *op);
+	void EmitScriptCall(asmjit::X86Gp vmfunc, asmjit::X86Gp scriptcall, VMFunction *target);
+	void EmitVtbl(const VMOP *op, asmjit::X86Gp scriptcall, asmjit::X86Gp *directcall);
 
 	int StoreCallParams();
 	void LoadInOuts();
@@ -79,9 +84,23 @@ private:
 
 		auto successLabel = cc.newLabel();
 
-		auto failLabel = GetLabel(i + 2 + JMPOFS(pc + 1));
+		int target = i + 2 + JMPOFS(pc + 1);
+		auto failLabel = GetLabel(target);
 
-		jmpFunc(static_cast<bool>(A & CMP_CHECK), failLabel, successLabel);
+		if (target <= i + 1 && CountsTiers())
+		{
+			// A loop condition: count the back-edge like EmitJMP does.
+			auto backEdge = cc.newLabel();
+			jmpFunc(static_cast<bool>(A & CMP_CHECK), backEdge, successLabel);
+			cc.jmp(successLabel);
+			cc.bind(backEdge);
+			EmitTierCounter();
+			cc.jmp(failLabel);
+		}
+		else
+		{
+			jmpFunc(static_cast<bool>(A & CMP_CHECK), failLabel, successLabel);
+		}
 
 		cc.bind(successLabel);
 		pc++; // This instruction uses two instruction slots - skip the next one
@@ -237,6 +256,7 @@ private:
 	void EmitReadBarrier();
 
 	void EmitNullPointerThrow(int index, EVMAbortException reason);
+	bool SkipBoundsCheck(int index, unsigned int bound);
 	void EmitThrowException(EVMAbortException reason);
 	asmjit::Label EmitThrowExceptionLabel(EVMAbortException reason);
 
@@ -254,6 +274,17 @@ private:
 	asmjit::X86Compiler cc;
 	VMScriptFunction *sfunc;
 
+	// Optimizing tier: drop null and bounds checks that an earlier check in
+	// the same straight-line block already did.
+	bool optimize;
+	TArray<bool> jumpTargets;
+	TArray<bool> knownNonNull;
+	TArray<unsigned int> knownBound;
+
+	void FindJumpTargets();
+	void ForgetChecks();
+	void UpdateChecks(const VMOP *instr);
+
 	asmjit::CCFunc *func = nullptr;
 	asmjit::X86Gp args;
 	asmjit::X86Gp numargs;
@@ -354,4 +385,6 @@ public:
 };
 
 void *AddJitFunction(asmjit::CodeHolder* code, JitCompiler *compiler);
+void JitReleaseCallCaches();
+void JitReleaseTiers();
 asmjit::CodeInfo GetHostCodeInfo();
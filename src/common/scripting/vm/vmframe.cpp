@@ -36,6 +36,7 @@
 #include "dobject.h"
 #include "v_text.h"
 #include "stats.h"
+#include "tracecapture.h"
 #include "c_dispatch.h"
 
 #include "vmintern.h"
@@ -368,7 +369,7 @@ void VMFrame::InitRegS()
 VMFrameStack::VMFrameStack()
 {
 	Blocks = NULL;
-	UnusedBlocks = NULL;
+	memset(UnusedBlocks, 0, sizeof(UnusedBlocks));
 }
 
 //===========================================================================
@@ -391,15 +392,15 @@ VMFrameStack::~VMFrameStack()
 		}
 		Blocks = NULL;
 	}
-	if (UnusedBlocks != NULL)
+	for (auto &unused : UnusedBlocks)
 	{
 		BlockHeader *block, *next;
-		for (block = UnusedBlocks; block != NULL; block = next)
+		for (block = unused; block != NULL; block = next)
 		{
 			next = block->NextBlock;
 			delete[] (VM_UBYTE *)block;
 		}
-		UnusedBlocks = NULL;
+		unused = NULL;
 	}
 }
 
@@ -410,6 +411,10 @@ VMFrameStack::~VMFrameStack()
 // Allocates a frame from the stack suitable for calling a particular
 // function.
 //
+// Registers must start out cleared, because the code generator relies on
+// that for local variables without an initializer. The parameter area is
+// always written before it is read, so it is left alone.
+//
 //===========================================================================
 
 VMFrame *VMFrameStack::AllocFrame(VMScriptFunction *func)
@@ -421,11 +426,25 @@ VMFrame *VMFrameStack::AllocFrame(VMScriptFunction *func)
 	frame->NumRegS = func->NumRegS;
 	frame->NumRegA = func->NumRegA;
 	frame->MaxParam = func->MaxParam;
-	frame->Func = func;
+	frame->NumParam = 0;
+
+	int *d;
+	double *f;
+	FString *s;
+	void **a;
+	VMValue *param;
+	frame->GetAllRegs(d, f, s, a, param);
+	memset(f, 0, func->NumRegF * sizeof(double));
 	frame->InitRegS();
-	if (func->SpecialInits.Size())
+	// The address and data registers are next to each other.
+	memset(a, 0, func->NumRegA * sizeof(void *) + func->NumRegD * sizeof(int));
+	if (func->ExtraSpace != 0)
 	{
-		func->InitExtra(frame->GetExtra());
+		memset(frame->GetExtra(), 0, func->ExtraSpace);
+		if (func->SpecialInits.Size())
+		{
+			func->InitExtra(frame->GetExtra());
+		}
 	}
 	return frame;
 }
@@ -435,7 +454,7 @@ VMFrame *VMFrameStack::AllocFrame(VMScriptFunction *func)
 // VMFrameStack :: Alloc
 //
 // Allocates space for a frame. Its size will be rounded up to a multiple
-// of 16 bytes.
+// of 16 bytes. The memory is not cleared.
 //
 //===========================================================================
 
@@ -455,28 +474,24 @@ VMFrame *VMFrameStack::Alloc(int size)
 		parent = NULL;
 	}
 	if (block == NULL || ((VM_UBYTE *)block + block->BlockSize) < (block->FreeSpace + size))
-	{ // Not enough space. Allocate a new block.
-		int blocksize = ((sizeof(BlockHeader) + 15) & ~15) + size;
-		BlockHeader **blockp;
-		if (blocksize < BLOCK_SIZE)
-		{
-			blocksize = BLOCK_SIZE;
-		}
-		for (blockp = &UnusedBlocks, block = *blockp; block != NULL; block = block->NextBlock)
+	{ // Not enough space. Get a new block.
+		int needed = ((sizeof(BlockHeader) + 15) & ~15) + size;
+		int sizeclass = 0;
+		while ((BLOCK_SIZE << sizeclass) < needed)
 		{
-			if (block->BlockSize >= blocksize)
-			{
-				break;
-			}
+			sizeclass++;
 		}
+		assert(sizeclass < NUM_BLOCK_CLASSES);
+		block = UnusedBlocks[sizeclass];
 		if (block != NULL)
 		{
-			*blockp = block->NextBlock;
+			UnusedBlocks[sizeclass] = block->NextBlock;
 		}
 		else
 		{
-			block = (BlockHeader *)new VM_UBYTE[blocksize];
-			block->BlockSize = blocksize;
+			block = (BlockHeader *)new VM_UBYTE[BLOCK_SIZE << sizeclass];
+			block->BlockSize = BLOCK_SIZE << sizeclass;
+			block->SizeClass = sizeclass;
 		}
 		block->InitFreeSpace();
 		block->LastFrame = NULL;
@@ -484,7 +499,6 @@ VMFrame *VMFrameStack::Alloc(int size)
 		Blocks = block;
 	}
 	frame = (VMFrame *)block->FreeSpace;
-	memset(frame, 0, size);
 	frame->ParentFrame = parent;
 	block->FreeSpace += size;
 	block->LastFrame = frame;
@@ -540,8 +554,8 @@ VMFrame *VMFrameStack::PopFrame()
 		BlockHeader *next = Blocks->NextBlock;
 		assert(next != NULL);
 		assert((VM_UBYTE *)parent >= (VM_UBYTE *)next && (VM_UBYTE *)parent < (VM_UBYTE *)next + next->BlockSize);
-		Blocks->NextBlock = UnusedBlocks;
-		UnusedBlocks = Blocks;
+		Blocks->NextBlock = UnusedBlocks[Blocks->SizeClass];
+		UnusedBlocks[Blocks->SizeClass] = Blocks;
 		Blocks = next;
 	}
 	else
@@ -594,6 +608,7 @@ int VMCall(VMFunction *func, VMValue *params, int numparams, VMReturn *results,
 				VMCycles[0].Clock();
 
 				auto sfunc = static_cast<VMScriptFunction *>(func);
+				TRACE_SCOPE(sfunc->PrintableName, TRACE_VM);
 				int numret = sfunc->ScriptCall(sfunc, params, numparams, results, numresults);
 				VMCycles[0].Unclock();
 				return numret;
@@ -799,3 +814,63 @@ CCMD(vmengine)
 	Printf("Usage: vmengine <default|checked|unchecked>\n");
 }
 
+//-----------------------------------------------------------------------------
+//
+// Measures the call overhead of a static script function without
+// parameters, once through the interpreter and once through the code
+// the function normally runs, which is JIT compiled unless vm_jit is off.
+//
+//-----------------------------------------------------------------------------
+CCMD(vmcallbench)
+{
+	if (argv.argc() < 3)
+	{
+		Printf("Usage: vmcallbench <class> <function> [count]\n");
+		return;
+	}
+	auto func = PClass::FindFunction(argv[1], argv[2]);
+	if (func == nullptr)
+	{
+		Printf("Function %s.%s not found\n", argv[1], argv[2]);
+		return;
+	}
+	if ((func->VarFlags & (VARF_Native | VARF_Method)) || static_cast<VMScriptFunction *>(func)->NumArgs != 0)
+	{
+		Printf("%s is not a static script function without parameters\n", func->PrintableName);
+		return;
+	}
+	auto sfunc = static_cast<VMScriptFunction *>(func);
+	int count = argv.argc() > 3 ? max(1, atoi(argv[3])) : 1000000;
+
+	// The first call compiles the function.
+	VMCall(sfunc, nullptr, 0, nullptr, 0);
+
+	cycle_t interp, compiled;
+	interp.Reset();
+	interp.Clock();
+	for (int i = 0; i < count; i++)
+	{
+		VMExec(sfunc, nullptr, 0, nullptr, 0);
+	}
+	interp.Unclock();
+
+	compiled.Reset();
+	compiled.Clock();
+	for (int i = 0; i < count; i++)
+	{
+		sfunc->ScriptCall(sfunc, nullptr, 0, nullptr, 0);
+	}
+	compiled.Unclock();
+
+	Printf("%s: %d calls, %u byte frame\n", sfunc->PrintableName, count, sfunc->StackSize);
+	Printf("Interpreter: %.1f ns per call\n", interp.TimeMS() * 1e6 / count);
+	if (sfunc->ScriptCall != VMExec)
+	{
+		Printf("JIT: %.1f ns per call\n", compiled.TimeMS() * 1e6 / count);
+	}
+	else
+	{
+		Printf("JIT: not in use\n");
+	}
+}
+
@@ -362,13 +362,18 @@ public:
 	}
 	static int OffsetLastFrame() { return (int)(ptrdiff_t)offsetof(BlockHeader, LastFrame); }
 private:
-	enum { BLOCK_SIZE = 4096 };		// Default block size
+	enum
+	{
+		BLOCK_SIZE = 4096,			// Default block size
+		NUM_BLOCK_CLASSES = 16,		// Blocks are BLOCK_SIZE times a power of two
+	};
 	struct BlockHeader
 	{
 		BlockHeader *NextBlock;
 		VMFrame *LastFrame;
 		VM_UBYTE *FreeSpace;
 		int BlockSize;
+		int SizeClass;
 
 		void InitFreeSpace()
 		{
@@ -376,7 +381,7 @@ private:
 		}
 	};
 	BlockHeader *Blocks;
-	BlockHeader *UnusedBlocks;
+	BlockHeader *UnusedBlocks[NUM_BLOCK_CLASSES];	// One free list per block size
 	VMFrame *Alloc(int size);
 };
 
@@ -475,6 +480,8 @@ public:
 	TArray<FTypeAndOffset> SpecialInits;	// list of all contents on the extra stack which require construction and destruction
 
 	bool blockJit = false; // function triggers Jit bugs, block compilation until bugs are fixed
+	int JitTierCount = 0;	// calls and loop iterations counted by the baseline JIT code
+	bool JitOptimized = false;	// has been recompiled by the optimizing JIT tier
 
 	void InitExtra(void *addr);
 	void DestroyExtra(void *addr);
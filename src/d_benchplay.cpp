@@ -0,0 +1,273 @@
+/*
+** d_benchplay.cpp
+** Deterministic headless playsim benchmark
+**
+**---------------------------------------------------------------------------
+**
+** This program is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation, either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see http://www.gnu.org/licenses/
+**
+**---------------------------------------------------------------------------
+**
+** Usage:
+**   -benchplay <map|savegame> [-benchtics <n>] [-benchwarmup <n>] [-benchout <file>]
+**
+** The game is started with the null sound backend and without creating a
+** window (the dummy framebuffer from V_InitScreen stays active), the given
+** map or savegame is loaded with a static RNG seed and the playsim is run
+** for a fixed number of tics without any player input. Each tic's total
+** time is recorded together with the time spent in RunThinkers, the
+** defined particle pool, sight checks, the VM and the garbage collector,
+** and the result is written out as JSON for regression tracking.
+**
+*/
+
+#include "d_benchplay.h"
+#include "m_argv.h"
+#include "m_random.h"
+#include "cmdlib.h"
+#include "doomstat.h"
+#include "engineerrors.h"
+#include "files.h"
+#include "g_game.h"
+#include "g_level.h"
+#include "d_net.h"
+#include "p_setup.h"
+#include "stats.h"
+#include "printf.h"
+#include "v_font.h"
+#include "savegamemanager.h"
+#include "g_levellocals.h"
+#include "d_event.h"
+#include "i_time.h"
+
+extern cycle_t ThinkCycles;
+extern int ThinkCount;
+extern cycle_t SightCycles;
+extern int sightcounts[6];
+extern cycle_t DefinedParticleCycles;
+extern cycle_t VMCycles[10];
+
+struct FBenchTic
+{
+	double Total;
+	double Thinkers;
+	double Particles;
+	double Sight;
+	double VM;
+	double GC;
+	int NumThinkers;
+	int SightTraversals;
+};
+
+//==========================================================================
+//
+// D_IsBenchPlay
+//
+//==========================================================================
+
+bool D_IsBenchPlay()
+{
+	return Args->CheckParm("-benchplay") > 0;
+}
+
+//==========================================================================
+//
+//
+//
+//==========================================================================
+
+static FString JsonEscape(const char *str)
+{
+	FString out;
+	for (; *str; str++)
+	{
+		switch (*str)
+		{
+		case '"':	out += "\\\""; break;
+		case '\\':	out += "\\\\"; break;
+		case '\n':	out += "\\n"; break;
+		default:
+			if ((uint8_t)*str >= 0x20) out += *str;
+			break;
+		}
+	}
+	return out;
+}
+
+static void WriteSummary(FileWriter *fw, const char *name, const TArray<FBenchTic> &tics, double FBenchTic::*field, bool last)
+{
+	double sum = 0, peak = 0;
+	for (auto &tic : tics)
+	{
+		sum += tic.*field;
+		peak = max(peak, tic.*field);
+	}
+	double mean = tics.Size() > 0 ? sum / tics.Size() : 0;
+	fw->Printf("\t\t\"%s\": { \"sum\": %.4f, \"mean\": %.4f, \"max\": %.4f }%s\n", name, sum, mean, peak, last ? "" : ",");
+}
+
+static bool WriteBenchResults(const char *filename, const char *target, int warmup, const TArray<FBenchTic> &tics)
+{
+	FileWriter *fw = FileWriter::Open(filename);
+	if (fw == nullptr)
+	{
+		return false;
+	}
+
+	fw->Printf("{\n");
+	fw->Printf("\t\"target\": \"%s\",\n", JsonEscape(target).GetChars());
+	fw->Printf("\t\"map\": \"%s\",\n", JsonEscape(primaryLevel->MapName.GetChars()).GetChars());
+	fw->Printf("\t\"rngseed\": %u,\n", rngseed);
+	fw->Printf("\t\"warmup\": %d,\n", warmup);
+	fw->Printf("\t\"tics\": %u,\n", tics.Size());
+	fw->Printf("\t\"summary\": {\n");
+	WriteSummary(fw, "total", tics, &FBenchTic::Total, false);
+	WriteSummary(fw, "thinkers", tics, &FBenchTic::Thinkers, false);
+	WriteSummary(fw, "particles", tics, &FBenchTic::Particles, false);
+	WriteSummary(fw, "sight", tics, &FBenchTic::Sight, false);
+	WriteSummary(fw, "vm", tics, &FBenchTic::VM, false);
+	WriteSummary(fw, "gc", tics, &FBenchTic::GC, true);
+	fw->Printf("\t},\n");
+	fw->Printf("\t\"frames\": [\n");
+	for (unsigned i = 0; i < tics.Size(); i++)
+	{
+		auto &tic = tics[i];
+		fw->Printf("\t\t{ \"total\": %.4f, \"thinkers\": %.4f, \"particles\": %.4f, \"sight\": %.4f, \"vm\": %.4f, \"gc\": %.4f, \"numthinkers\": %d, \"sighttraversals\": %d }%s\n",
+			tic.Total, tic.Thinkers, tic.Particles, tic.Sight, tic.VM, tic.GC, tic.NumThinkers, tic.SightTraversals,
+			i + 1 < tics.Size() ? "," : "");
+	}
+	fw->Printf("\t]\n");
+	fw->Printf("}\n");
+	delete fw;
+	return true;
+}
+
+//==========================================================================
+//
+// RunBenchTic
+//
+// Runs a single tic the same way D_DoomLoop does with -singletics, minus
+// all input processing.
+//
+//==========================================================================
+
+static void RunBenchTic(FBenchTic *result)
+{
+	cycle_t total, gc;
+	double vmstart = VMCycles[0].TimeMS();
+
+	total.ResetAndClock();
+	G_Ticker();
+	gametic++;
+	maketic++;
+	total.Unclock();
+
+	gc.ResetAndClock();
+	GC::CheckGC();
+	gc.Unclock();
+	Net_NewMakeTic();
+
+	if (result != nullptr)
+	{
+		result->Total = total.TimeMS();
+		result->Thinkers = ThinkCycles.TimeMS();
+		result->Particles = DefinedParticleCycles.TimeMS();
+		result->Sight = SightCycles.TimeMS();
+		result->VM = VMCycles[0].TimeMS() - vmstart;
+		result->GC = gc.TimeMS();
+		result->NumThinkers = ThinkCount;
+		result->SightTraversals = sightcounts[3];
+	}
+}
+
+//==========================================================================
+//
+// D_RunBenchPlay
+//
+// Called by D_InitGame in place of entering the main loop. This never
+// returns; it exits with a non-zero code on failure.
+//
+//==========================================================================
+
+void D_RunBenchPlay()
+{
+	const char *target = Args->CheckValue("-benchplay");
+	if (target == nullptr || *target == 0)
+	{
+		I_FatalError("-benchplay requires a map name or savegame");
+	}
+
+	int numtics = 2100;
+	int warmup = 35;
+	const char *v;
+	if ((v = Args->CheckValue("-benchtics"))) numtics = max(1, atoi(v));
+	if ((v = Args->CheckValue("-benchwarmup"))) warmup = max(0, atoi(v));
+	const char *outname = Args->CheckValue("-benchout");
+	if (outname == nullptr) outname = "benchplay.json";
+
+	// Results must be comparable between runs, so never use a random seed here.
+	if (!use_staticrng)
+	{
+		rngseed = staticrngseed = 0;
+		use_staticrng = true;
+	}
+
+	FString savename = G_BuildSaveName(target);
+	if (FileExists(target) || FileExists(savename))
+	{
+		G_LoadGame(FileExists(target) ? target : savename.GetChars());
+	}
+	else if (P_CheckMapData(target))
+	{
+		G_InitNew(target, false);
+	}
+	else
+	{
+		I_FatalError("-benchplay: Cannot find map or savegame '%s'", target);
+	}
+
+	// Process pending game actions (e.g. the savegame load) before measuring anything.
+	for (int i = 0; i < 16 && gameaction != ga_nothing; i++)
+	{
+		RunBenchTic(nullptr);
+	}
+	if (gamestate != GS_LEVEL)
+	{
+		I_FatalError("-benchplay: '%s' did not start a level", target);
+	}
+
+	Printf("Benchplay: %s, %d warmup tics, %d measured tics\n", primaryLevel->MapName.GetChars(), warmup, numtics);
+
+	for (int i = 0; i < warmup; i++)
+	{
+		RunBenchTic(nullptr);
+	}
+
+	TArray<FBenchTic> results(numtics, true);
+	uint64_t start = I_nsTime();
+	for (int i = 0; i < numtics; i++)
+	{
+		RunBenchTic(&results[i]);
+	}
+	double wall = (I_nsTime() - start) / 1e6;
+
+	Printf("Benchplay: %d tics in %.2f ms (%.4f ms/tic)\n", numtics, wall, wall / numtics);
+
+	if (!WriteBenchResults(outname, target, warmup, results))
+	{
+		I_FatalError("-benchplay: Unable to write %s", outname);
+	}
+	Printf("Benchplay: Results written to %s\n", outname);
+	throw CExitEvent(0);
+}
@@ -0,0 +1,10 @@
+#ifndef __D_BENCHPLAY_H__
+#define __D_BENCHPLAY_H__
+
+// -benchplay runs the playsim headless for a fixed number of tics and
+// writes the per-tic timings as JSON. See d_benchplay.cpp.
+
+bool D_IsBenchPlay();
+[[noreturn]] void D_RunBenchPlay();
+
+#endif
@@ -116,6 +116,7 @@
 #include "hwrenderer/scene/hw_drawinfo.h"
 #include "doomfont.h"
 #include "screenjob.h"
+#include "d_benchplay.h"
 #include "startscreen.h"
 #include "shiftstate.h"
 #include "s_loader.h"
@@ -1292,6 +1293,7 @@ void D_DoomLoop ()
 			// Update display, next frame, with current state.
 			I_StartTic ();
 			statDatabase.update();
+			Archipelago_ProcessMessages();
 			D_ProcessEvents();
 			D_Display ();
 			S_UpdateMusic();
@@ -3476,7 +3478,8 @@ static int D_InitGame(const FIWADInfo* iwad_info, std::vector<std::string>& allw
 		vk_max_transfer_threads = min(1, (int)vk_max_transfer_threads);
 	}
 
-	if (!restart)
+	// -benchplay keeps the dummy framebuffer so that no window gets created.
+	if (!restart && !D_IsBenchPlay())
 		V_Init2();
 
 	CLOCK_START
@@ -3748,6 +3751,11 @@ static int D_InitGame(const FIWADInfo* iwad_info, std::vector<std::string>& allw
 
 		S_Sound (CHAN_BODY, 0, "misc/startupdone", 1, ATTN_NONE);
 
+		if (D_IsBenchPlay())
+		{
+			D_RunBenchPlay();
+		}
+
 		if (Args->CheckParm("-norun") || batchrun)
 		{
 			return 1337; // special exit
@@ -3953,6 +3961,13 @@ static int D_DoomMain_Internal (void)
 		Printf("\n");
 	}
 
+	if (D_IsBenchPlay())
+	{
+		// Headless benchmark: no sound, no startup screen.
+		batchrun = true;
+		nosound = true;
+	}
+
 	Printf("%s version %s\n", GAMENAME, GetVersionString());
 
 	extern void D_ConfirmSendStats();
@@ -113,6 +113,7 @@ void	G_DoAutoSave ();
 void	G_DoQuickSave ();
 
 void STAT_Serialize(FSerializer &file);
+void Archipelago_Serialize(FSerializer &arc);
 
 CVARD_NAMED(Int, gameskill, skill, 2, CVAR_SERVERINFO|CVAR_LATCH, "sets the skill for the next newly started game")
 CVAR(Bool, save_formatted, false, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)	// use formatted JSON for saves (more readable but a larger files and a bit slower.
@@ -1934,14 +1935,17 @@ static bool CheckSingleWad (const char *name, bool &printRequires, bool printwar
 
 // Return false if not all the needed wads have been loaded.
 bool G_CheckSaveGameWads (FSerializer &arc, bool printwarn, TArray<FString> *wadList)
+{
+	return G_CheckSaveGameWads(arc.GetString("Game WAD"), arc.GetString("Map WAD"), printwarn, wadList);
+}
+
+bool G_CheckSaveGameWads (const char *text, const char *text2, bool printwarn, TArray<FString> *wadList)
 {
 	bool printRequires = false;
 
-	const char *text = arc.GetString("Game WAD");
 	if (!CheckSingleWad(text, printRequires, printwarn) && wadList != nullptr)
 		wadList->Push(text);
 
-	const char *text2 = arc.GetString("Map WAD");
 	// do not validate the same file twice.
 	if (text != nullptr && text2 != nullptr && stricmp(text, text2) != 0) CheckSingleWad (text2, printRequires, printwarn);
 
@@ -2195,6 +2199,7 @@ void G_DoLoadGame ()
 	savegamerestore = false;
 
 	STAT_Serialize(arc);
+	Archipelago_Serialize(arc);
 	FRandom::StaticReadRNGState(arc);
 	P_ReadACSDefereds(arc);
 	P_ReadACSVars(arc);
@@ -2616,6 +2621,7 @@ void G_DoSaveGame (bool okForQuicksave, bool forceQuicksave, FString filename, c
 	}
 
 	STAT_Serialize(savegameglobals);
+	Archipelago_Serialize(savegameglobals);
 	FRandom::StaticWriteRNGState(savegameglobals);
 	P_WriteACSDefereds(savegameglobals);
 	P_WriteACSVars(savegameglobals);
@@ -86,6 +86,7 @@ void G_StartSlideshow(FLevelLocals *Level, FName whichone);
 int		G_BuildSaveNames(const char* prefix, TArray<FString>& outputAr);	// @Cockatice - Get all possible locations for save path (Not a specific slot)
 class FSerializer;
 bool G_CheckSaveGameWads (FSerializer &arc, bool printwarn, TArray<FString> *wadList = nullptr);
+bool G_CheckSaveGameWads (const char *gamewad, const char *mapwad, bool printwarn, TArray<FString> *wadList = nullptr);
 
 enum EFinishLevelType
 {
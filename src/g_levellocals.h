@@ -496,6 +496,7 @@ public:
 	TMap<int, FHealthGroup> healthGroups;
 
 	FBlockmap blockmap;
+	FActorGrid actorgrid;
 	TArray<polyblock_t *> PolyBlockMap;
 	FUDMFKeyMap UDMFKeys[4];
 
@@ -712,6 +713,13 @@ public:
 
 	FDynamicLight *lights;
 
+	// Actors whose lights need to be recreated at the end of the tic and actors
+	// that spawn particle effects, so that RunThinkers does not need to look at every actor.
+	TArray<AActor *> DirtyLightActors;
+	TArray<AActor *> EffectActors;
+	void RecreateDirtyLights(bool setlights);
+	void RunActorEffects();
+
 	// links to global game objects
 	TArray<TObjPtr<AActor *>> CorpseQueue;
 	TObjPtr<DFraggleThinker *> FraggleScriptThinker = MakeObjPtr<DFraggleThinker*>(nullptr);
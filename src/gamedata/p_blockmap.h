@@ -2,8 +2,10 @@
 #define __P_BLOCKMAP_H
 
 #include "doomtype.h"
+#include <math.h>
 
 class AActor;
+struct FLevelLocals;
 
 // [RH] Like msecnode_t, but for the blockmap
 struct FBlockNode
@@ -18,8 +20,6 @@ struct FBlockNode
 
 	static FBlockNode *Create (AActor *who, int x, int y, int group = -1);
 	void Release ();
-
-	static FBlockNode *FreeBlocks;
 };
 
 // BLOCKMAP
@@ -93,4 +93,105 @@ struct FBlockmap
 
 };
 
+//
+// Optional fine-grained actor index used alongside the blockmap.
+// Every actor is stored once, in the cell containing its center, with
+// its position and radius kept in contiguous per-cell arrays so that
+// queries can reject candidates without touching the actors themselves.
+// Actors whose radius exceeds the cell size (or which lie outside the
+// grid) go into an extra cell that every query scans.
+//
+
+struct FActorGrid
+{
+	struct Cell
+	{
+		TArray<float> X;
+		TArray<float> Y;
+		TArray<float> Radius;
+		TArray<AActor *> Actors;
+	};
+
+	TArray<Cell>		Cells;			// last entry is the oversize cell
+	int					CellSize = 0;
+	int					Width = 0;
+	int					Height = 0;
+	double				OrgX = 0;
+	double				OrgY = 0;
+	int					NumLinked = 0;
+
+	// statistics, reset when the 'actorgrid' stat is read
+	int					NumQueries = 0;
+	int					NumTested = 0;
+	int					NumReturned = 0;
+
+	bool IsActive() const
+	{
+		return Cells.Size() > 0;
+	}
+
+	void Init(double orgx, double orgy, double width, double height, int cellsize);
+	void Clear();
+	void Link(AActor *actor);
+	void Unlink(AActor *actor);
+
+	// Calls func for every actor whose box may overlap the square of the
+	// given half size around (x, y).
+	template<class Func> void Query(double x, double y, double halfsize, Func &&func);
+};
+
+void P_InitActorGrid(FLevelLocals *Level);
+
+template<class Func> void FActorGrid::Query(double x, double y, double halfsize, Func &&func)
+{
+	// A little slack to make up for the single precision positions. This only widens the candidate set.
+	const float fx = (float)x, fy = (float)y, fhalf = (float)halfsize + 1.f;
+	const double reach = halfsize + CellSize;
+
+	int x1 = max(0, int((x - reach - OrgX) / CellSize));
+	int x2 = min(Width - 1, int((x + reach - OrgX) / CellSize));
+	int y1 = max(0, int((y - reach - OrgY) / CellSize));
+	int y2 = min(Height - 1, int((y + reach - OrgY) / CellSize));
+
+	NumQueries++;
+
+	auto scan = [&](Cell &cell)
+	{
+		const unsigned count = cell.Actors.Size();
+		const float *px = cell.X.Data();
+		const float *py = cell.Y.Data();
+		const float *pr = cell.Radius.Data();
+		uint8_t hit[16];
+
+		NumTested += count;
+		for (unsigned base = 0; base < count; base += 16)
+		{
+			const unsigned n = min(16u, count - base);
+			// Branch-free so that the compiler can vectorize the rejection test.
+			for (unsigned i = 0; i < n; i++)
+			{
+				const float r = fhalf + pr[base + i];
+				hit[i] = (fabsf(px[base + i] - fx) < r) & (fabsf(py[base + i] - fy) < r);
+			}
+			for (unsigned i = 0; i < n; i++)
+			{
+				if (hit[i])
+				{
+					NumReturned++;
+					func(cell.Actors[base + i]);
+				}
+			}
+		}
+	};
+
+	for (int cy = y1; cy <= y2; cy++)
+	{
+		for (int cx = x1; cx <= x2; cx++)
+		{
+			scan(Cells[cy * Width + cx]);
+		}
+	}
+	scan(Cells.Last());
+}
+
 #endif
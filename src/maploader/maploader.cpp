@@ -85,6 +85,7 @@
 #include "hw_vertexbuilder.h"
 #include "version.h"
 #include "fs_decompress.h"
+#include "tracecapture.h"
 
 enum
 {
@@ -2642,6 +2643,7 @@ void MapLoader::LoadBlockMap (MapData * map)
 	Level->blockmap.blocklinks = new FBlockNode *[count];
 	memset (Level->blockmap.blocklinks, 0, count*sizeof(*Level->blockmap.blocklinks));
 	Level->blockmap.blockmap = Level->blockmap.blockmaplump+4;
+	P_InitActorGrid(Level);
 }
 
 //===========================================================================
@@ -2939,6 +2941,7 @@ void MapLoader::CalcIndices()
 
 void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 {
+	TRACE_SCOPE("LoadLevel", TRACE_Loader);
 	const int *oldvertextable  = nullptr;
 
 	Level->mapVersion = 0;
@@ -3261,6 +3264,7 @@ void MapLoader::LoadLevel(MapData *map, const char *lumpname, int position)
 	PO_Init();				// Initialize the polyobjs
 	if (!Level->IsReentering())
 		Level->FinalizePortals();	// finalize line portals after polyobjects have been initialized. This info is needed for properly flagging them.
+	BuildReject(map);		// needs the final portal and polyobject setup
 
 	Level->aabbTree = new DoomLevelAABBTree(Level);
 	Level->levelMesh = new DoomLevelMesh(*Level);
@@ -298,6 +298,7 @@ public:
 	void LoadSideDefs2(MapData *map, FMissingTextureTracker &missingtex);
 	void LoadBlockMap(MapData * map);
 	void LoadReject(MapData * map, bool junk);
+	void BuildReject(MapData * map);
 	void LoadBehavior(MapData * map);
 	void GetPolySpots(MapData * map, TArray<FNodeBuilder::FPolyStart> &spots, TArray<FNodeBuilder::FPolyStart> &anchors);
 	void GroupLines(bool buildmap);
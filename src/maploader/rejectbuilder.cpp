@@ -0,0 +1,528 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+/*
+** rejectbuilder.cpp
+** Builds a conservative REJECT table for maps that come without one.
+**
+** UDMF maps normally have no usable REJECT lump, so P_CheckSight can never
+** take its early out. This computes a potential visibility set between
+** sectors with a portal flow, similar to the 'basevis' stage of a BSP vis
+** tool:
+**
+** A line of sight from sector A to sector B crosses a chain of portals.
+** Since it is straight, everything after a crossed portal lies beyond it,
+** and everything before it lies in front of it. Chains that violate this
+** for the first or the last crossed portal are discarded. Heights are
+** ignored entirely because they can change at run time.
+**
+** The portals are the GL segs between subsectors of different sectors,
+** minisegs included, not the linedefs. Sectors that only touch where the
+** node builder closed a gap are still connected that way.
+**
+** Everything uncertain is treated as visible:
+**  - Sectors with self-referencing lines, unclosed sectors and sectors
+**    without any subsector see every sector. Their tricks depend on how the
+**    node builder split them, which is not worth second-guessing here.
+**  - Lines belonging to polyobjects are never used as portals. They sit
+**    inside a regular sector so they can only ever block sight.
+**  - Maps with line portals or linked sector portals are skipped because
+**    the sight trace can leave the local geometry through them. This is
+**    checked after the portals have been finalized.
+**  - Sources whose flow exceeds the work budget see every sector.
+**
+** The result is cached on disk, keyed by a checksum of the geometry it was
+** built from. That is taken after the level postprocessor has run, so a
+** compatibility fix that moves a vertex or reassigns a sidedef does not pick
+** up a stale table.
+**
+*/
+
+#include <thread>
+#include <vector>
+#include <miniz.h>
+
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "m_swap.h"
+#include "cmdlib.h"
+#include "i_time.h"
+#include "i_specialpaths.h"
+#include "printf.h"
+#include "p_setup.h"
+#include "g_levellocals.h"
+#include "maploader.h"
+#include "fs_findfile.h"
+#include "tracecapture.h"
+#include "md5.h"
+
+// Off by default. Broken sectors are handled conservatively, but the results
+// have not been checked against enough real maps yet.
+CVAR(Bool, sv_buildreject, false, CVAR_ARCHIVE | CVAR_SERVERINFO)
+CVAR(Bool, sv_cachereject, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG)
+
+static const uint32_t REJECT_CACHE_VERSION = 3;
+static const unsigned REJECT_MAX_SECTORS = 16384;
+static const int REJECT_SOURCE_BUDGET = 4 * 1024 * 1024;
+
+//==========================================================================
+//
+// Portal flow data
+//
+//==========================================================================
+
+struct FRejectPortal
+{
+	DVector2 v1, v2;
+	DVector2 normal;	// unit normal pointing into the destination sector
+	double dist;		// plane distance along normal
+	int line;		// portals with the same id never flow into each other
+	int from, to;
+};
+
+struct FRejectFlow
+{
+	TArray<FRejectPortal> Portals;
+	TArray<TArray<int>> SectorPortals;	// portals leaving each sector
+	unsigned NumSectors;
+	unsigned RowBytes;
+	TArray<uint8_t> Visible;			// one byte aligned row per sector
+};
+
+static const double REJECT_EPSILON = 1. / 16;
+
+// Is any part of 'p' beyond the plane of 'plane'?
+static inline bool PartlyBeyond(const FRejectPortal &p, const FRejectPortal &plane)
+{
+	return (p.v1 | plane.normal) - plane.dist > -REJECT_EPSILON ||
+		(p.v2 | plane.normal) - plane.dist > -REJECT_EPSILON;
+}
+
+// Is any part of 'p' in front of the plane of 'plane'?
+static inline bool PartlyInFront(const FRejectPortal &p, const FRejectPortal &plane)
+{
+	return (p.v1 | plane.normal) - plane.dist < REJECT_EPSILON ||
+		(p.v2 | plane.normal) - plane.dist < REJECT_EPSILON;
+}
+
+static inline bool CanFlow(const FRejectPortal &prev, const FRejectPortal &next)
+{
+	return prev.line != next.line && PartlyBeyond(next, prev) && PartlyInFront(prev, next);
+}
+
+//==========================================================================
+//
+// FloodSector
+//
+// Marks everything that might be visible from sector 'source'. 'mark' is
+// a per-thread generation array with one entry per portal.
+//
+//==========================================================================
+
+static void FloodSector(FRejectFlow &flow, unsigned source, TArray<int> &mark, int &generation, TArray<int> &stack)
+{
+	uint8_t *row = &flow.Visible[source * flow.RowBytes];
+	row[source >> 3] |= 1 << (source & 7);
+
+	int budget = REJECT_SOURCE_BUDGET;
+	for (int first : flow.SectorPortals[source])
+	{
+		auto &fp = flow.Portals[first];
+		row[fp.to >> 3] |= 1 << (fp.to & 7);
+
+		generation++;
+		mark[first] = generation;
+		stack.Clear();
+		stack.Push(first);
+
+		while (stack.Size() > 0)
+		{
+			int cur;
+			stack.Pop(cur);
+			auto &cp = flow.Portals[cur];
+
+			for (int next : flow.SectorPortals[cp.to])
+			{
+				if (mark[next] == generation) continue;
+				if (--budget < 0)
+				{
+					// Too much work for a single source - give up and keep it fully visible.
+					memset(row, 0xff, flow.RowBytes);
+					return;
+				}
+				auto &np = flow.Portals[next];
+				if (!CanFlow(cp, np) || (cur != first && !CanFlow(fp, np))) continue;
+
+				mark[next] = generation;
+				row[np.to >> 3] |= 1 << (np.to & 7);
+				stack.Push(next);
+			}
+		}
+	}
+}
+
+//==========================================================================
+//
+// FindUntrustedSectors
+//
+// Sectors with self-referencing lines or open edges, and sectors without
+// any subsector. An edge is open if a vertex of the sector's boundary is
+// used by an odd number of its lines.
+//
+//==========================================================================
+
+static void FindUntrustedSectors(FLevelLocals *Level, TArray<bool> &untrusted)
+{
+	const unsigned numsectors = Level->sectors.Size();
+	untrusted.Resize(numsectors);
+	TArray<bool> hassubsector(numsectors, true);
+	for (unsigned i = 0; i < numsectors; i++)
+	{
+		untrusted[i] = false;
+		hassubsector[i] = false;
+	}
+	for (auto &sub : Level->subsectors)
+	{
+		if (sub.sector) hassubsector[sub.sector->Index()] = true;
+	}
+
+	// Vertex parity per sector, with the parity flipped for every line end.
+	TMap<uint64_t, bool> parity;
+	auto flip = [&](sector_t *sec, vertex_t *v)
+	{
+		uint64_t key = (uint64_t(sec->Index()) << 32) | uint32_t(v->Index());
+		bool *odd = parity.CheckKey(key);
+		if (odd) *odd = !*odd;
+		else parity.Insert(key, true);
+	};
+	for (auto &line : Level->lines)
+	{
+		if (line.frontsector != nullptr && line.frontsector == line.backsector)
+		{
+			untrusted[line.frontsector->Index()] = true;
+			continue;
+		}
+		for (sector_t *sec : { line.frontsector, line.backsector })
+		{
+			if (sec == nullptr) continue;
+			flip(sec, line.v1);
+			flip(sec, line.v2);
+		}
+	}
+	TMap<uint64_t, bool>::Iterator it(parity);
+	TMap<uint64_t, bool>::Pair *pair;
+	while (it.NextPair(pair))
+	{
+		if (pair->Value) untrusted[unsigned(pair->Key >> 32)] = true;
+	}
+
+	unsigned count = 0;
+	for (unsigned i = 0; i < numsectors; i++)
+	{
+		if (!hassubsector[i]) untrusted[i] = true;
+		if (untrusted[i]) count++;
+	}
+	if (count > 0)
+	{
+		DPrintf(DMSG_NOTIFY, "Reject: %u sectors are self-referencing or unclosed and see everything\n", count);
+	}
+}
+
+//==========================================================================
+//
+// Cache
+//
+//==========================================================================
+
+//==========================================================================
+//
+// The cache key. Everything the flow looks at goes in, so it is computed
+// from the final geometry rather than the map lump.
+//
+//==========================================================================
+
+static void RejectGeometryHash(FLevelLocals *Level, uint8_t digest[16])
+{
+	MD5Context md5;
+	md5.Update(Level->md5, 16);
+	for (auto &line : Level->lines)
+	{
+		int32_t data[7];
+		data[0] = FLOAT2FIXED(line.v1->fX());
+		data[1] = FLOAT2FIXED(line.v1->fY());
+		data[2] = FLOAT2FIXED(line.v2->fX());
+		data[3] = FLOAT2FIXED(line.v2->fY());
+		data[4] = line.frontsector ? line.frontsector->Index() : -1;
+		data[5] = line.backsector ? line.backsector->Index() : -1;
+		data[6] = line.sidedef[0] ? (line.sidedef[0]->Flags & WALLF_POLYOBJ) : -1;
+		md5.Update((const uint8_t *)data, sizeof(data));
+	}
+	for (auto &seg : Level->segs)
+	{
+		int32_t data[6];
+		data[0] = FLOAT2FIXED(seg.v1->fX());
+		data[1] = FLOAT2FIXED(seg.v1->fY());
+		data[2] = FLOAT2FIXED(seg.v2->fX());
+		data[3] = FLOAT2FIXED(seg.v2->fY());
+		data[4] = seg.Subsector ? seg.Subsector->sector->Index() : -1;
+		data[5] = seg.PartnerSeg ? seg.PartnerSeg->Index() : -1;
+		md5.Update((const uint8_t *)data, sizeof(data));
+	}
+	md5.Final(digest);
+}
+
+static FString RejectCacheName(const uint8_t *md5, bool create)
+{
+	FString path = M_GetCachePath(create);
+	path << "/reject";
+	if (create) CreatePath(path.GetChars());
+	path << '/';
+	for (int i = 0; i < 16; i++)
+	{
+		path.AppendFormat("%02x", md5[i]);
+	}
+	path << ".rej";
+	return path;
+}
+
+static bool ReadCachedReject(FLevelLocals *Level, const uint8_t *md5, unsigned size)
+{
+	FileReader fr;
+	if (!fr.OpenFile(RejectCacheName(md5, false).GetChars())) return false;
+
+	uint32_t header[5];
+	uint8_t filemd5[16];
+	if (fr.Read(header, sizeof(header)) != sizeof(header)) return false;
+	if (memcmp(header, "REJC", 4)) return false;
+	if (LittleLong(header[1]) != REJECT_CACHE_VERSION) return false;
+	if (LittleLong(header[2]) != Level->sectors.Size()) return false;
+	if (LittleLong(header[3]) != Level->lines.Size()) return false;
+	if (fr.Read(filemd5, 16) != 16 || memcmp(filemd5, md5, 16)) return false;
+
+	unsigned complen = LittleLong(header[4]);
+	TArray<uint8_t> compressed(complen, true);
+	if (fr.Read(compressed.Data(), complen) != complen) return false;
+
+	TArray<uint8_t> reject(size, true);
+	uLongf outlen = size;
+	if (uncompress(reject.Data(), &outlen, compressed.Data(), complen) != Z_OK || outlen != size) return false;
+
+	Level->rejectmatrix = std::move(reject);
+	return true;
+}
+
+static void WriteCachedReject(FLevelLocals *Level, const uint8_t *md5)
+{
+	uLongf outlen = compressBound(Level->rejectmatrix.Size());
+	TArray<uint8_t> compressed(outlen, true);
+	if (compress(compressed.Data(), &outlen, Level->rejectmatrix.Data(), Level->rejectmatrix.Size()) != Z_OK) return;
+
+	uint32_t header[5];
+	memcpy(header, "REJC", 4);
+	header[1] = LittleLong(REJECT_CACHE_VERSION);
+	header[2] = LittleLong(Level->sectors.Size());
+	header[3] = LittleLong(Level->lines.Size());
+	header[4] = LittleLong(uint32_t(outlen));
+
+	FString path = RejectCacheName(md5, true);
+	FileWriter *fw = FileWriter::Open(path.GetChars());
+	if (fw == nullptr)
+	{
+		Printf("Cannot open reject cache file %s for writing\n", path.GetChars());
+		return;
+	}
+	if (fw->Write(header, sizeof(header)) != sizeof(header) || fw->Write(md5, 16) != 16 ||
+		fw->Write(compressed.Data(), outlen) != outlen)
+	{
+		Printf("Error saving reject to file %s\n", path.GetChars());
+	}
+	delete fw;
+}
+
+//==========================================================================
+//
+// MapLoader :: BuildReject
+//
+// Must run after the nodes are built, the portals finalized and the polyobjects set up.
+//
+//==========================================================================
+
+void MapLoader::BuildReject(MapData *map)
+{
+	if (!sv_buildreject || !map->isText || Level->rejectmatrix.Size() > 0) return;
+
+	const unsigned numsectors = Level->sectors.Size();
+	if (numsectors < 2 || numsectors > REJECT_MAX_SECTORS) return;
+	if (Level->linePortals.Size() > 0) return;
+	for (auto &portal : Level->sectorPortals)
+	{
+		if (portal.mType == PORTS_LINKEDPORTAL) return;
+	}
+
+	const unsigned size = (numsectors * numsectors + 7) >> 3;
+	uint8_t geometryhash[16];
+	RejectGeometryHash(Level, geometryhash);
+	if (sv_cachereject && ReadCachedReject(Level, geometryhash, size)) return;
+
+	uint64_t starttime = I_msTime();
+
+	FRejectFlow flow;
+	flow.NumSectors = numsectors;
+	flow.RowBytes = (numsectors + 7) >> 3;
+	flow.SectorPortals.Resize(numsectors);
+
+	for (auto &seg : Level->segs)
+	{
+		if (seg.Subsector == nullptr) continue;
+		sector_t *from = seg.Subsector->sector;
+		sector_t *to;
+		int id;
+		if (seg.PartnerSeg != nullptr && seg.PartnerSeg->Subsector != nullptr)
+		{
+			to = seg.PartnerSeg->Subsector->sector;
+			// Both halves of a miniseg get the same id.
+			id = seg.linedef ? seg.linedef->Index() : Level->lines.Size() + min(seg.Index(), seg.PartnerSeg->Index());
+		}
+		else if (seg.linedef != nullptr && seg.backsector != nullptr)
+		{
+			// No partner on a two-sided line should not happen with GL nodes. Use the line's sectors then.
+			to = seg.backsector == from ? seg.frontsector : seg.backsector;
+			id = seg.linedef->Index();
+		}
+		else continue;
+
+		if (from == nullptr || to == nullptr || from == to) continue;
+		if (seg.sidedef != nullptr && (seg.sidedef->Flags & WALLF_POLYOBJ)) continue;
+
+		DVector2 v1 = seg.v1->fPos();
+		DVector2 v2 = seg.v2->fPos();
+		DVector2 delta = v2 - v1;
+		if (delta.isZero()) continue;
+
+		// The subsector is to the right of its segs, so the destination is to the left.
+		FRejectPortal p;
+		p.v1 = v1;
+		p.v2 = v2;
+		p.normal = DVector2(-delta.Y, delta.X).Unit();
+		p.dist = v1 | p.normal;
+		p.line = id;
+		p.from = from->Index();
+		p.to = to->Index();
+		flow.SectorPortals[p.from].Push(flow.Portals.Push(p));
+	}
+
+	flow.Visible.Resize(numsectors * flow.RowBytes);
+	memset(flow.Visible.Data(), 0, flow.Visible.Size());
+
+	TArray<bool> untrusted;
+	FindUntrustedSectors(Level, untrusted);
+
+	// Every source sector is independent and only writes its own row.
+	unsigned numthreads = clamp<unsigned>(std::thread::hardware_concurrency(), 1, 16);
+	auto worker = [&](unsigned start)
+	{
+		TRACE_SCOPE("BuildReject worker", TRACE_Loader);
+		TArray<int> mark(flow.Portals.Size(), true);
+		TArray<int> stack;
+		int generation = 0;
+		memset(mark.Data(), 0, mark.Size() * sizeof(int));
+		for (unsigned i = start; i < numsectors; i += numthreads)
+		{
+			if (untrusted[i])
+			{
+				memset(&flow.Visible[i * flow.RowBytes], 0xff, flow.RowBytes);
+			}
+			else
+			{
+				FloodSector(flow, i, mark, generation, stack);
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numthreads; i++)
+	{
+		threads.emplace_back(worker, i);
+	}
+	worker(0);
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	// Visibility is symmetric but the flow is not quite, so be conservative and
+	// only reject pairs that both directions agree on.
+	Level->rejectmatrix.Resize(size);
+	memset(Level->rejectmatrix.Data(), 0, size);
+	unsigned numrejected = 0;
+	for (unsigned i = 0; i < numsectors; i++)
+	{
+		const uint8_t *row = &flow.Visible[i * flow.RowBytes];
+		for (unsigned j = 0; j < numsectors; j++)
+		{
+			const uint8_t *col = &flow.Visible[j * flow.RowBytes];
+			if (!(row[j >> 3] & (1 << (j & 7))) && !(col[i >> 3] & (1 << (i & 7))))
+			{
+				unsigned pnum = i * numsectors + j;
+				Level->rejectmatrix[pnum >> 3] |= 1 << (pnum & 7);
+				numrejected++;
+			}
+		}
+	}
+
+	DPrintf(DMSG_NOTIFY, "Built reject for %u sectors, %u portals, %u threads in %d ms (%.1f%% rejected)\n",
+		numsectors, flow.Portals.Size(), numthreads, int(I_msTime() - starttime),
+		100. * numrejected / (double(numsectors) * numsectors));
+
+	if (numrejected == 0)
+	{
+		// Nothing to gain from consulting it.
+		Level->rejectmatrix.Reset();
+		return;
+	}
+	if (sv_cachereject)
+	{
+		WriteCachedReject(Level, geometryhash);
+	}
+}
+
+//==========================================================================
+//
+// CCMD clearrejectcache
+//
+//==========================================================================
+
+UNSAFE_CCMD(clearrejectcache)
+{
+	FileSys::FileList list;
+	FString path = M_GetCachePath(false);
+	path << "/reject/";
+
+	if (!DirExists(path.GetChars()))
+	{
+		return;
+	}
+	if (!FileSys::ScanDirectory(list, path.GetChars(), "*.rej", true))
+	{
+		Printf("Unable to scan reject cache directory %s\n", path.GetChars());
+		return;
+	}
+	for (auto &entry : list)
+	{
+		RemoveFile(entry.FilePath.c_str());
+	}
+}
@@ -24,6 +24,7 @@ class FSavegameManager : public FSavegameManagerBase
 	FString ExtractSaveComment(FSerializer &arc) override;
 	FString BuildSaveName(const char* prefix, int slot) override;
 	void ReadSaveStrings() override;
+	FSaveGameNode *CreateSaveNode(const FSaveIndexEntry &entry) override;
 };
 
 extern FSavegameManager savegameManager;
@@ -54,87 +54,74 @@
 //
 // M_ReadSaveStrings
 //
-// Find savegames and read their titles
+// Find savegames and read their titles. This only starts the scan, the
+// list fills up as the results come in.
 //
 //=============================================================================
 
 // @Cockatrice - TODO: Honor the savedir folder! We completely ignore it here
 void FSavegameManager::ReadSaveStrings()
 {
-	if (SaveGames.Size() == 0)
+	if (SaveGames.Size() == 0 && !SaveIndex.IsScanning())
 	{
-		FString filter;
 		TArray<FString> searchPaths;
 		G_BuildSaveNames("", searchPaths);
 
 		LastSaved = LastAccessed = -1;
 		quickSaveSlot = nullptr;
-		FileSys::FileList list;
-
-		for (int searchPathIndex = 0; searchPathIndex < (int)searchPaths.Size(); searchPathIndex++) {
-			if (FileSys::ScanDirectory(list, searchPaths[searchPathIndex].GetChars(), "*." SAVEGAME_EXT, true))
-			{
-				for (auto& entry : list)
-				{
-					std::unique_ptr<FResourceFile> savegame(FResourceFile::OpenResourceFile(entry.FilePath.c_str(), true));
-					if (savegame != nullptr)
-					{
-						bool oldVer = false;
-						bool missing = false;
-						auto info = savegame->FindEntry("info.json");
-						if (info < 0)
-						{
-							// savegame info not found. This is not a savegame so leave it alone.
-							continue;
-						}
-						auto data = savegame->Read(info);
-						FSerializer arc;
-						if (arc.OpenReader(data.string(), data.size()))
-						{
-							int savever = 0;
-							arc("Save Version", savever);
-							FString engine = arc.GetString("Engine");
-							FString iwad = arc.GetString("Game WAD");
-							FString title = arc.GetString("Title");
-
-							int date = 0;
-							arc("Save Date", date);
-
-							if (engine.Compare(GAMESIG) != 0 || savever > SAVEVER)
-							{
-								// different engine or newer version:
-								// not our business. Leave it alone.
-								continue;
-							}
-
-							if (savever < MINSAVEVER)
-							{
-								// old, incompatible savegame. List as not usable.
-								oldVer = true;
-							}
-							else if (iwad.CompareNoCase(fileSystem.GetResourceFileName(fileSystem.GetIwadNum())) == 0)
-							{
-								missing = !G_CheckSaveGameWads(arc, false);
-							}
-							else
-							{
-								// different game. Skip this.
-								continue;
-							}
-
-							FSaveGameNode* node = new FSaveGameNode;
-							node->Filename = entry.FilePath.c_str();
-							node->bOldVersion = oldVer;
-							node->bMissingWads = missing;
-							node->SaveTitle = title;
-							node->saveDate = date;
-							InsertSaveNode(node);
-						}
-					}
-				}
-			}
-		}
+		SaveIndex.StartScan(searchPaths, (G_GetSavegamesFolder() + "saveindex.json").GetChars());
 	}
+	UpdateSaveStrings();
+}
+
+//=============================================================================
+//
+// CreateSaveNode
+//
+// Decides whether a savegame found by the scanner belongs in the list.
+//
+//=============================================================================
+
+FSaveGameNode *FSavegameManager::CreateSaveNode(const FSaveIndexEntry &entry)
+{
+	if (!entry.bIsSavegame)
+	{
+		// savegame info not found. This is not a savegame so leave it alone.
+		return nullptr;
+	}
+
+	bool oldVer = false;
+	bool missing = false;
+
+	if (entry.Engine.compare(GAMESIG) != 0 || entry.SaveVersion > SAVEVER)
+	{
+		// different engine or newer version:
+		// not our business. Leave it alone.
+		return nullptr;
+	}
+
+	if (entry.SaveVersion < MINSAVEVER)
+	{
+		// old, incompatible savegame. List as not usable.
+		oldVer = true;
+	}
+	else if (stricmp(entry.GameWad.c_str(), fileSystem.GetResourceFileName(fileSystem.GetIwadNum())) == 0)
+	{
+		missing = !G_CheckSaveGameWads(entry.GameWad.c_str(), entry.MapWad.empty() ? nullptr : entry.MapWad.c_str(), false);
+	}
+	else
+	{
+		// different game. Skip this.
+		return nullptr;
+	}
+
+	FSaveGameNode* node = new FSaveGameNode;
+	node->Filename = entry.Filename.c_str();
+	node->bOldVersion = oldVer;
+	node->bMissingWads = missing;
+	node->SaveTitle = entry.Title.c_str();
+	node->saveDate = entry.SaveDate;
+	return node;
 }
 
 
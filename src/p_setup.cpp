@@ -329,6 +329,12 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	
 	interpolator.ClearInterpolations();	// [RH] Nothing to interpolate on a fresh level.
 	Thinkers.DestroyAllThinkers(fullgc);
+
+	// Only travelling actors can still be in here.
+	for (auto ac : DirtyLightActors) if (ac) ac->DirtyLightSlot = 0;
+	for (auto ac : EffectActors) if (ac) ac->EffectSlot = 0;
+	DirtyLightActors.Clear();
+	EffectActors.Clear();
 	ClearAllSubsectorLinks(); // can't be done as part of the polyobj deletion process.
 
 	P_DestroyAllParticleDefinitions(this);
@@ -389,6 +395,7 @@ void FLevelLocals::ClearLevelData(bool fullgc)
 	rejectmatrix.Clear();
 	Zones.Clear();
 	blockmap.Clear();
+	actorgrid.Clear();
 	Polyobjects.Clear();
 
 	for (auto &pb : PolyBlockMap)
@@ -432,6 +439,7 @@ void P_FreeLevelData (bool fullgc)
 	{
 		Level->ClearLevelData(fullgc);
 	}
+	P_ReleaseLinkNodes();
 	// primaryLevel->FreeSecondaryLevels();
 }
 
@@ -38,11 +38,15 @@
 #include "events.h"
 #include "actorinlines.h"
 #include "g_game.h"
+#include "tracecapture.h"
 #include "i_interface.h"
+#include "stats.h"
 
 extern gamestate_t wipegamestate;
 extern uint8_t globalfreeze, globalchangefreeze;
 
+cycle_t DefinedParticleCycles;
+
 //==========================================================================
 //
 // P_CheckTickerPaused
@@ -78,6 +82,7 @@ bool P_CheckTickerPaused ()
 void P_Ticker (void)
 {
 	int i;
+	TRACE_SCOPE("P_Ticker", TRACE_Playsim);
 
 	for (auto Level : AllLevels())
 	{
@@ -98,17 +103,7 @@ void P_Ticker (void)
 		// This must run even when the game is paused to catch changes from netevents before the frame is rendered.
 		for (auto Level : AllLevels())
 		{
-			auto it = Level->GetThinkerIterator<AActor>();
-			AActor* ac;
-
-			while ((ac = it.Next()))
-			{
-				if (ac->flags8 & MF8_RECREATELIGHTS)
-				{
-					ac->flags8 &= ~MF8_RECREATELIGHTS;
-					ac->SetDynamicLights();
-				}
-			}
+			Level->RecreateDirtyLights(true);
 		}
 		return;
 	}
@@ -144,6 +139,7 @@ void P_Ticker (void)
 
 	P_ResetSightCounters (false);
 	R_ClearInterpolationPath();
+	DefinedParticleCycles.Reset();
 
 	// Since things will be moving, it's okay to interpolate them in the renderer.
 	r_NoInterpolate = false;
@@ -170,9 +166,17 @@ void P_Ticker (void)
 		// [ZZ] call the WorldTick hook
 		Level->localEventManager->WorldTick();
 		Level->Tick();			// [RH] let the level tick
-		Level->Thinkers.RunThinkers(Level);
+		{
+			TRACE_SCOPE("RunThinkers", TRACE_Playsim);
+			Level->Thinkers.RunThinkers(Level);
+		}
 
-		P_ThinkDefinedParticles(Level); // Run after the world tick so we get proper moving sector heights
+		DefinedParticleCycles.Clock();
+		{
+			TRACE_SCOPE("P_ThinkDefinedParticles", TRACE_Playsim);
+			P_ThinkDefinedParticles(Level); // Run after the world tick so we get proper moving sector heights
+		}
+		DefinedParticleCycles.Unclock();
 
 		//if added by MC: Freeze mode.
 		if (!Level->isFrozen())
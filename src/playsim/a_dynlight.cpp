@@ -64,10 +64,12 @@
 #include "a_dynlight.h"
 #include "actorinlines.h"
 #include "memarena.h"
+#include "stats.h"
 
 static FMemArena DynLightArena(sizeof(FDynamicLight) * 200);
 static TArray<FDynamicLight*> FreeList;
 static FRandom randLight;
+static int LightsTicked, LightsSkipped;
 
 extern TArray<FLightDefaults *> StateLights;
 
@@ -242,6 +244,7 @@ void FDynamicLight::Activate()
 	m_active = true;
 	m_currentRadius = float(GetIntensity());
 	m_tickCount = 0;
+	tickedStatic = false;
 
 	if (lighttype == PulseLight)
 	{
@@ -290,6 +293,14 @@ void FDynamicLight::Tick()
 	// Don't bother if the light won't be shown
 	if (!IsActive()) return;
 
+	// Nothing to do for a resting point light whose owner did not change.
+	if (tickedStatic && IsUnchanged())
+	{
+		LightsSkipped++;
+		return;
+	}
+	LightsTicked++;
+
 	// I am doing this with a type field so that I can dynamically alter the type of light
 	// without having to create or maintain multiple objects.
 	switch(lighttype)
@@ -374,6 +385,46 @@ void FDynamicLight::Tick()
 	}
 	if (m_currentRadius <= 0) m_currentRadius = 1;
 	UpdateLocation();
+	RecordTickState();
+}
+
+//==========================================================================
+//
+// FDynamicLight :: RecordTickState
+//
+// Point lights that did not move during this tic remember everything
+// UpdateLocation depends on so the following tics can be skipped.
+// Lights with animated radius, bobbing owners and the player's own
+// flashlights are always updated.
+//
+//==========================================================================
+
+void FDynamicLight::RecordTickState()
+{
+	AActor *target = this->target;
+	tickedStatic = lighttype == PointLight && IsActive() && Pos == LastPos &&
+		!(target->flags2 & MF2_FLOATBOB) &&
+		!(target->master && target->master->player == &players[consoleplayer]);
+
+	if (tickedStatic)
+	{
+		lastTargetPos = target->Pos();
+		lastOffset = m_off;
+		lastFloorZ = target->floorz;
+		lastCeilingZ = target->ceilingz;
+		lastIntensity = GetIntensity();
+	}
+}
+
+bool FDynamicLight::IsUnchanged()
+{
+	AActor *target = this->target;
+	return target->Pos() == lastTargetPos && m_off == lastOffset &&
+		GetIntensity() == lastIntensity &&
+		target->floorz == lastFloorZ && target->ceilingz == lastCeilingZ &&
+		target->Angles.Yaw == LastAngle && (pPitch != nullptr ? *pPitch : target->Angles.Pitch) == LastPitch &&
+		!(target->flags2 & MF2_FLOATBOB) &&
+		!(target->master && target->master->player == &players[consoleplayer]);
 }
 
 
@@ -916,6 +967,32 @@ void FDynamicLight::UnlinkLight ()
 	shadowmapped = false;
 }
 
+//==========================================================================
+//
+// FLevelLocals :: RecreateDirtyLights
+//
+// Processes all actors that got MF8_RECREATELIGHTS set since the last call.
+//
+//==========================================================================
+
+void FLevelLocals::RecreateDirtyLights(bool setlights)
+{
+	// SetDynamicLights may queue more actors, so the size must be checked each time.
+	for (unsigned i = 0; i < DirtyLightActors.Size(); i++)
+	{
+		AActor *ac = DirtyLightActors[i];
+		if (ac == nullptr) continue;	// destroyed after being queued
+
+		ac->DirtyLightSlot = 0;
+		if (ac->flags8 & MF8_RECREATELIGHTS)
+		{
+			ac->flags8 &= ~MF8_RECREATELIGHTS;
+			if (setlights) ac->SetDynamicLights();
+		}
+	}
+	DirtyLightActors.Clear();
+}
+
 //==========================================================================
 //
 //
@@ -938,6 +1015,7 @@ void AActor::AttachLight(unsigned int count, const FLightDefaults *lightdef)
 		AttachedLights.Push(light);
 	}
 	lightdef->ApplyProperties(light);
+	light->tickedStatic = false;
 	light->UpdateLocation();
 }
 
@@ -1039,8 +1117,7 @@ int AttachLightDef(AActor *self, int _lightid, int _lightname)
 	{
 		auto userlight = self->UserLights[FindUserLight(self, lightid, true)];
 		userlight->CopyFrom(*LightDefaults[lightdef]);
-		self->flags8 |= MF8_RECREATELIGHTS;
-		self->Level->flags3 |= LEVEL3_LIGHTCREATED;
+		self->MarkLightsDirty();
 		return 1;
 	}
 	return 0;
@@ -1088,8 +1165,7 @@ int AttachLightEx(AActor* self, int _lightid, int color, double colorIntensity,
 		userlight->UnsetSpotPitch();
 	}
 
-	self->flags8 |= MF8_RECREATELIGHTS;
-	self->Level->flags3 |= LEVEL3_LIGHTCREATED;
+	self->MarkLightsDirty();
 	return 1;
 }
 
@@ -1117,8 +1193,7 @@ int AttachLightDirect(AActor *self, int _lightid, int type, int color, int radiu
 	{
 		userlight->UnsetSpotPitch();
 	}
-	self->flags8 |= MF8_RECREATELIGHTS;
-	self->Level->flags3 |= LEVEL3_LIGHTCREATED;
+	self->MarkLightsDirty();
 	return 1;
 }
 
@@ -1174,8 +1249,7 @@ int RemoveLight(AActor *self, int _lightid)
 	{
 		delete self->UserLights[userlight];
 		self->UserLights.Delete(userlight);
-		self->flags8 |= MF8_RECREATELIGHTS;
-		self->Level->flags3 |= LEVEL3_LIGHTCREATED;
+		self->MarkLightsDirty();
 		return 1;
 	}
 	return 0;
@@ -1239,3 +1313,18 @@ void FLevelLocals::RecreateAllAttachedLights()
 		}
 	}
 }
+
+//==========================================================================
+//
+// STAT lightticks
+//
+//==========================================================================
+
+ADD_STAT(lightticks)
+{
+	FString out;
+	out.Format("Dynamic lights: %d ticked, %d skipped\n%u actors queued for light recreation, %u actors with effects",
+		LightsTicked, LightsSkipped, primaryLevel->DirtyLightActors.Size(), primaryLevel->EffectActors.Size());
+	LightsTicked = LightsSkipped = 0;
+	return out;
+}
@@ -255,6 +255,8 @@ struct FDynamicLight
 
 	void Tick();
 	void UpdateLocation();
+	bool IsUnchanged();
+	void RecordTickState();
 	void LinkLight();
 	void UnlinkLight();
 	void ReleaseLight();
@@ -293,6 +295,13 @@ public:
 	int m_tickCount;
 	int m_lastUpdate;
 	int mShadowmapIndex;
+
+	// What the last full Tick of a resting point light depended on.
+	DVector3 lastTargetPos;
+	DVector3 lastOffset;
+	double lastFloorZ, lastCeilingZ;
+	int lastIntensity;
+	bool tickedStatic;
 	bool m_active;
 	bool visibletoplayer;
 	bool shadowmapped;
@@ -819,6 +819,9 @@ public:
 	virtual void PostSerialize() override;
 	virtual void PostBeginPlay() override;		// Called immediately before the actor's first tick
 	virtual void Tick() override;
+	virtual void Wake() override;
+	virtual void Sleep(int tics = 10) override;
+	virtual void SleepIndefinite() override;
 	void EnableNetworking(const bool enable) override;
 
 	static AActor *StaticSpawn (FLevelLocals *Level, PClassActor *type, const DVector3 &pos, replace_t allowreplacement, bool SpawningMapThing = false);
@@ -1125,6 +1128,9 @@ public:
 
 	void AttachLight(unsigned int count, const FLightDefaults *lightdef);
 	void SetDynamicLights();
+	void MarkLightsDirty();
+	void CheckEffectList();
+	bool SkipLODTick();
 
 // info for drawing
 // NOTE: The first member variable *must* be snext.
@@ -1191,6 +1197,10 @@ public:
 
 // interaction info
 	FBlockNode		*BlockNode;			// links in blocks (if needed)
+	int				GridCell;			// 1-based cell in Level->actorgrid, 0 if not linked there
+	int				GridSlot;			// index into that cell's arrays
+	int				DirtyLightSlot;		// 1-based index in Level->DirtyLightActors, 0 if not queued
+	int				EffectSlot;			// 1-based index in Level->EffectActors, 0 if not listed
 	struct sector_t	*Sector;
 	subsector_t *		subsector;
 	FSection *			section;
@@ -1394,6 +1404,11 @@ public:
 	int SpawnTime;
 	uint32_t SpawnOrder;
 
+	// Tick throttling for far away actors, see p_ticklod.cpp
+	int TickLOD;		// largest tick interval the class allows, 0 or 1 to always tick
+	int TickLODDebt;	// tics skipped since the last real tick
+	int TickLODSeen;	// last maptime at which a player could possibly see the actor
+
 	int UnmorphTime;
 	int MorphFlags;
 	int PremorphProperties;
@@ -34,6 +34,7 @@
 
 #include "dthinker.h"
 #include "stats.h"
+#include "tracecapture.h"
 #include "p_local.h"
 #include "serializer_doom.h"
 #include "d_player.h"
@@ -46,8 +47,8 @@
 #include "g_cvars.h"
 #include "d_main.h"
 
-static int ThinkCount;
-static cycle_t ThinkCycles;
+int ThinkCount;
+cycle_t ThinkCycles;
 extern cycle_t BotSupportCycles;
 extern cycle_t ActionCycles;
 extern int BotWTG;
@@ -89,12 +90,17 @@ void FThinkerCollection::Link(DThinker *thinker, int statnum)
 	}
 
 	list->AddTail(thinker);
+	if (statnum == STAT_SLEEP)
+	{
+		ScheduleSleeper(thinker, thinker->sleepTimer);
+	}
 }
 
 // Insert the sleeper at the head of the list
 void FThinkerCollection::LinkSleeper(DThinker* thinker, int statnum)
 {
 	Thinkers[statnum].AddHead(thinker);
+	ScheduleSleeper(thinker, thinker->sleepTimer);
 	//if (statnum != STAT_TRAVELLING) thinker->ObjectFlags &= ~OF_JustSpawned;
 }
 
@@ -118,8 +124,7 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 	// Handle sleeping thinkers, allow them to slip back into the regular pool when unnecessary
 	inSleepCycle = true;
-	Thinkers[STAT_SLEEP].CheckSleepingThinkers(1);
-	FreshThinkers[STAT_SLEEP].CheckSleepingThinkers(1);
+	CheckSleepingThinkers();
 
 	// Wake the waiting dreamers
 	for (auto dreamer : tempWakers) {
@@ -143,22 +148,10 @@ void FThinkerCollection::RunThinkers(FLevelLocals *Level)
 
 
 	auto recreateLights = [=]() {
-		auto it = Level->GetThinkerIterator<AActor>();
-
 		// Set dynamic lights at the end of the tick, so that this catches all changes being made through the last frame.
-		while (auto ac = it.Next())
-		{
-			if (ac->flags8 & MF8_RECREATELIGHTS)
-			{
-				ac->flags8 &= ~MF8_RECREATELIGHTS;
-				if (dolights) ac->SetDynamicLights();
-			}
-			// This was merged from P_RunEffects to eliminate the costly duplicate ThinkerIterator loop.
-			if ((ac->effects || ac->fountaincolor) && ac->ShouldRenderLocally() && !Level->isFrozen())
-			{
-				P_RunEffect(ac, ac->effects);
-			}
-		}
+		// Only actors that queued themselves need to be looked at.
+		Level->RecreateDirtyLights(dolights);
+		Level->RunActorEffects();
 	};
 
 
@@ -312,6 +305,7 @@ void FThinkerCollection::DestroyAllThinkers(bool fullgc)
 		}
 	}
 	error |= Thinkers[MAX_STATNUM + 1].DoDestroyThinkers();
+	ClearSleepers();
 	if (fullgc) GC::FullGC();
 	if (error)
 	{
@@ -387,6 +381,11 @@ void FThinkerCollection::SerializeThinkers(FSerializer &arc, bool hubLoad)
 									Thinkers[i].AddTail(thinker);
 									thinker->PostSerialize();
 								}
+								if (i == STAT_SLEEP && !(thinker->ObjectFlags & OF_EuthanizeMe))
+								{
+									// The remaining sleep time was saved in sleepTimer.
+									ScheduleSleeper(thinker, thinker->sleepTimer);
+								}
 							}
 						}
 					}
@@ -729,36 +728,189 @@ void FThinkerList::SaveList(FSerializer &arc)
 }
 
 
-int FThinkerList::CheckSleepingThinkers(int ticsElapsed) {
-	int count = 0;
-	DThinker *node = GetHead();
-	DThinker *nextNode = nullptr;
+//==========================================================================
+//
+// FThinkerCollection :: ScheduleSleeper
+//
+// Puts a STAT_SLEEP thinker on the timing wheel to be checked in 'tics'.
+//
+//==========================================================================
 
-	if (node == nullptr) {
-		//sleepCount = 0;
-		return 0;
+void FThinkerCollection::ScheduleSleeper(DThinker *thinker, int tics)
+{
+	UnscheduleSleeper(thinker);
+	thinker->sleepWakeTic = sleepTic + max(tics, 1);
+	PlaceSleeper(thinker);
+}
+
+void FThinkerCollection::PlaceSleeper(DThinker *thinker)
+{
+	int delta = thinker->sleepWakeTic - sleepTic;
+	int bucket;
+	if (delta < SLEEP_WHEEL0)
+	{
+		bucket = thinker->sleepWakeTic & (SLEEP_WHEEL0 - 1);
+	}
+	else if (delta < SLEEP_WHEEL0 * SLEEP_WHEEL1)
+	{
+		bucket = SLEEP_WHEEL0 + ((thinker->sleepWakeTic / SLEEP_WHEEL0) & (SLEEP_WHEEL1 - 1));
+	}
+	else
+	{
+		bucket = SLEEP_OVERFLOW;
 	}
+	thinker->sleepBucket = bucket;
+	thinker->sleepSlot = sleepBuckets[bucket].Push(thinker);
+	numSleepers++;
+}
 
-	while (node != Sentinel)
+//==========================================================================
+//
+// FThinkerCollection :: UnscheduleSleeper
+//
+//==========================================================================
+
+void FThinkerCollection::UnscheduleSleeper(DThinker *thinker)
+{
+	int bucket = thinker->sleepBucket;
+	if (bucket == SLEEP_UNSCHEDULED)
 	{
-		nextNode = node->NextThinker;
-
-		if (!(node->ObjectFlags & OF_EuthanizeMe))
-		{ // Only check thinkers not scheduled for destruction
-			node->sleepTimer -= ticsElapsed;
-			if (node->sleepTimer  <= 0) {
-				if (node->sleepInterval <= 0 || node->CallShouldWake()) {
-					++count;
-					node->CallWake();
-				}
-			}
+		return;
+	}
+	thinker->sleepBucket = SLEEP_UNSCHEDULED;
+
+	if (bucket == SLEEP_DUE)
+	{
+		// Currently being checked, just make sure it gets skipped.
+		dueSleepers[thinker->sleepSlot] = nullptr;
+		return;
+	}
+
+	auto &list = sleepBuckets[bucket];
+	unsigned slot = thinker->sleepSlot;
+	unsigned last = list.Size() - 1;
+	assert(slot <= last && list[slot] == thinker);
+	if (slot != last)
+	{
+		list[slot] = list[last];
+		list[slot]->sleepSlot = slot;
+	}
+	list.Pop();
+	numSleepers--;
+}
+
+//==========================================================================
+//
+// FThinkerCollection :: SleepTimeLeft
+//
+//==========================================================================
+
+int FThinkerCollection::SleepTimeLeft(const DThinker *thinker) const
+{
+	if (thinker->sleepBucket == SLEEP_UNSCHEDULED)
+	{
+		return thinker->sleepTimer;
+	}
+	return max(thinker->sleepWakeTic - sleepTic, 0);
+}
+
+//==========================================================================
+//
+// FThinkerCollection :: CascadeSleepers
+//
+// Moves the content of a coarse bucket to where it belongs now.
+//
+//==========================================================================
+
+void FThinkerCollection::CascadeSleepers(TArray<DThinker*> &bucket)
+{
+	TArray<DThinker*> list;
+	list.Swap(bucket);
+	numSleepers -= list.Size();
+	for (auto thinker : list)
+	{
+		PlaceSleeper(thinker);
+	}
+}
+
+//==========================================================================
+//
+// FThinkerCollection :: ClearSleepers
+//
+//==========================================================================
+
+void FThinkerCollection::ClearSleepers()
+{
+	for (auto &bucket : sleepBuckets)
+	{
+		for (auto thinker : bucket)
+		{
+			thinker->sleepBucket = SLEEP_UNSCHEDULED;
 		}
+		bucket.Clear();
+	}
+	numSleepers = 0;
+}
+
+//==========================================================================
+//
+// FThinkerCollection :: CheckSleepingThinkers
+//
+// Advances the timing wheel by one tic and checks all sleepers that are
+// due. Those that do not want to wake up yet are checked again on every
+// following tic until they do, like the old countdown did.
+//
+//==========================================================================
 
-		node = nextNode;
+int FThinkerCollection::CheckSleepingThinkers()
+{
+	int count = 0;
+
+	sleepTic++;
+	if ((sleepTic & (SLEEP_WHEEL0 * SLEEP_WHEEL1 - 1)) == 0)
+	{
+		CascadeSleepers(sleepBuckets[SLEEP_OVERFLOW]);
+	}
+	if ((sleepTic & (SLEEP_WHEEL0 - 1)) == 0)
+	{
+		CascadeSleepers(sleepBuckets[SLEEP_WHEEL0 + ((sleepTic / SLEEP_WHEEL0) & (SLEEP_WHEEL1 - 1))]);
+	}
+
+	dueSleepers.Swap(sleepBuckets[sleepTic & (SLEEP_WHEEL0 - 1)]);
+	numSleepers -= dueSleepers.Size();
+	numSleepersChecked = 0;
+	for (unsigned i = 0; i < dueSleepers.Size(); i++)
+	{
+		dueSleepers[i]->sleepBucket = SLEEP_DUE;
+		dueSleepers[i]->sleepSlot = i;
 	}
 
-	// TODO: Might have to perform some maintenance on sleepCount to prevent it from getting too big
+	for (unsigned i = 0; i < dueSleepers.Size(); i++)
+	{
+		DThinker *node = dueSleepers[i];
+		if (node == nullptr) continue;	// woken or destroyed by an earlier sleeper
 
+		node->sleepBucket = SLEEP_UNSCHEDULED;
+		if (node->ObjectFlags & OF_EuthanizeMe) continue;
+		if (node->sleepWakeTic != sleepTic)
+		{
+			PlaceSleeper(node);
+			continue;
+		}
+
+		numSleepersChecked++;
+		if (node->sleepInterval <= 0 || node->CallShouldWake())
+		{
+			++count;
+			node->CallWake();
+		}
+		else if (node->sleepBucket == SLEEP_UNSCHEDULED && !(node->ObjectFlags & OF_EuthanizeMe))
+		{
+			// Not rescheduled by ShouldWake itself. Its time is up, so keep asking every tic.
+			ScheduleSleeper(node, 1);
+		}
+	}
+	dueSleepers.Clear();
 	return count;
 }
 
@@ -798,9 +950,13 @@ int FThinkerList::TickThinkers(FThinkerList *dest)
 			I_Error("There is a thinker in the fresh list that has already ticked.\n");
 		}
 
-		if (!(node->ObjectFlags & OF_EuthanizeMe))
+		if (node->tickThrottled && static_cast<AActor *>(node)->SkipLODTick())
+		{ // Far away actor that is only ticked every few tics
+		}
+		else if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
 			ThinkCount++;
+			TRACE_SCOPE(node->GetClass()->TypeName.GetChars(), TRACE_Thinker);
 			node->CallTick();
 			node->ObjectFlags &= ~OF_JustSpawned;
 		}
@@ -844,7 +1000,10 @@ int FThinkerList::ProfileThinkers(FThinkerList *dest)
 			I_Error("There is a thinker in the fresh list that has already ticked.\n");
 		}
 
-		if (!(node->ObjectFlags & OF_EuthanizeMe))
+		if (node->tickThrottled && static_cast<AActor *>(node)->SkipLODTick())
+		{ // Far away actor that is only ticked every few tics
+		}
+		else if (!(node->ObjectFlags & OF_EuthanizeMe))
 		{ // Only tick thinkers not scheduled for destruction
 			ThinkCount++;
 
@@ -876,6 +1035,10 @@ void DThinker::OnDestroy ()
 {
 	assert((NextThinker != nullptr && PrevThinker != nullptr) ||
 		   (NextThinker == nullptr && PrevThinker == nullptr));
+	if (sleepBucket != -1)
+	{
+		Level->Thinkers.UnscheduleSleeper(this);
+	}
 	if (NextThinker != nullptr)
 	{
 		Remove();
@@ -887,6 +1050,10 @@ void DThinker::Serialize(FSerializer &arc)
 {
 	Super::Serialize(arc);
 	arc("level", Level);
+	if (arc.isWriting() && sleepBucket != -1)
+	{
+		sleepTimer = Level->Thinkers.SleepTimeLeft(this);
+	}
 	arc("sleepInterval", sleepInterval);
 	arc("sleepTimer", sleepTimer);
 }
@@ -899,6 +1066,10 @@ void DThinker::Serialize(FSerializer &arc)
 
 void DThinker::Remove()
 {
+	if (sleepBucket != -1)
+	{
+		Level->Thinkers.UnscheduleSleeper(this);
+	}
 	if (this == NextToThink)
 	{
 		NextToThink = NextThinker;
@@ -1100,6 +1271,11 @@ void DThinker::ChangeStatNum (int statnum)
 		statnum = MAX_STATNUM;
 	}
 	Remove();
+	if (statnum == STAT_SLEEP)
+	{
+		// sleepTimer is only refreshed for serialization and may be left over from an earlier sleep.
+		sleepTimer = sleepInterval;
+	}
 	Level->Thinkers.Link(this, statnum);
 }
 
@@ -1351,6 +1527,7 @@ DThinker *FThinkerIterator::Next (bool exact)
 ADD_STAT (think)
 {
 	FString out;
-	out.Format ("Think time = %04.2f ms - %d thinkers, Action = %04.2f ms", ThinkCycles.TimeMS(), ThinkCount, ActionCycles.TimeMS());
+	out.Format ("Think time = %04.2f ms - %d thinkers, Action = %04.2f ms, %d sleepers (%d checked)", ThinkCycles.TimeMS(), ThinkCount, ActionCycles.TimeMS(),
+		primaryLevel->Thinkers.NumScheduledSleepers(), primaryLevel->Thinkers.NumCheckedSleepers());
 	return out;
 }
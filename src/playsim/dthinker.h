@@ -67,7 +67,6 @@ struct FThinkerList
 	bool IsEmpty() const;
 	void DestroyThinkers();
 	bool DoDestroyThinkers();
-	int CheckSleepingThinkers(int ticsElapsed = 1);			// Check and unsleep thinkers periodically
 	int TickThinkers(FThinkerList *dest);					// Returns: # of thinkers ticked
 	int ProfileThinkers(FThinkerList *dest);
 	void SaveList(FSerializer &arc);
@@ -97,13 +96,44 @@ struct FThinkerCollection
 	bool IsSleepCycle() const { return inSleepCycle; }
 	void AddWaker(DThinker* einstein) { tempWakers.Push(einstein); }
 
+	void ScheduleSleeper(DThinker *thinker, int tics);
+	void UnscheduleSleeper(DThinker *thinker);
+	int SleepTimeLeft(const DThinker *thinker) const;
+	int NumScheduledSleepers() const { return numSleepers; }
+	int NumCheckedSleepers() const { return numSleepersChecked; }
+
 private:
+	int CheckSleepingThinkers();
+	void ClearSleepers();
+	void PlaceSleeper(DThinker *thinker);
+	void CascadeSleepers(TArray<DThinker*> &bucket);
+
 	FThinkerList Thinkers[MAX_STATNUM + 2];
 	FThinkerList FreshThinkers[MAX_STATNUM + 1];
 
 	bool inSleepCycle = false;							// Set when running through sleepers.  If in sleep cycle, we put new sleeping thinkers into FreshThinkers and new wakes into the wake list
 	TArray<DThinker*> tempWakers;
 
+	// Two level timing wheel for STAT_SLEEP, keyed on the tic a sleeper is due.
+	// The first level has one bucket per tic, the second one per 256 tics and
+	// anything further out waits in the overflow bucket. Each tic only looks at
+	// the sleepers that are actually due.
+	enum
+	{
+		SLEEP_WHEEL0 = 256,
+		SLEEP_WHEEL1 = 64,
+		SLEEP_OVERFLOW = SLEEP_WHEEL0 + SLEEP_WHEEL1,
+		SLEEP_BUCKETS,
+
+		SLEEP_UNSCHEDULED = -1,
+		SLEEP_DUE = -2,
+	};
+	TArray<DThinker*> sleepBuckets[SLEEP_BUCKETS];
+	TArray<DThinker*> dueSleepers;
+	int sleepTic = 0;
+	int numSleepers = 0;
+	int numSleepersChecked = 0;
+
 	friend class FThinkerIterator;
 };
 
@@ -146,10 +176,14 @@ private:
 
 	// Sleep info
 	int sleepInterval = 0;	// How many tics to sleep before checking for wake
-	int sleepTimer = 0;		// Timer data
+	int sleepTimer = 0;		// Remaining tics, only kept up to date for serialization
+	int sleepWakeTic = 0;	// Tic at which the timing wheel checks this thinker
+	int sleepBucket = -1;	// Timing wheel bucket, -1 if not scheduled
+	int sleepSlot = 0;		// Index in that bucket
 
 public:
 	FLevelLocals *Level;
+	bool tickThrottled = false;	// Actor that opted into tick throttling, see p_ticklod.cpp
 
 	friend struct FLevelLocals;	// Needs access to FreshThinkers until the thinker storage gets refactored.
 };
@@ -0,0 +1,184 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//		Fine-grained actor index kept next to the blockmap.
+//
+//		The blockmap's 128 unit blocks get crowded in arenas full of small
+//		debris and enemies, and every multi-block actor has to be deduplicated
+//		through FBlockThingsIterator's hash. This grid stores each actor once
+//		and keeps the data needed for the box rejection in flat arrays.
+//
+//-----------------------------------------------------------------------------
+
+#include "g_levellocals.h"
+#include "p_blockmap.h"
+#include "actor.h"
+#include "c_cvars.h"
+#include "stats.h"
+
+// Changing either of these takes effect on the next level load.
+CVAR(Bool, sv_actorgrid, false, CVAR_ARCHIVE | CVAR_SERVERINFO)
+CUSTOM_CVAR(Int, sv_actorgridcellsize, 32, CVAR_ARCHIVE | CVAR_SERVERINFO)
+{
+	if (self < 16) self = 16;
+	else if (self > FBlockmap::MAPBLOCKUNITS) self = FBlockmap::MAPBLOCKUNITS;
+}
+
+//==========================================================================
+//
+// FActorGrid :: Init
+//
+//==========================================================================
+
+void FActorGrid::Init(double orgx, double orgy, double width, double height, int cellsize)
+{
+	Clear();
+	CellSize = cellsize;
+	OrgX = orgx;
+	OrgY = orgy;
+	Width = max(1, int(ceil(width / cellsize)));
+	Height = max(1, int(ceil(height / cellsize)));
+	Cells.Resize(Width * Height + 1);
+}
+
+//==========================================================================
+//
+// FActorGrid :: Clear
+//
+//==========================================================================
+
+void FActorGrid::Clear()
+{
+	Cells.Reset();
+	CellSize = Width = Height = 0;
+	NumLinked = 0;
+	NumQueries = NumTested = NumReturned = 0;
+}
+
+//==========================================================================
+//
+// FActorGrid :: Link
+//
+//==========================================================================
+
+void FActorGrid::Link(AActor *actor)
+{
+	assert(actor->GridCell == 0);
+
+	unsigned index = Cells.Size() - 1;
+	if (actor->radius <= CellSize)
+	{
+		int x = int((actor->X() - OrgX) / CellSize);
+		int y = int((actor->Y() - OrgY) / CellSize);
+		if (actor->X() >= OrgX && actor->Y() >= OrgY && x < Width && y < Height)
+		{
+			index = y * Width + x;
+		}
+	}
+
+	Cell &cell = Cells[index];
+	actor->GridCell = index + 1;
+	actor->GridSlot = cell.Actors.Push(actor);
+	cell.X.Push((float)actor->X());
+	cell.Y.Push((float)actor->Y());
+	cell.Radius.Push((float)actor->radius);
+	NumLinked++;
+}
+
+//==========================================================================
+//
+// FActorGrid :: Unlink
+//
+// Removes the actor by moving the cell's last entry into its slot.
+//
+//==========================================================================
+
+void FActorGrid::Unlink(AActor *actor)
+{
+	unsigned index = actor->GridCell - 1;
+	unsigned slot = actor->GridSlot;
+	actor->GridCell = 0;
+
+	// The grid may already have been torn down by the level.
+	if (index >= Cells.Size() || slot >= Cells[index].Actors.Size() || Cells[index].Actors[slot] != actor)
+	{
+		return;
+	}
+
+	Cell &cell = Cells[index];
+	unsigned last = cell.Actors.Size() - 1;
+	if (slot != last)
+	{
+		AActor *moved = cell.Actors[last];
+		cell.Actors[slot] = moved;
+		cell.X[slot] = cell.X[last];
+		cell.Y[slot] = cell.Y[last];
+		cell.Radius[slot] = cell.Radius[last];
+		moved->GridSlot = slot;
+	}
+	cell.Actors.Pop();
+	cell.X.Pop();
+	cell.Y.Pop();
+	cell.Radius.Pop();
+	NumLinked--;
+}
+
+//==========================================================================
+//
+// P_InitActorGrid
+//
+// Called once the blockmap has been set up.
+//
+//==========================================================================
+
+void P_InitActorGrid(FLevelLocals *Level)
+{
+	if (!sv_actorgrid)
+	{
+		Level->actorgrid.Clear();
+		return;
+	}
+	auto &bmap = Level->blockmap;
+	Level->actorgrid.Init(bmap.bmaporgx, bmap.bmaporgy,
+		double(bmap.bmapwidth) * FBlockmap::MAPBLOCKUNITS,
+		double(bmap.bmapheight) * FBlockmap::MAPBLOCKUNITS, sv_actorgridcellsize);
+}
+
+//==========================================================================
+//
+// STAT actorgrid
+//
+//==========================================================================
+
+ADD_STAT(actorgrid)
+{
+	FString out;
+	auto &grid = primaryLevel->actorgrid;
+	if (!grid.IsActive())
+	{
+		out = "Actor grid not active";
+		return out;
+	}
+	out.Format("Actor grid: %dx%d cells of %d, %d linked, %u oversize\n"
+		"%d queries, %d tested, %d returned (%.1f per query)",
+		grid.Width, grid.Height, grid.CellSize, grid.NumLinked, grid.Cells.Last().Actors.Size(),
+		grid.NumQueries, grid.NumTested, grid.NumReturned,
+		grid.NumQueries > 0 ? double(grid.NumReturned) / grid.NumQueries : 0.);
+	grid.NumQueries = grid.NumTested = grid.NumReturned = 0;
+	return out;
+}
@@ -458,6 +458,39 @@ static void MakeFountain (AActor *actor, int color1, int color2)
 	}
 }
 
+//==========================================================================
+//
+// FLevelLocals :: RunActorEffects
+//
+// Runs the particle effects of all actors in EffectActors and drops those
+// that no longer have any.
+//
+//==========================================================================
+
+void FLevelLocals::RunActorEffects()
+{
+	const bool frozen = isFrozen();
+	unsigned count = 0;
+	for (unsigned i = 0; i < EffectActors.Size(); i++)
+	{
+		AActor *ac = EffectActors[i];
+		if (ac == nullptr) continue;	// destroyed
+
+		if (!ac->effects && !ac->fountaincolor)
+		{
+			ac->EffectSlot = 0;
+			continue;
+		}
+		if (!frozen && ac->ShouldRenderLocally())
+		{
+			P_RunEffect(ac, ac->effects);
+		}
+		EffectActors[count] = ac;
+		ac->EffectSlot = ++count;
+	}
+	EffectActors.Resize(count);
+}
+
 void P_RunEffect (AActor *actor, int effects)
 {
 	DAngle moveangle = actor->Vel.Angle();
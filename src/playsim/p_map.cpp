@@ -7398,6 +7398,7 @@ bool P_ChangeSector(sector_t *sector, int crunch, double amt, int floorOrCeil, b
 	void(*iterator2)(AActor *, FChangePosition *) = NULL;
 	msecnode_t *n;
 
+	P_InvalidateSightCache();
 	cpos.nofit = false;
 	cpos.crushchange = crunch;
 	cpos.moveamt = fabs(amt);
@@ -346,6 +346,10 @@ void AActor::UnlinkFromWorld (FLinkContext *ctx)
 		}
 		BlockNode = NULL;
 	}
+	if (GridCell != 0)
+	{
+		Level->actorgrid.Unlink(this);
+	}
 	ClearRenderSectorList();
 	ClearRenderLineList();
 }
@@ -555,6 +559,10 @@ void AActor::LinkToWorld(FLinkContext *ctx, bool spawningmapthing, sector_t *sec
 				}
 			}
 		}
+		if (Level->actorgrid.IsActive())
+		{
+			Level->actorgrid.Link(this);
+		}
 	}
 	// Portal links cannot be done unless the level is fully initialized.
 	if (!spawningmapthing) UpdateRenderSectorList();
@@ -1092,6 +1100,24 @@ FMultiBlockThingsIterator::FMultiBlockThingsIterator(FPortalGroupArray &check, F
 
 bool FMultiBlockThingsIterator::Next(FMultiBlockThingsIterator::CheckResult *item)
 {
+	if (useGrid)
+	{
+		while (gridIndex < numCandidates)
+		{
+			AActor *thing = GetCandidate(gridIndex++);
+			// Skip anything that got unlinked or destroyed by an earlier callback, like the blockmap walk would.
+			if (thing->GridCell == 0 || (thing->ObjectFlags & OF_EuthanizeMe))
+			{
+				continue;
+			}
+			item->thing = thing;
+			item->Position = checkpoint;
+			item->portalflags = 0;
+			return true;
+		}
+		return false;
+	}
+
 	AActor *thing = blockIterator.Next();
 	if (thing != NULL)
 	{
@@ -1154,6 +1180,40 @@ void FMultiBlockThingsIterator::Reset()
 	portalflags = 0;
 	startIteratorForGroup(basegroup);
 	blockIterator.ClearHash();
+
+	auto Level = blockIterator.Level;
+	useGrid = Level->actorgrid.IsActive() && Level->Displacements.size <= 1;
+	if (useGrid)
+	{
+		collectGridCandidates();
+	}
+}
+
+//===========================================================================
+//
+// Gathers everything from the actor grid that may touch the check box.
+// This is done up front so that callbacks which relink actors cannot
+// disturb the iteration.
+//
+//===========================================================================
+
+void FMultiBlockThingsIterator::collectGridCandidates()
+{
+	gridIndex = 0;
+	numCandidates = 0;
+	DynCandidates.Clear();
+	blockIterator.Level->actorgrid.Query(checkpoint.X, checkpoint.Y, checkpoint.Z, [&](AActor *thing)
+	{
+		if (numCandidates < countof(FixedCandidates))
+		{
+			FixedCandidates[numCandidates] = thing;
+		}
+		else
+		{
+			DynCandidates.Push(thing);
+		}
+		numCandidates++;
+	});
 }
 
 //===========================================================================
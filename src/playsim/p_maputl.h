@@ -339,7 +339,17 @@ class FMultiBlockThingsIterator
 	FBlockThingsIterator blockIterator;
 	FBoundingBox bbox;
 
+	// Candidates taken from Level->actorgrid, which replaces the blockmap walk on levels without linked portals.
+	bool useGrid = false;
+	unsigned gridIndex;
+	unsigned numCandidates;
+	AActor *FixedCandidates[32];
+	TArray<AActor *> DynCandidates;
+
+	AActor *GetCandidate(unsigned i) { return i < countof(FixedCandidates) ? FixedCandidates[i] : DynCandidates[i - countof(FixedCandidates)]; }
+
 	void startIteratorForGroup(int group);
+	void collectGridCandidates();
 
 protected:
 	FMultiBlockThingsIterator(FPortalGroupArray &check, FLevelLocals *Level) : checklist(check), blockIterator(Level) {}
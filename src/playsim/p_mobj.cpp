@@ -389,6 +389,9 @@ void AActor::Serialize(FSerializer &arc)
 		A("viewangles", ViewAngles)
 		A("spawntime", SpawnTime)
 		A("spawnorder", SpawnOrder)
+		A("ticklod", TickLOD)
+		A("tickloddebt", TickLODDebt)
+		A("ticklodseen", TickLODSeen)
 		A("friction", Friction)
 		A("SpriteOffset", SpriteOffset)
 		("viewpos", ViewPos)
@@ -441,6 +444,11 @@ void AActor::PostSerialize()
 	ClearInterpolation();
 	ClearFOVInterpolation();
 	UpdateWaterLevel(false);
+
+	DirtyLightSlot = EffectSlot = 0;
+	if (flags8 & MF8_RECREATELIGHTS) MarkLightsDirty();
+	CheckEffectList();
+	tickThrottled = TickLOD > 1;
 }
 
 
@@ -615,8 +623,7 @@ bool AActor::SetState (FState *newstate, bool nofunction)
 
 	if (GetInfo()->LightAssociations.Size() || (state && state->Light > 0) || (oldstate && oldstate->Light > 0))
 	{
-		flags8 |= MF8_RECREATELIGHTS;
-		Level->flags3 |= LEVEL3_LIGHTCREATED;
+		MarkLightsDirty();
 	}
 	return true;
 }
@@ -3887,6 +3894,9 @@ void AActor::Tick ()
 	static const uint8_t HereticScrollDirs[4] = { 6, 9, 1, 4 };
 	static const uint8_t HereticSpeedMuls[5] = { 5, 10, 25, 30, 35 };
 
+	// effects and fountaincolor can be changed from scripts at any time.
+	CheckEffectList();
+
 	// Check for Actor unmorphing, but only on the thing that is the morphed Actor.
 	// Players do their own special checking for this.
 	if (alternative != nullptr && player == nullptr)
@@ -4926,6 +4936,10 @@ void ConstructActor(AActor *actor, const DVector3 &pos, bool SpawningMapThing)
 	}
 	// force scroller check in the first tic.
 	actor->flags8 |= MF8_INSCROLLSEC;
+	actor->CheckEffectList();
+	actor->TickLODDebt = 0;
+	actor->TickLODSeen = actor->Level->maptime;
+	actor->tickThrottled = actor->TickLOD > 1;
 }
 
 
@@ -5091,14 +5105,77 @@ void AActor::CallBeginPlay()
 }
 
 
+//==========================================================================
+//
+// AActor :: MarkLightsDirty
+//
+// Flags the attached lights to be recreated at the end of the tic.
+//
+//==========================================================================
+
+void AActor::MarkLightsDirty()
+{
+	flags8 |= MF8_RECREATELIGHTS;
+	Level->flags3 |= LEVEL3_LIGHTCREATED;
+	if (DirtyLightSlot == 0)
+	{
+		DirtyLightSlot = Level->DirtyLightActors.Push(this) + 1;
+	}
+}
+
+//==========================================================================
+//
+// AActor :: CheckEffectList
+//
+// Adds the actor to the level's effect list if it has any effects.
+// Actors are only removed again by RunActorEffects.
+//
+// Must be called after anything writes effects or fountaincolor. Tick
+// does so for scripted changes, but sleeping actors do not tick, so
+// entering and leaving sleep checks as well.
+//
+//==========================================================================
+
+void AActor::CheckEffectList()
+{
+	if (EffectSlot == 0 && (effects || fountaincolor))
+	{
+		EffectSlot = Level->EffectActors.Push(this) + 1;
+	}
+}
+
+DEFINE_ACTION_FUNCTION(AActor, CheckEffectList)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	self->CheckEffectList();
+	return 0;
+}
+
+void AActor::Wake()
+{
+	Super::Wake();
+	CheckEffectList();
+}
+
+void AActor::Sleep(int tics)
+{
+	CheckEffectList();
+	Super::Sleep(tics);
+}
+
+void AActor::SleepIndefinite()
+{
+	CheckEffectList();
+	Super::SleepIndefinite();
+}
+
 void AActor::PostBeginPlay ()
 {
 	PrevAngles = Angles;
 	flags7 |= MF7_HANDLENODELAY;
 	if (GetInfo()->LightAssociations.Size() || (state && state->Light > 0))
 	{
-		flags8 |= MF8_RECREATELIGHTS;
-		Level->flags3 |= LEVEL3_LIGHTCREATED;
+		MarkLightsDirty();
 	}
 }
 
@@ -5242,6 +5319,13 @@ void AActor::OnDestroy ()
 	ClearRenderSectorList();
 	ClearRenderLineList();
 
+	if (Level != nullptr)
+	{
+		if (DirtyLightSlot > 0 && unsigned(DirtyLightSlot) <= Level->DirtyLightActors.Size()) Level->DirtyLightActors[DirtyLightSlot - 1] = nullptr;
+		if (EffectSlot > 0 && unsigned(EffectSlot) <= Level->EffectActors.Size()) Level->EffectActors[EffectSlot - 1] = nullptr;
+	}
+	DirtyLightSlot = EffectSlot = 0;
+
 	// [RH] Destroy any inventory this actor is carrying
 	DestroyAllInventory (this);
 
@@ -6218,6 +6302,7 @@ AActor *FLevelLocals::SpawnMapThing (FMapThing *mthing, int position)
 	if (!(mobj->ObjectFlags & OF_EuthanizeMe))
 	{
 		mobj->LevelSpawned ();
+		mobj->CheckEffectList();	// BeginPlay may have set effects
 	}
 
 	if (mthing->Health > 0)
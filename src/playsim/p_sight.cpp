@@ -51,8 +51,8 @@ This uses specialized forms of the maputils routines for optimized performance
 */
 
 // Performance meters
-static int sightcounts[6];
-static cycle_t SightCycles;
+int sightcounts[6];
+cycle_t SightCycles;
 static cycle_t MaxSightCycles;
 
 enum
@@ -832,33 +832,65 @@ sightcounts[2]++;
 	return traverseres;
 }
 
-/*
-=====================
-=
-= P_CheckSight
-=
-= Returns true if a straight line between t1 and t2 is unobstructed
-= look from eyes of t1 to any part of t2
-=
-= killough 4/20/98: cleaned up, made to use new LOS struct
-=
-=====================
-*/
+//==========================================================================
+//
+// Sight trace cache
+//
+// Monsters re-check the same pairs many times per tic through A_Look,
+// A_Chase and script calls. The expensive part, the blockmap trace, is
+// memoized here per tic. An entry is only valid while both actors stay
+// where they were, and the whole cache is dropped every tic as well as
+// whenever a sector plane or polyobject moves.
+//
+//==========================================================================
 
-int P_CheckSight (AActor *t1, AActor *t2, int flags)
+CVAR(Bool, sv_sightcache, true, CVAR_ARCHIVE | CVAR_SERVERINFO)
+
+struct FSightCacheEntry
 {
-	SightCycles.Clock();
+	AActor *t1, *t2;
+	DVector3 pos1, pos2;
+	double height1, height2;
+	int flags;
+	unsigned generation;
+	bool result;
+};
 
-	bool res;
+static constexpr unsigned SIGHTCACHE_SIZE = 1024;	// must be a power of 2
+static FSightCacheEntry SightCache[SIGHTCACHE_SIZE];
+static unsigned SightCacheGeneration = 1;
+static int SightCacheHits, SightCacheMisses;
+static int MaxSightCacheHits, MaxSightCacheMisses;
 
-	if (t1 == nullptr || t2 == nullptr)
+void P_InvalidateSightCache()
+{
+	if (++SightCacheGeneration == 0)
 	{
-		return false;
+		memset(SightCache, 0, sizeof(SightCache));
+		SightCacheGeneration = 1;
 	}
+}
 
+static FSightCacheEntry *FindSightCacheEntry(AActor *t1, AActor *t2, int flags)
+{
+	size_t hash = (((size_t)t1 >> 4) * 31 + ((size_t)t2 >> 4)) ^ (size_t)flags;
+	return &SightCache[(hash ^ (hash >> 10)) & (SIGHTCACHE_SIZE - 1)];
+}
+
+//==========================================================================
+//
+// SightPrecheck
+//
+// All the cheap rejection tests of P_CheckSight. Returns 0 if there can
+// be no line of sight, -1 if the full trace is needed.
+//
+//==========================================================================
+
+static int SightPrecheck(AActor *t1, AActor *t2, int flags)
+{
 	if ((t2->flags9 & MF9_MVISBLOCKED) && !(flags & SF_IGNOREVISIBILITY))
 	{
-		return false;
+		return 0;
 	}
 
 	auto s1 = t1->Sector;
@@ -869,8 +901,7 @@ int P_CheckSight (AActor *t1, AActor *t2, int flags)
 	if (!t1->Level->CheckReject(s1, s2))
 	{
 sightcounts[0]++;
-		res = false;			// can't possibly be connected
-		goto done;
+		return 0;			// can't possibly be connected
 	}
 
 //
@@ -885,8 +916,7 @@ sightcounts[0]++;
 	{ // small chance of an attack being made anyway
 		if ((t1->Level->BotInfo.m_Thinking ? pr_botchecksight() : pr_checksight()) > 50)
 		{
-			res = false;
-			goto done;
+			return 0;
 		}
 	}
 
@@ -906,27 +936,44 @@ sightcounts[0]++;
 			  (t2->Z() >= s2->heightsec->ceilingplane.ZatPoint(t2) &&
 			   t1->Top() <= s2->heightsec->ceilingplane.ZatPoint(t1)))))
 		{
-			res = false;
-			goto done;
+			return 0;
 		}
 	}
+	return -1;
+}
 
-	// An unobstructed LOS is possible.
-	// Now look from eyes of t1 to any part of t2.
+//==========================================================================
+//
+// SightTrace
+//
+// Looks from the eyes of t1 to any part of t2. sec and lookheight are the
+// eye's sector and height as returned by AActor::GetPortalTransition.
+//
+//==========================================================================
+
+static bool SightTrace(SightCheck &s, AActor *t1, AActor *t2, sector_t *sec, double lookheight, int flags)
+{
+	FSightCacheEntry *entry = nullptr;
+	if (sv_sightcache)
+	{
+		entry = FindSightCacheEntry(t1, t2, flags);
+		if (entry->generation == SightCacheGeneration && entry->t1 == t1 && entry->t2 == t2 && entry->flags == flags &&
+			entry->pos1 == t1->Pos() && entry->pos2 == t2->Pos() && entry->height1 == t1->Height && entry->height2 == t2->Height)
+		{
+			SightCacheHits++;
+			return entry->result;
+		}
+		SightCacheMisses++;
+	}
 
+	bool res;
 	validcount++;
 	portals.Clear();
 	{
-		sector_t *sec;
-		double lookheight = t1->Z() + t1->Height*0.75;
-		t1->GetPortalTransition(lookheight, &sec);
-
 		double bottomslope = t2->Z() - lookheight;
 		double topslope = bottomslope + t2->Height;
 		SightTask task = { 0, topslope, bottomslope, -1, sec->PortalGroup };
 
-
-		SightCheck s(t1->Level);
 		s.init(t1, t2, sec, &task, flags);
 		res = s.P_SightPathTraverse ();
 		if (!res)
@@ -945,17 +992,103 @@ sightcounts[0]++;
 		}
 	}
 
-done:
+	if (entry != nullptr)
+	{
+		*entry = { t1, t2, t1->Pos(), t2->Pos(), t1->Height, t2->Height, flags, SightCacheGeneration, res };
+	}
+	return res;
+}
+
+/*
+=====================
+=
+= P_CheckSight
+=
+= Returns true if a straight line between t1 and t2 is unobstructed
+= look from eyes of t1 to any part of t2
+=
+= killough 4/20/98: cleaned up, made to use new LOS struct
+=
+=====================
+*/
+
+int P_CheckSight (AActor *t1, AActor *t2, int flags)
+{
+	if (t1 == nullptr || t2 == nullptr)
+	{
+		return false;
+	}
+
+	SightCycles.Clock();
+
+	bool res = false;
+	if (SightPrecheck(t1, t2, flags) != 0)
+	{
+		// An unobstructed LOS is possible.
+		// Now look from eyes of t1 to any part of t2.
+		sector_t *sec;
+		double lookheight = t1->Z() + t1->Height*0.75;
+		t1->GetPortalTransition(lookheight, &sec);
+
+		SightCheck s(t1->Level);
+		res = SightTrace(s, t1, t2, sec, lookheight, flags);
+	}
+
 	SightCycles.Unclock();
 	return res;
 }
 
+//==========================================================================
+//
+// P_CheckSightBatch
+//
+// Checks the sight from one looker to many targets in one go. The
+// looker's eye position and portal transition are only determined once
+// and all traces share one SightCheck and its intercept buffers. Null
+// targets are reported as not visible. Returns the number of visible
+// targets.
+//
+//==========================================================================
+
+int P_CheckSightBatch(AActor *t1, AActor *const *targets, unsigned count, int *results, int flags)
+{
+	if (t1 == nullptr)
+	{
+		memset(results, 0, count * sizeof(*results));
+		return 0;
+	}
+
+	SightCycles.Clock();
+
+	sector_t *sec;
+	double lookheight = t1->Z() + t1->Height*0.75;
+	t1->GetPortalTransition(lookheight, &sec);
+	SightCheck s(t1->Level);
+
+	int visible = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		AActor *t2 = targets[i];
+		bool res = t2 != nullptr && SightPrecheck(t1, t2, flags) != 0 && SightTrace(s, t1, t2, sec, lookheight, flags);
+		results[i] = res;
+		visible += res;
+	}
+
+	SightCycles.Unclock();
+	return visible;
+}
+
 ADD_STAT (sight)
 {
 	FString out;
-	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n",
+	int lookups = SightCacheHits + SightCacheMisses;
+	int maxlookups = MaxSightCacheHits + MaxSightCacheMisses;
+	out.Format ("%04.1f ms (%04.1f max), %5d %2d%4d%4d%4d%4d\n"
+		"cache: %4d hits, %4d misses (%3.0f%%), this level: %3.0f%%\n",
 		SightCycles.TimeMS(), MaxSightCycles.TimeMS(),
-		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5]);
+		sightcounts[3], sightcounts[0], sightcounts[1], sightcounts[2], sightcounts[4], sightcounts[5],
+		SightCacheHits, SightCacheMisses, lookups > 0 ? SightCacheHits * 100. / lookups : 0.,
+		maxlookups > 0 ? MaxSightCacheHits * 100. / maxlookups : 0.);
 	return out;
 }
 
@@ -964,7 +1097,12 @@ void P_ResetSightCounters (bool full)
 	if (full)
 	{
 		MaxSightCycles.Reset();
+		MaxSightCacheHits = MaxSightCacheMisses = 0;
 	}
+	MaxSightCacheHits += SightCacheHits;
+	MaxSightCacheMisses += SightCacheMisses;
+	SightCacheHits = SightCacheMisses = 0;
+	P_InvalidateSightCache();
 	if (SightCycles.Time() > MaxSightCycles.Time())
 	{
 		MaxSightCycles = SightCycles;
@@ -0,0 +1,180 @@
+//-----------------------------------------------------------------------------
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see http://www.gnu.org/licenses/
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//		Tick throttling for actors far away from all players.
+//
+//		Classes opt in with the TickLOD property, which gives the largest
+//		interval (2, 4 or 8) the actor may be ticked at. An opted-in actor
+//		that is at rest, is beyond the sv_ticklod_dist bands from every
+//		player and could not have been seen by any of them for a second is
+//		only ticked every 2nd, 4th or 8th tic.
+//
+//		On the next real tick the skipped tics are played back on the state
+//		timer, running every state transition and action that fell into
+//		them, so animations and state driven movement keep their pace. An
+//		actor at rest has no velocity to catch up on, and one that starts
+//		moving or falling is ticked every tic again right away.
+//
+//		Visibility comes from the reject table. Maps without one use a sight
+//		check, which is only repeated every few tics per actor.
+//
+//		Everything here only depends on playsim data (positions, the reject
+//		table and SpawnOrder for the phase), so demos, savegames and netgames
+//		stay in sync.
+//
+//-----------------------------------------------------------------------------
+
+#include "actor.h"
+#include "g_levellocals.h"
+#include "d_player.h"
+#include "c_cvars.h"
+#include "stats.h"
+#include "p_local.h"
+
+CVAR(Bool, sv_ticklod, true, CVAR_ARCHIVE | CVAR_SERVERINFO)
+CVAR(Float, sv_ticklod_dist1, 1024.f, CVAR_ARCHIVE | CVAR_SERVERINFO)
+CVAR(Float, sv_ticklod_dist2, 2048.f, CVAR_ARCHIVE | CVAR_SERVERINFO)
+CVAR(Float, sv_ticklod_dist3, 4096.f, CVAR_ARCHIVE | CVAR_SERVERINFO)
+
+static int LODTicked, LODSkipped;
+static uint64_t LODTotalSkipped;
+
+//==========================================================================
+//
+// GetLODInterval
+//
+//==========================================================================
+
+static int GetLODInterval(AActor *actor)
+{
+	FLevelLocals *Level = actor->Level;
+	if (!sv_ticklod || actor->player != nullptr || Level->isFrozen() || !actor->Vel.isZero() ||
+		(actor->Z() > actor->floorz && !(actor->flags & MF_NOGRAVITY)))
+	{
+		return 1;
+	}
+	// Visibility is looked at again after half a second, so an actor that stays in
+	// view never drops out of the one second window.
+	if (Level->maptime - actor->TickLODSeen < TICRATE / 2)
+	{
+		return 1;
+	}
+	const bool recentlyseen = Level->maptime - actor->TickLODSeen < TICRATE;
+
+	double dist = DBL_MAX;
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (!Level->PlayerInGame(i)) continue;
+		player_t *player = Level->Players[i];
+		for (AActor *viewer : { (AActor *)player->mo, player->camera.Get() })
+		{
+			if (viewer != nullptr) dist = min(dist, actor->Distance3DSquared(viewer));
+		}
+	}
+
+	int interval;
+	if (dist < sv_ticklod_dist1 * sv_ticklod_dist1) return 1;
+	else if (dist < sv_ticklod_dist2 * sv_ticklod_dist2) interval = 2;
+	else if (dist < sv_ticklod_dist3 * sv_ticklod_dist3) interval = 4;
+	else interval = 8;
+	while (interval > actor->TickLOD) interval >>= 1;
+	if (interval <= 1) return 1;
+
+	// Only far actors get here, so the visibility test is not needed for the others.
+	// Without a reject table every pair passes, so fall back to a sight check on
+	// every 4th tic. A far actor that comes into view is ticked at its old rate
+	// for up to 3 more tics.
+	const bool hasreject = Level->rejectmatrix.Size() > 0;
+	if (!hasreject && ((Level->maptime + actor->SpawnOrder) & 3) != 0)
+	{
+		return recentlyseen ? 1 : interval;
+	}
+	for (int i = 0; i < MAXPLAYERS; i++)
+	{
+		if (!Level->PlayerInGame(i)) continue;
+		player_t *player = Level->Players[i];
+		for (AActor *viewer : { (AActor *)player->mo, player->camera.Get() })
+		{
+			if (viewer == nullptr || !Level->CheckReject(actor->Sector, viewer->Sector)) continue;
+			if (hasreject || P_CheckSight(viewer, actor, SF_IGNOREVISIBILITY | SF_IGNOREWATERBOUNDARY))
+			{
+				actor->TickLODSeen = Level->maptime;
+				return 1;
+			}
+		}
+	}
+	return recentlyseen ? 1 : interval;
+}
+
+//==========================================================================
+//
+// AActor :: SkipLODTick
+//
+// Called by the thinker loop for actors with tickThrottled set. Returns
+// true if this tic should be skipped.
+//
+//==========================================================================
+
+bool AActor::SkipLODTick()
+{
+	if (ObjectFlags & (OF_JustSpawned | OF_EuthanizeMe))
+	{
+		return false;
+	}
+
+	int interval = GetLODInterval(this);
+	if (interval > 1 && TickLODDebt + 1 < interval && ((Level->maptime + SpawnOrder) & (interval - 1)) != 0)
+	{
+		TickLODDebt++;
+		LODSkipped++;
+		LODTotalSkipped++;
+		return true;
+	}
+
+	// Play back the skipped tics the way Tick would have counted them down,
+	// including the state transitions and their actions.
+	while (TickLODDebt > 0 && tics != -1)
+	{
+		int step = min(TickLODDebt, max(tics, 1));
+		TickLODDebt -= step;
+		tics -= step;
+		if (tics <= 0 && !SetState(state->GetNextState()))
+		{
+			TickLODDebt = 0;
+			return true;	// freed itself
+		}
+	}
+	TickLODDebt = 0;
+	LODTicked++;
+	return false;
+}
+
+//==========================================================================
+//
+// STAT ticklod
+//
+//==========================================================================
+
+ADD_STAT(ticklod)
+{
+	FString out;
+	out.Format("Tick LOD: %d ticked, %d skipped (%llu skipped in total)%s",
+		LODTicked, LODSkipped, (unsigned long long)LODTotalSkipped, sv_ticklod ? "" : ", disabled");
+	LODTicked = LODSkipped = 0;
+	return out;
+}
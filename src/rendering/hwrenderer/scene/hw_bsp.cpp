@@ -43,6 +43,7 @@
 #include "flatvertices.h"
 #include "hw_vertexbuilder.h"
 #include "hw_walldispatcher.h"
+#include "tracecapture.h"
 
 #ifdef ARCH_IA32
 #include <immintrin.h>
@@ -122,6 +123,7 @@ void HWDrawInfo::WorkerThread()
 	sector_t *front, *back;
 	HWWallDispatcher disp(this);
 
+	TRACE_SCOPE("BSP worker", TRACE_Render);
 	WTTotal.Clock();
 	isWorkerThread = true;	// for adding asserts in GL API code. The worker thread may never call any GL API.
 	while (true)
@@ -1047,6 +1049,7 @@ void HWDrawInfo::RenderOrthoNoFog()
 
 void HWDrawInfo::RenderBSP(void *node, bool drawpsprites)
 {
+	TRACE_SCOPE("RenderBSP", TRACE_Render);
 	ClearDitherTargets();
 	Bsp.Clock();
 
@@ -49,6 +49,7 @@
 #include "texturemanager.h"
 #include "actorinlines.h"
 #include "g_levellocals.h"
+#include "tracecapture.h"
 
 EXTERN_CVAR(Float, r_visibility)
 CVAR(Bool, gl_bandedswlight, false, CVAR_ARCHIVE)
@@ -455,6 +456,7 @@ HWDecal *HWDrawInfo::AddDecal(bool onmirror)
 
 void HWDrawInfo::CreateScene(bool drawpsprites)
 {
+	TRACE_SCOPE("CreateScene", TRACE_Render);
 	const auto &vp = Viewpoint;
 	angle_t a1 = FrustumAngle(); // horizontally clip the back of the viewport
 	mClipper->SafeAddClipRangeRealAngles(vp.Angles.Yaw.BAMs() + a1, vp.Angles.Yaw.BAMs() - a1);
@@ -504,6 +506,7 @@ void HWDrawInfo::CreateScene(bool drawpsprites)
 
 void HWDrawInfo::RenderScene(FRenderState &state)
 {
+	TRACE_SCOPE("RenderScene", TRACE_Render);
 	const auto &vp = Viewpoint;
 	RenderAll.Clock();
 
@@ -63,7 +63,10 @@
 
 #include "gi.h"
 #include "stats.h"
+#include "x86.h"
 #include <vector>
+#include <atomic>
+#include <chrono>
 
 ;
 // Use linear filtering when scaling up
@@ -78,36 +81,86 @@ CVAR(Bool, r_mipmap, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 // Level of detail texture bias
 CVAR(Float, r_lod_bias, -1.5, 0); // To do: add CVAR_ARCHIVE | CVAR_GLOBALCONFIG when a good default has been decided
 
+#ifndef NO_SSE
+namespace swrenderer
+{
+	enum { BENCH_CPP, BENCH_SSE2, BENCH_AVX2, NUM_BENCH_DRAWERS };
+	static std::atomic<uint64_t> DrawerBenchSpans, DrawerBenchPixels;
+	static std::atomic<uint64_t> DrawerBenchTime[NUM_BENCH_DRAWERS]; // ns
+	static std::atomic<uint64_t> DrawerBenchDiffering[NUM_BENCH_DRAWERS]; // pixels that differ from the SSE2 drawer
+}
+
+// Use the AVX2 span and wall drawers if the CPU supports them
+CVAR(Bool, r_avx2drawers, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
+
+// Draw every span with the C++, SSE2 and AVX2 drawers and time them (see stat drawerbench)
+CUSTOM_CVAR(Bool, r_drawerbench, false, 0)
+{
+	using namespace swrenderer;
+	DrawerBenchSpans = 0;
+	DrawerBenchPixels = 0;
+	for (int i = 0; i < NUM_BENCH_DRAWERS; i++)
+	{
+		DrawerBenchTime[i] = 0;
+		DrawerBenchDiffering[i] = 0;
+	}
+}
+#endif
+
 namespace swrenderer
 {
 	void SWTruecolorDrawers::DrawWall(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWall32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWall32Command>(args, DrawWall8AVX2);
+#else
+		DrawWallColumns<DrawWall32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawWallMasked(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWallMasked32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWallMasked32Command>(args, DrawWallMasked8AVX2);
+#else
+		DrawWallColumns<DrawWallMasked32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawWallAdd(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWallAddClamp32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWallAddClamp32Command>(args, DrawWallAddClamp8AVX2);
+#else
+		DrawWallColumns<DrawWallAddClamp32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawWallAddClamp(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWallAddClamp32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWallAddClamp32Command>(args, DrawWallAddClamp8AVX2);
+#else
+		DrawWallColumns<DrawWallAddClamp32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawWallSubClamp(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWallSubClamp32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWallSubClamp32Command>(args, DrawWallSubClamp8AVX2);
+#else
+		DrawWallColumns<DrawWallSubClamp32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawWallRevSubClamp(const WallDrawerArgs &args)
 	{
-		DrawWallColumns<DrawWallRevSubClamp32Command>(args);
+#ifndef NO_SSE
+		DrawWallColumns<DrawWallRevSubClamp32Command>(args, DrawWallRevSubClamp8AVX2);
+#else
+		DrawWallColumns<DrawWallRevSubClamp32Command>(args, nullptr);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawColumn(const SpriteDrawerArgs &args)
@@ -204,34 +257,151 @@ namespace swrenderer
 		DrawSpriteTranslatedRevSubClamp32Command::DrawColumn(args);
 	}
 
+#ifndef NO_SSE
+	static bool CheckAVX2()
+	{
+		if (!CPU.bAVX2 || !CPU.bOSXSAVE)
+			return false;
+
+		// The OS must also save the upper halves of the ymm registers
+#ifdef _MSC_VER
+		uint64_t xcr0 = _xgetbv(0);
+#else
+		uint32_t xcr0lo, xcr0hi;
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+		uint64_t xcr0 = ((uint64_t)xcr0hi << 32) | xcr0lo;
+#endif
+		return (xcr0 & 6) == 6;
+	}
+
+	static bool CPUHasAVX2()
+	{
+		static bool supported = CheckAVX2();
+		return supported;
+	}
+
+	static bool UseAVX2Drawers()
+	{
+		return r_avx2drawers && CPUHasAVX2();
+	}
+
+	// Draws the span with every drawer this CPU can run, each starting from the same
+	// background. The drawers take turns going first so none of them always pays for
+	// bringing the texture into the cache. The SSE2 result is the one that is kept.
+	template<typename DrawerT>
+	static void BenchSpan(const SpanDrawerArgs &args, SpanDrawer32Func drawcpp, SpanDrawer32Func drawavx2)
+	{
+		int count = args.DestX2() - args.DestX1() + 1;
+		uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
+
+		thread_local std::vector<uint32_t> background, results[NUM_BENCH_DRAWERS];
+		thread_local int first;
+		background.assign(dest, dest + count);
+
+		int numdrawers = CPUHasAVX2() ? NUM_BENCH_DRAWERS : BENCH_AVX2;
+		first = (first + 1) % numdrawers;
+		for (int i = 0; i < numdrawers; i++)
+		{
+			int drawer = (first + i) % numdrawers;
+			memcpy(dest, background.data(), count * sizeof(uint32_t));
+
+			auto start = std::chrono::steady_clock::now();
+			if (drawer == BENCH_CPP)
+				drawcpp(args);
+			else if (drawer == BENCH_SSE2)
+				DrawerT::DrawColumn(args);
+			else
+				drawavx2(args);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			DrawerBenchTime[drawer] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+			results[drawer].assign(dest, dest + count);
+		}
+
+		const uint32_t *reference = results[BENCH_SSE2].data();
+		for (int drawer = 0; drawer < numdrawers; drawer++)
+		{
+			if (drawer == BENCH_SSE2)
+				continue;
+
+			uint64_t differing = 0;
+			for (int i = 0; i < count; i++)
+			{
+				if (results[drawer][i] != reference[i])
+					differing++;
+			}
+			DrawerBenchDiffering[drawer] += differing;
+		}
+		memcpy(dest, reference, count * sizeof(uint32_t));
+
+		DrawerBenchSpans++;
+		DrawerBenchPixels += count;
+	}
+
+	template<typename DrawerT>
+	static void DrawSpan32(const SpanDrawerArgs &args, SpanDrawer32Func drawcpp, SpanDrawer32Func drawavx2)
+	{
+		if (r_drawerbench)
+			BenchSpan<DrawerT>(args, drawcpp, drawavx2);
+		else if (UseAVX2Drawers())
+			drawavx2(args);
+		else
+			DrawerT::DrawColumn(args);
+	}
+#endif
+
 	void SWTruecolorDrawers::DrawSpan(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpan32Command>(args, DrawSpan32Cpp, DrawSpan32AVX2);
+#else
 		DrawSpan32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMasked(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpanMasked32Command>(args, DrawSpanMasked32Cpp, DrawSpanMasked32AVX2);
+#else
 		DrawSpanMasked32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSpanTranslucent(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpanTranslucent32Command>(args, DrawSpanTranslucent32Cpp, DrawSpanTranslucent32AVX2);
+#else
 		DrawSpanTranslucent32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedTranslucent(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpanAddClamp32Command>(args, DrawSpanAddClamp32Cpp, DrawSpanAddClamp32AVX2);
+#else
 		DrawSpanAddClamp32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSpanAddClamp(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpanTranslucent32Command>(args, DrawSpanTranslucent32Cpp, DrawSpanTranslucent32AVX2);
+#else
 		DrawSpanTranslucent32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSpanMaskedAddClamp(const SpanDrawerArgs &args)
 	{
+#ifndef NO_SSE
+		DrawSpan32<DrawSpanAddClamp32Command>(args, DrawSpanAddClamp32Cpp, DrawSpanAddClamp32AVX2);
+#else
 		DrawSpanAddClamp32Command::DrawColumn(args);
+#endif
 	}
 	
 	void SWTruecolorDrawers::DrawSingleSkyColumn(const SkyDrawerArgs &args)
@@ -1023,7 +1193,7 @@ namespace swrenderer
 	/////////////////////////////////////////////////////////////////////////////
 
 	template<typename DrawerT>
-	void SWTruecolorDrawers::DrawWallColumns(const WallDrawerArgs& wallargs)
+	void SWTruecolorDrawers::DrawWallColumns(const WallDrawerArgs& wallargs, WallDrawer8Func draw8)
 	{
 		wallcolargs.wallargs = &wallargs;
 
@@ -1065,6 +1235,15 @@ namespace swrenderer
 		float centerY = wallargs.CenterY;
 		centerY -= 0.5f;
 
+		// Without dynamic lights, runs of eight columns can go to the AVX2 drawers
+#ifndef NO_SSE
+		bool batch = draw8 && !haslights && UseAVX2Drawers();
+#else
+		bool batch = false;
+#endif
+		WallColumn columns[8];
+		int numcolumns = 0;
+
 		auto uwal = wallargs.uwal;
 		auto dwal = wallargs.dwal;
 		for (int x = x1; x < x2; x++)
@@ -1073,12 +1252,6 @@ namespace swrenderer
 			int y2 = dwal[x];
 			if (y2 > y1)
 			{
-				wallcolargs.SetLight(curlight, shade);
-				if (haslights)
-					SetLights(wallcolargs, x, y1, wallargs);
-				else
-					wallcolargs.dc_num_lights = 0;
-
 				float dy = (y1 - centerY);
 				float u = upos + ustepY * dy;
 				float v = vpos + vstepY * dy;
@@ -1096,7 +1269,31 @@ namespace swrenderer
 				uint32_t texelStepX = (uint32_t)(int64_t)(scaleU * 0x1'0000'0000LL);
 				uint32_t texelStepY = (uint32_t)(int64_t)(scaleV * 0x1'0000'0000LL);
 
-				DrawWallColumn32<DrawerT>(wallcolargs, x, y1, y2, texelX, texelY, texelStepX, texelStepY);
+				if (batch)
+				{
+					columns[numcolumns++] = { x, y1, y2, curlight, texelX, texelY, texelStepX, texelStepY };
+					if (numcolumns == 8)
+					{
+						DrawWallColumnBatch<DrawerT>(columns, numcolumns, shade, draw8);
+						numcolumns = 0;
+					}
+				}
+				else
+				{
+					wallcolargs.SetLight(curlight, shade);
+					if (haslights)
+						SetLights(wallcolargs, x, y1, wallargs);
+					else
+						wallcolargs.dc_num_lights = 0;
+
+					DrawWallColumn32<DrawerT>(wallcolargs, x, y1, y2, texelX, texelY, texelStepX, texelStepY);
+				}
+			}
+			else if (numcolumns > 0)
+			{
+				// The columns of a batch have to be next to each other
+				DrawWallColumnBatch<DrawerT>(columns, numcolumns, shade, draw8);
+				numcolumns = 0;
 			}
 
 			upos += ustepX;
@@ -1104,10 +1301,101 @@ namespace swrenderer
 			wpos += wstepX;
 			curlight += lightstep;
 		}
+
+		if (numcolumns > 0)
+			DrawWallColumnBatch<DrawerT>(columns, numcolumns, shade, draw8);
+	}
+
+	template<typename DrawerT>
+	void SWTruecolorDrawers::DrawWallColumnBatch(const WallColumn *columns, int count, int shade, WallDrawer8Func draw8)
+	{
+		wallcolargs.dc_num_lights = 0;
+
+		// All eight columns need the same filter and some rows in common
+		int ytop = columns[0].y1;
+		int ybottom = columns[0].y2;
+		for (int i = 1; i < count; i++)
+		{
+			ytop = max(ytop, columns[i].y1);
+			ybottom = min(ybottom, columns[i].y2);
+		}
+
+		WallColumns8 batch;
+		bool usebatch = draw8 && count == 8 && ytop < ybottom;
+		for (int i = 0; usebatch && i < 8; i++)
+		{
+			const WallColumn& column = columns[i];
+			wallcolargs.SetLight(column.light, shade);
+			SetupWallColumn32(wallcolargs, column.x, column.y1, column.y2, column.texelX, column.texelY, column.texelStepX, column.texelStepY);
+
+			batch.source[i] = (const uint32_t*)wallcolargs.TexturePixels();
+			batch.source2[i] = (const uint32_t*)wallcolargs.TexturePixels2();
+			batch.textureheight[i] = wallcolargs.TextureHeight();
+			batch.texturefracx[i] = wallcolargs.TextureUPos();
+			batch.texturefrac[i] = wallcolargs.TextureVPos();
+			batch.iscale[i] = wallcolargs.TextureVStep();
+			batch.light[i] = wallcolargs.Light();
+			usebatch = (batch.source2[i] == nullptr) == (batch.source2[0] == nullptr);
+		}
+
+		if (!usebatch)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				const WallColumn& column = columns[i];
+				wallcolargs.SetLight(column.light, shade);
+				DrawWallColumn32<DrawerT>(wallcolargs, column.x, column.y1, column.y2, column.texelX, column.texelY, column.texelStepX, column.texelStepY);
+			}
+			return;
+		}
+
+		// The rows above and below the common ones are drawn one column at a time
+		for (int i = 0; i < 8; i++)
+		{
+			const WallColumn& column = columns[i];
+			if (column.y1 == ytop && column.y2 == ybottom)
+				continue;
+
+			wallcolargs.SetLight(column.light, shade);
+			wallcolargs.SetTexture((const uint8_t*)batch.source[i], (const uint8_t*)batch.source2[i], batch.textureheight[i]);
+			wallcolargs.SetTextureUPos(batch.texturefracx[i]);
+			wallcolargs.SetTextureVStep(batch.iscale[i]);
+			if (column.y1 < ytop)
+			{
+				wallcolargs.SetDest(column.x, column.y1);
+				wallcolargs.SetCount(ytop - column.y1);
+				wallcolargs.SetTextureVPos(batch.texturefrac[i]);
+				DrawerT::DrawColumn(wallcolargs);
+			}
+			if (column.y2 > ybottom)
+			{
+				wallcolargs.SetDest(column.x, ybottom);
+				wallcolargs.SetCount(column.y2 - ybottom);
+				wallcolargs.SetTextureVPos(batch.texturefrac[i] + batch.iscale[i] * (uint32_t)(ybottom - column.y1));
+				DrawerT::DrawColumn(wallcolargs);
+			}
+		}
+
+		for (int i = 0; i < 8; i++)
+			batch.texturefrac[i] += batch.iscale[i] * (uint32_t)(ytop - columns[i].y1);
+
+		batch.dest = (uint32_t*)wallcolargs.Viewport()->GetDest(columns[0].x, ytop);
+		batch.pitch = wallcolargs.Viewport()->RenderTarget->GetPitch();
+		batch.count = ybottom - ytop;
+		batch.shade_constants = wallcolargs.ColormapConstants();
+		batch.srcalpha = wallcolargs.SrcAlpha();
+		batch.destalpha = wallcolargs.DestAlpha();
+		draw8(batch);
 	}
 
 	template<typename DrawerT>
 	void SWTruecolorDrawers::DrawWallColumn32(WallColumnDrawerArgs& drawerargs, int x, int y1, int y2, uint32_t texelX, uint32_t texelY, uint32_t texelStepX, uint32_t texelStepY)
+	{
+		SetupWallColumn32(drawerargs, x, y1, y2, texelX, texelY, texelStepX, texelStepY);
+		DrawerT::DrawColumn(drawerargs);
+	}
+
+	void SWTruecolorDrawers::SetupWallColumn32(WallColumnDrawerArgs& drawerargs, int x, int y1, int y2, uint32_t texelX, uint32_t texelY, uint32_t texelStepX, uint32_t texelStepY)
 	{
 		auto& wallargs = *drawerargs.wallargs;
 		int texwidth = wallargs.texwidth;
@@ -1168,6 +1456,42 @@ namespace swrenderer
 		drawerargs.SetTextureUPos(texturefracx);
 		drawerargs.SetTextureVPos(texelY);
 		drawerargs.SetTextureVStep(texelStepY);
-		DrawerT::DrawColumn(drawerargs);
 	}
+
+#ifndef NO_SSE
+	/////////////////////////////////////////////////////////////////////////////
+
+	// The C++ drawer desaturates blue where the SSE2 and AVX2 drawers desaturate alpha,
+	// so it differs in desaturated sectors. The AVX2 drawer should never differ.
+	ADD_STAT(drawerbench)
+	{
+		FString out;
+		if (!r_drawerbench)
+		{
+			out = "r_drawerbench is off";
+			return out;
+		}
+
+		static const char *names[NUM_BENCH_DRAWERS] = { "C++", "SSE2", "AVX2" };
+		double pixels = max<double>((double)DrawerBenchPixels, 1.0);
+		out.Format("spans=%llu  pixels=%llu", (unsigned long long)DrawerBenchSpans, (unsigned long long)DrawerBenchPixels);
+		for (int i = 0; i < NUM_BENCH_DRAWERS; i++)
+		{
+			if (i == BENCH_AVX2 && !CPUHasAVX2())
+			{
+				out.AppendFormat("\n%s: not supported by this CPU", names[i]);
+			}
+			else if (i == BENCH_SSE2)
+			{
+				out.AppendFormat("\n%s: %.2f ns/px", names[i], DrawerBenchTime[i] / pixels);
+			}
+			else
+			{
+				out.AppendFormat("\n%s: %.2f ns/px  %.2fx SSE2  differing=%llu px", names[i], DrawerBenchTime[i] / pixels,
+					DrawerBenchTime[i] > 0 ? (double)DrawerBenchTime[BENCH_SSE2] / DrawerBenchTime[i] : 0.0, (unsigned long long)DrawerBenchDiffering[i]);
+			}
+		}
+		return out;
+	}
+#endif
 }
@@ -89,6 +89,27 @@ namespace swrenderer
 
 	/////////////////////////////////////////////////////////////////////////////
 
+	// Eight neighbouring wall columns, one per AVX2 lane, over the rows all of them cover.
+	// Each lane holds what DrawWallColumn32 would have put in WallColumnDrawerArgs.
+	struct WallColumns8
+	{
+		uint32_t *dest;				// first column, first row
+		int pitch;
+		int count;
+		const uint32_t *source[8];
+		const uint32_t *source2[8];	// all null for nearest filtering, none null for linear
+		uint32_t textureheight[8];
+		uint32_t texturefracx[8];
+		uint32_t texturefrac[8];
+		uint32_t iscale[8];
+		fixed_t light[8];
+		ShadeConstants shade_constants;
+		fixed_t srcalpha;
+		fixed_t destalpha;
+	};
+
+	typedef void(*WallDrawer8Func)(const WallColumns8 &columns);
+
 	class SWTruecolorDrawers : public SWPixelFormatDrawers
 	{
 	public:
@@ -136,12 +157,48 @@ namespace swrenderer
 		void DrawScaledFuzzColumn(const SpriteDrawerArgs& args);
 		void DrawUnscaledFuzzColumn(const SpriteDrawerArgs& args);
 
-		template<typename DrawerT> void DrawWallColumns(const WallDrawerArgs& args);
+		struct WallColumn
+		{
+			int x, y1, y2;
+			float light;
+			uint32_t texelX, texelY, texelStepX, texelStepY;
+		};
+
+		template<typename DrawerT> void DrawWallColumns(const WallDrawerArgs& args, WallDrawer8Func draw8);
+		template<typename DrawerT> void DrawWallColumnBatch(const WallColumn *columns, int count, int shade, WallDrawer8Func draw8);
 		template<typename DrawerT> void DrawWallColumn32(WallColumnDrawerArgs& drawerargs, int x, int y1, int y2, uint32_t texelX, uint32_t texelY, uint32_t texelStepX, uint32_t texelStepY);
+		void SetupWallColumn32(WallColumnDrawerArgs& drawerargs, int x, int y1, int y2, uint32_t texelX, uint32_t texelY, uint32_t texelStepX, uint32_t texelStepY);
 
 		WallColumnDrawerArgs wallcolargs;
 	};
 
+#ifndef NO_SSE
+	typedef void(*SpanDrawer32Func)(const SpanDrawerArgs &args);
+
+	// Span and wall drawers in r_draw_rgba_avx2.cpp, the only file compiled with AVX2
+	// enabled. They may only be called once it is known that the CPU supports AVX2.
+	//
+	// The wall drawers shade a row of eight columns at a time, which DrawWallColumns
+	// collects for walls without dynamic lights. The sprite and sky drawers step down a
+	// single column with the pitch as stride and have no AVX2 versions.
+	void DrawSpan32AVX2(const SpanDrawerArgs &args);
+	void DrawSpanMasked32AVX2(const SpanDrawerArgs &args);
+	void DrawSpanTranslucent32AVX2(const SpanDrawerArgs &args);
+	void DrawSpanAddClamp32AVX2(const SpanDrawerArgs &args);
+	void DrawWall8AVX2(const WallColumns8 &columns);
+	void DrawWallMasked8AVX2(const WallColumns8 &columns);
+	void DrawWallAddClamp8AVX2(const WallColumns8 &columns);
+	void DrawWallSubClamp8AVX2(const WallColumns8 &columns);
+	void DrawWallRevSubClamp8AVX2(const WallColumns8 &columns);
+
+	// The C++ span drawers from r_draw_span32.h, built in r_draw_span32_cpp.cpp for the
+	// drawer benchmark (r_drawerbench).
+	void DrawSpan32Cpp(const SpanDrawerArgs &args);
+	void DrawSpanMasked32Cpp(const SpanDrawerArgs &args);
+	void DrawSpanTranslucent32Cpp(const SpanDrawerArgs &args);
+	void DrawSpanAddClamp32Cpp(const SpanDrawerArgs &args);
+#endif
+
 	/////////////////////////////////////////////////////////////////////////////
 	// Pixel shading inline functions:
 
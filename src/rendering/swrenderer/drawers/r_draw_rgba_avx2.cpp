@@ -0,0 +1,103 @@
+/*
+**  AVX2 span and wall drawers
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+// Only the drawers themselves are compiled for AVX2. Building the whole file with
+// -mavx2 or /arch:AVX2 would also apply to the inline functions from the engine
+// headers, and the linker is free to keep those copies for the rest of the program.
+// SWTruecolorDrawers checks the CPU before calling anything here.
+
+#ifndef NO_SSE
+
+#include "doomdef.h"
+#include "v_video.h"
+#include "swrenderer/textures/r_swtexture.h"
+#include "swrenderer/r_renderthread.h"
+#include "r_draw_rgba.h"
+#include "swrenderer/viewport/r_viewport.h"
+#include "r_draw_span32_sse2.h"
+#include "r_draw_wall32_sse2.h"
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "r_draw_span32_avx2.h"
+#include "r_draw_wall32_avx2.h"
+
+namespace swrenderer
+{
+	void DrawSpan32AVX2(const SpanDrawerArgs &args)
+	{
+		DrawSpan32AVX2Command::DrawColumn(args);
+	}
+
+	void DrawSpanMasked32AVX2(const SpanDrawerArgs &args)
+	{
+		DrawSpanMasked32AVX2Command::DrawColumn(args);
+	}
+
+	void DrawSpanTranslucent32AVX2(const SpanDrawerArgs &args)
+	{
+		DrawSpanTranslucent32AVX2Command::DrawColumn(args);
+	}
+
+	void DrawSpanAddClamp32AVX2(const SpanDrawerArgs &args)
+	{
+		DrawSpanAddClamp32AVX2Command::DrawColumn(args);
+	}
+
+	void DrawWall8AVX2(const WallColumns8 &columns)
+	{
+		DrawWall32AVX2Command::DrawColumns(columns);
+	}
+
+	void DrawWallMasked8AVX2(const WallColumns8 &columns)
+	{
+		DrawWallMasked32AVX2Command::DrawColumns(columns);
+	}
+
+	void DrawWallAddClamp8AVX2(const WallColumns8 &columns)
+	{
+		DrawWallAddClamp32AVX2Command::DrawColumns(columns);
+	}
+
+	void DrawWallSubClamp8AVX2(const WallColumns8 &columns)
+	{
+		DrawWallSubClamp32AVX2Command::DrawColumns(columns);
+	}
+
+	void DrawWallRevSubClamp8AVX2(const WallColumns8 &columns)
+	{
+		DrawWallRevSubClamp32AVX2Command::DrawColumns(columns);
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
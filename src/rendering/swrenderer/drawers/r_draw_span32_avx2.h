@@ -0,0 +1,540 @@
+/*
+**  Drawer commands for spans, AVX2 version
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw_span32_sse2.h"
+#include "swrenderer/viewport/r_spandrawer.h"
+
+// Altered from r_draw_span32_sse2.h to shade eight pixels per iteration with gathered
+// texture fetches. Only include this from r_draw_rgba_avx2.cpp, where it is compiled
+// with AVX2 enabled.
+//
+// The 16 bit per channel math works on two registers: 'lo' holds pixels 0, 1, 4 and 5
+// and 'hi' holds pixels 2, 3, 6 and 7, the order _mm256_unpacklo/hi_epi8 produce and
+// _mm256_packus_epi16 puts back together.
+//
+// The output must stay bit identical to the SSE2 drawer, so walls, sprites and flats all
+// shade the same. That includes its desaturation channel order, which scales alpha by
+// 256 - desaturate and leaves blue at 256 (the C++ drawer does it the other way round).
+
+namespace swrenderer
+{
+	template<typename BlendT>
+	class DrawSpan32AVX2T
+	{
+	public:
+		struct TextureData
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t xone;
+			uint32_t yone;
+			uint32_t xstep;
+			uint32_t ystep;
+			uint32_t xfrac;
+			uint32_t yfrac;
+			const uint32_t *source;
+		};
+
+		struct ShadeData
+		{
+			__m256i mlight;
+			__m256i inv_desaturate;
+			__m256i shade_fade;
+			__m256i shade_light;
+			__m256i desaturate;
+			const DrawerLight *lights;
+			int num_lights;
+			uint32_t srcalpha;
+			uint32_t destalpha;
+		};
+
+		static void DrawColumn(const SpanDrawerArgs& args)
+		{
+			using namespace DrawSpan32TModes;
+
+			TextureData texdata;
+			texdata.width = args.TextureWidth();
+			texdata.height = args.TextureHeight();
+			texdata.xstep = args.TextureUStep();
+			texdata.ystep = args.TextureVStep();
+			texdata.xfrac = args.TextureUPos();
+			texdata.yfrac = args.TextureVPos();
+
+			texdata.source = (const uint32_t*)args.TexturePixels();
+
+			double lod = args.TextureLOD();
+			bool mipmapped = args.MipmappedTexture();
+
+			bool magnifying = lod < 0.0;
+			if (r_mipmap && mipmapped)
+			{
+				int level = (int)lod;
+				while (level > 0)
+				{
+					if (texdata.width <= 2 || texdata.height <= 2)
+						break;
+
+					texdata.source += texdata.width * texdata.height;
+					texdata.width = max<uint32_t>(texdata.width / 2, 1);
+					texdata.height = max<uint32_t>(texdata.height / 2, 1);
+					level--;
+				}
+			}
+
+			texdata.xone = (0x80000000u / texdata.width) << 1;
+			texdata.yone = (0x80000000u / texdata.height) << 1;
+
+			bool is_nearest_filter = (magnifying && !r_magfilter) || (!magnifying && !r_minfilter);
+			bool is_64x64 = texdata.width == 64 && texdata.height == 64;
+
+			auto shade_constants = args.ColormapConstants();
+			if (shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<SimpleShade, NearestFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<SimpleShade, NearestFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<SimpleShade, LinearFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<SimpleShade, LinearFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+			}
+			else
+			{
+				if (is_nearest_filter)
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, NearestFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, NearestFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+				else
+				{
+					if (is_64x64)
+						Loop<AdvancedShade, LinearFilter, TextureSize64x64>(args, texdata, shade_constants);
+					else
+						Loop<AdvancedShade, LinearFilter, TextureSizeAny>(args, texdata, shade_constants);
+				}
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT, typename TextureSizeT>
+		FORCEINLINE static void VECTORCALL Loop(const SpanDrawerArgs& args, TextureData texdata, ShadeConstants shade_constants)
+		{
+			using namespace DrawSpan32TModes;
+
+			// Shade constants
+			ShadeData shade;
+			int light = 256 - (args.Light() >> (FRACBITS - 8));
+			shade.mlight = Channels(256, light, light, light);
+			__m256i inv_light = Channels(0, 256 - light, 256 - light, 256 - light);
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				int inv_desaturate = 256 - shade_constants.desaturate;
+				shade.inv_desaturate = Channels(inv_desaturate, inv_desaturate, inv_desaturate, 256);
+				shade.shade_fade = Channels(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade.shade_fade = _mm256_mullo_epi16(shade.shade_fade, inv_light);
+				shade.shade_light = Channels(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue);
+				shade.desaturate = _mm256_set1_epi32(shade_constants.desaturate);
+			}
+			else
+			{
+				shade.inv_desaturate = _mm256_setzero_si256();
+				shade.shade_fade = _mm256_setzero_si256();
+				shade.shade_light = _mm256_setzero_si256();
+				shade.desaturate = _mm256_setzero_si256();
+			}
+
+			shade.lights = args.dc_lights;
+			shade.num_lights = args.dc_num_lights;
+			shade.srcalpha = args.SrcAlpha() >> (FRACBITS - 8);
+			shade.destalpha = args.DestAlpha() >> (FRACBITS - 8);
+
+			__m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+			float vpx = args.dc_viewpos.X;
+			float stepvpx = args.dc_viewpos_step.X;
+			__m256 viewpos_x = _mm256_add_ps(_mm256_set1_ps(vpx), _mm256_mul_ps(_mm256_cvtepi32_ps(lane), _mm256_set1_ps(stepvpx)));
+			__m256 step_viewpos_x = _mm256_set1_ps(stepvpx * 8.0f);
+
+			int count = args.DestX2() - args.DestX1() + 1;
+			uint32_t *dest = (uint32_t*)args.Viewport()->GetDest(args.DestX1(), args.DestY());
+
+			if (FilterModeT::Mode == (int)FilterModes::Linear)
+			{
+				texdata.xfrac -= texdata.xone / 2;
+				texdata.yfrac -= texdata.yone / 2;
+			}
+
+			// Same wrap around as stepping one pixel at a time
+			__m256i xfrac = _mm256_add_epi32(_mm256_set1_epi32(texdata.xfrac), _mm256_mullo_epi32(lane, _mm256_set1_epi32(texdata.xstep)));
+			__m256i yfrac = _mm256_add_epi32(_mm256_set1_epi32(texdata.yfrac), _mm256_mullo_epi32(lane, _mm256_set1_epi32(texdata.ystep)));
+			__m256i xstep = _mm256_set1_epi32(texdata.xstep * 8);
+			__m256i ystep = _mm256_set1_epi32(texdata.ystep * 8);
+
+			int avxcount = count / 8;
+			for (int index = 0; index < avxcount; index++)
+			{
+				int offset = index * 8;
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+					bgcolor = _mm256_loadu_si256((const __m256i*)(dest + offset));
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i ifgcolor = Sample<FilterModeT, TextureSizeT>(texdata, xfrac, yfrac);
+				xfrac = _mm256_add_epi32(xfrac, xstep);
+				yfrac = _mm256_add_epi32(yfrac, ystep);
+
+				__m256i fgcolor_lo, fgcolor_hi;
+				Shade<ShadeModeT>(ifgcolor, shade, viewpos_x, fgcolor_lo, fgcolor_hi);
+				__m256i outcolor = Blend(fgcolor_lo, fgcolor_hi, bgcolor, ifgcolor, shade);
+
+				_mm256_storeu_si256((__m256i*)(dest + offset), outcolor);
+				viewpos_x = _mm256_add_ps(viewpos_x, step_viewpos_x);
+			}
+
+			if (avxcount * 8 != count)
+			{
+				int offset = avxcount * 8;
+
+				// Texture coordinates always wrap, so the lanes past the end can still be sampled
+				__m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - offset), lane);
+
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)SpanBlendModes::Opaque)
+					bgcolor = _mm256_maskload_epi32((const int*)(dest + offset), mask);
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i ifgcolor = Sample<FilterModeT, TextureSizeT>(texdata, xfrac, yfrac);
+
+				__m256i fgcolor_lo, fgcolor_hi;
+				Shade<ShadeModeT>(ifgcolor, shade, viewpos_x, fgcolor_lo, fgcolor_hi);
+				__m256i outcolor = Blend(fgcolor_lo, fgcolor_hi, bgcolor, ifgcolor, shade);
+
+				_mm256_maskstore_epi32((int*)(dest + offset), mask, outcolor);
+			}
+		}
+
+		// The same value in all four pixels, 16 bits per channel
+		FORCEINLINE static __m256i Channels(int alpha, int red, int green, int blue)
+		{
+			return _mm256_set1_epi64x(((uint64_t)(uint16_t)alpha << 48) | ((uint64_t)(uint16_t)red << 32) | ((uint64_t)(uint16_t)green << 16) | (uint64_t)(uint16_t)blue);
+		}
+
+		// Spreads the low 16 bits of a 32 bit value per pixel over the channels of the lo or hi pixels
+		FORCEINLINE static __m256i VECTORCALL SplatLo(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5, 0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL SplatHi(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13, 8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13));
+		}
+
+		// Same as SplatLo and SplatHi, but leaves the alpha channel zero
+		FORCEINLINE static __m256i VECTORCALL SplatLoRGB(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(0, 1, 0, 1, 0, 1, -128, -128, 4, 5, 4, 5, 4, 5, -128, -128, 0, 1, 0, 1, 0, 1, -128, -128, 4, 5, 4, 5, 4, 5, -128, -128));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL SplatHiRGB(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(8, 9, 8, 9, 8, 9, -128, -128, 12, 13, 12, 13, 12, 13, -128, -128, 8, 9, 8, 9, 8, 9, -128, -128, 12, 13, 12, 13, 12, 13, -128, -128));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Gather(const uint32_t *source, __m256i index)
+		{
+			return _mm256_i32gather_epi32((const int*)source, index, 4);
+		}
+
+		template<typename FilterModeT, typename TextureSizeT>
+		FORCEINLINE static __m256i VECTORCALL Sample(const TextureData &texdata, __m256i xfrac, __m256i yfrac)
+		{
+			using namespace DrawSpan32TModes;
+
+			if (FilterModeT::Mode == (int)FilterModes::Nearest && TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+			{
+				__m256i x = _mm256_and_si256(_mm256_srli_epi32(xfrac, 32 - 6 - 6), _mm256_set1_epi32(63 * 64));
+				__m256i y = _mm256_srli_epi32(yfrac, 32 - 6);
+				return Gather(texdata.source, _mm256_add_epi32(x, y));
+			}
+			else if (FilterModeT::Mode == (int)FilterModes::Nearest)
+			{
+				__m256i width = _mm256_set1_epi32(texdata.width);
+				__m256i height = _mm256_set1_epi32(texdata.height);
+				__m256i x = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(xfrac, 16), width), 16);
+				__m256i y = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(yfrac, 16), height), 16);
+				return Gather(texdata.source, _mm256_add_epi32(_mm256_mullo_epi32(x, height), y));
+			}
+			else
+			{
+				__m256i p00, p01, p10, p11;
+				__m256i frac_x, frac_y;
+				if (TextureSizeT::Mode == (int)SpanTextureSize::Size64x64)
+				{
+					__m256i mask = _mm256_set1_epi32(0x3f);
+					frac_x = _mm256_slli_epi32(_mm256_srli_epi32(xfrac, 16), 6);
+					frac_y = _mm256_slli_epi32(_mm256_srli_epi32(yfrac, 16), 6);
+					__m256i x0 = _mm256_srli_epi32(frac_x, 16);
+					__m256i y0 = _mm256_srli_epi32(frac_y, 16);
+					__m256i x1 = _mm256_and_si256(_mm256_add_epi32(x0, _mm256_set1_epi32(1)), mask);
+					__m256i y1 = _mm256_and_si256(_mm256_add_epi32(y0, _mm256_set1_epi32(1)), mask);
+					x0 = _mm256_slli_epi32(x0, 6);
+					x1 = _mm256_slli_epi32(x1, 6);
+					p00 = Gather(texdata.source, _mm256_add_epi32(y0, x0));
+					p01 = Gather(texdata.source, _mm256_add_epi32(y1, x0));
+					p10 = Gather(texdata.source, _mm256_add_epi32(y0, x1));
+					p11 = Gather(texdata.source, _mm256_add_epi32(y1, x1));
+				}
+				else
+				{
+					__m256i width = _mm256_set1_epi32(texdata.width);
+					__m256i height = _mm256_set1_epi32(texdata.height);
+					frac_x = _mm256_mullo_epi32(_mm256_srli_epi32(xfrac, 16), width);
+					frac_y = _mm256_mullo_epi32(_mm256_srli_epi32(yfrac, 16), height);
+					__m256i x0 = _mm256_srli_epi32(frac_x, 16);
+					__m256i y0 = _mm256_srli_epi32(frac_y, 16);
+					__m256i x1 = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(_mm256_add_epi32(xfrac, _mm256_set1_epi32(texdata.xone)), 16), width), 16);
+					__m256i y1 = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(_mm256_add_epi32(yfrac, _mm256_set1_epi32(texdata.yone)), 16), height), 16);
+					x0 = _mm256_mullo_epi32(x0, height);
+					x1 = _mm256_mullo_epi32(x1, height);
+					p00 = Gather(texdata.source, _mm256_add_epi32(y0, x0));
+					p01 = Gather(texdata.source, _mm256_add_epi32(y1, x0));
+					p10 = Gather(texdata.source, _mm256_add_epi32(y0, x1));
+					p11 = Gather(texdata.source, _mm256_add_epi32(y1, x1));
+				}
+
+				__m256i m15 = _mm256_set1_epi32(15);
+				__m256i m16 = _mm256_set1_epi32(16);
+				__m256i inv_b = _mm256_and_si256(_mm256_srli_epi32(frac_x, 12), m15);
+				__m256i inv_a = _mm256_and_si256(_mm256_srli_epi32(frac_y, 12), m15);
+				__m256i a = _mm256_sub_epi32(m16, inv_a);
+				__m256i b = _mm256_sub_epi32(m16, inv_b);
+
+				// The weights add up to 256, so every channel fits in 16 bits
+				__m256i w00 = _mm256_mullo_epi16(a, b);
+				__m256i w01 = _mm256_mullo_epi16(inv_a, b);
+				__m256i w10 = _mm256_mullo_epi16(a, inv_b);
+				__m256i w11 = _mm256_mullo_epi16(inv_a, inv_b);
+
+				__m256i lo = Bilinear(_mm256_unpacklo_epi8(p00, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p01, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p10, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p11, _mm256_setzero_si256()), SplatLo(w00), SplatLo(w01), SplatLo(w10), SplatLo(w11));
+				__m256i hi = Bilinear(_mm256_unpackhi_epi8(p00, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p01, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p10, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p11, _mm256_setzero_si256()), SplatHi(w00), SplatHi(w01), SplatHi(w10), SplatHi(w11));
+				return _mm256_packus_epi16(lo, hi);
+			}
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Bilinear(__m256i p00, __m256i p01, __m256i p10, __m256i p11, __m256i w00, __m256i w01, __m256i w10, __m256i w11)
+		{
+			__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(p00, w00), _mm256_mullo_epi16(p01, w01));
+			sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p10, w10));
+			sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p11, w11));
+			return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(127)), 8);
+		}
+
+		template<typename ShadeModeT>
+		FORCEINLINE static void VECTORCALL Shade(__m256i ifgcolor, const ShadeData &shade, __m256 viewpos_x, __m256i &fgcolor_lo, __m256i &fgcolor_hi)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m256i material_lo = _mm256_unpacklo_epi8(ifgcolor, _mm256_setzero_si256());
+			__m256i material_hi = _mm256_unpackhi_epi8(ifgcolor, _mm256_setzero_si256());
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fgcolor_lo = _mm256_srli_epi16(_mm256_mullo_epi16(material_lo, shade.mlight), 8);
+				fgcolor_hi = _mm256_srli_epi16(_mm256_mullo_epi16(material_hi, shade.mlight), 8);
+			}
+			else
+			{
+				// intensity = ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate
+				__m256i weights = Channels(0, 77, 143, 37);
+				__m256i intensity = _mm256_hadd_epi32(_mm256_madd_epi16(material_lo, weights), _mm256_madd_epi16(material_hi, weights));
+				intensity = _mm256_mullo_epi16(_mm256_srli_epi32(intensity, 8), shade.desaturate);
+
+				fgcolor_lo = ShadeAdvanced(material_lo, SplatLoRGB(intensity), shade);
+				fgcolor_hi = ShadeAdvanced(material_hi, SplatHiRGB(intensity), shade);
+			}
+
+			AddLights(material_lo, material_hi, fgcolor_lo, fgcolor_hi, shade, viewpos_x);
+		}
+
+		FORCEINLINE static __m256i VECTORCALL ShadeAdvanced(__m256i fgcolor, __m256i intensity, const ShadeData &shade)
+		{
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, shade.inv_desaturate), intensity), 8);
+			fgcolor = _mm256_mullo_epi16(fgcolor, shade.mlight);
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade.shade_fade, fgcolor), 8);
+			fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.shade_light), 8);
+			return fgcolor;
+		}
+
+		FORCEINLINE static void VECTORCALL AddLights(__m256i material_lo, __m256i material_hi, __m256i &fgcolor_lo, __m256i &fgcolor_hi, const ShadeData &shade, __m256 viewpos_x)
+		{
+			__m256i lit_lo = _mm256_setzero_si256();
+			__m256i lit_hi = _mm256_setzero_si256();
+
+			for (int i = 0; i != shade.num_lights; i++)
+			{
+				const DrawerLight &light = shade.lights[i];
+				__m256 light_x = _mm256_set1_ps(light.x);
+				__m256 light_y = _mm256_set1_ps(light.y);
+				__m256 light_z = _mm256_set1_ps(light.z);
+				__m256 light_radius = _mm256_set1_ps(light.radius);
+				__m256 m256 = _mm256_set1_ps(256.0f);
+
+				// L = light-pos
+				// dist = sqrt(dot(L, L))
+				// distance_attenuation = 1 - min(dist * (1/radius), 1)
+				__m256 Lyz2 = light_y; // L.y*L.y + L.z*L.z
+				__m256 Lx = _mm256_sub_ps(light_x, viewpos_x);
+				__m256 dist2 = _mm256_add_ps(Lyz2, _mm256_mul_ps(Lx, Lx));
+				__m256 rcp_dist = _mm256_rsqrt_ps(dist2);
+				__m256 dist = _mm256_mul_ps(dist2, rcp_dist);
+				__m256 distance_attenuation = _mm256_sub_ps(m256, _mm256_min_ps(_mm256_mul_ps(dist, light_radius), m256));
+
+				// The simple light type
+				__m256 simple_attenuation = distance_attenuation;
+
+				// The point light type
+				// diffuse = dot(N,L) * attenuation
+				__m256 point_attenuation = _mm256_mul_ps(_mm256_mul_ps(light_z, rcp_dist), distance_attenuation);
+
+				__m256 is_attenuated = _mm256_cmp_ps(light_z, _mm256_setzero_ps(), _CMP_EQ_OQ);
+				__m256i attenuation = _mm256_cvtps_epi32(_mm256_blendv_ps(point_attenuation, simple_attenuation, is_attenuated));
+
+				__m256i light_color = Channels(APART(light.color), RPART(light.color), GPART(light.color), BPART(light.color));
+
+				lit_lo = _mm256_add_epi16(lit_lo, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, SplatLo(attenuation)), 8));
+				lit_hi = _mm256_add_epi16(lit_hi, _mm256_srli_epi16(_mm256_mullo_epi16(light_color, SplatHi(attenuation)), 8));
+			}
+
+			lit_lo = _mm256_min_epi16(lit_lo, _mm256_set1_epi16(256));
+			lit_hi = _mm256_min_epi16(lit_hi, _mm256_set1_epi16(256));
+
+			fgcolor_lo = _mm256_add_epi16(fgcolor_lo, _mm256_srli_epi16(_mm256_mullo_epi16(material_lo, lit_lo), 8));
+			fgcolor_hi = _mm256_add_epi16(fgcolor_hi, _mm256_srli_epi16(_mm256_mullo_epi16(material_hi, lit_hi), 8));
+			fgcolor_lo = _mm256_min_epi16(fgcolor_lo, _mm256_set1_epi16(255));
+			fgcolor_hi = _mm256_min_epi16(fgcolor_hi, _mm256_set1_epi16(255));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Blend(__m256i fgcolor_lo, __m256i fgcolor_hi, __m256i bgcolor, __m256i ifgcolor, const ShadeData &shade)
+		{
+			using namespace DrawSpan32TModes;
+
+			__m256i alphamask = _mm256_set1_epi32(0xff000000);
+
+			if (BlendT::Mode == (int)SpanBlendModes::Opaque)
+			{
+				return _mm256_or_si256(_mm256_packus_epi16(fgcolor_lo, fgcolor_hi), alphamask);
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::Masked)
+			{
+				__m256i fgcolor = _mm256_packus_epi16(fgcolor_lo, fgcolor_hi);
+				__m256i mask = _mm256_cmpeq_epi32(fgcolor, _mm256_setzero_si256());
+				return _mm256_or_si256(_mm256_blendv_epi8(fgcolor, bgcolor, mask), alphamask);
+			}
+			else
+			{
+				__m256i fgalpha_lo, fgalpha_hi, bgalpha_lo, bgalpha_hi;
+				if (BlendT::Mode == (int)SpanBlendModes::Translucent)
+				{
+					fgalpha_lo = fgalpha_hi = _mm256_set1_epi16(shade.srcalpha);
+					bgalpha_lo = bgalpha_hi = _mm256_set1_epi16(shade.destalpha);
+				}
+				else
+				{
+					__m256i alpha = _mm256_srli_epi32(ifgcolor, 24);
+					alpha = _mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 7)); // 255->256
+					__m256i inv_alpha = _mm256_sub_epi32(_mm256_set1_epi32(256), alpha);
+					__m256i m128 = _mm256_set1_epi32(128);
+
+					__m256i bgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(shade.destalpha), alpha);
+					bgalpha = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bgalpha, _mm256_slli_epi32(inv_alpha, 8)), m128), 8);
+					__m256i fgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(shade.srcalpha), alpha);
+					fgalpha = _mm256_srli_epi32(_mm256_add_epi32(fgalpha, m128), 8);
+
+					fgalpha_lo = SplatLo(fgalpha);
+					fgalpha_hi = SplatHi(fgalpha);
+					bgalpha_lo = SplatLo(bgalpha);
+					bgalpha_hi = SplatHi(bgalpha);
+				}
+
+				__m256i out_lo = BlendChannels(fgcolor_lo, _mm256_unpacklo_epi8(bgcolor, _mm256_setzero_si256()), fgalpha_lo, bgalpha_lo);
+				__m256i out_hi = BlendChannels(fgcolor_hi, _mm256_unpackhi_epi8(bgcolor, _mm256_setzero_si256()), fgalpha_hi, bgalpha_hi);
+				return _mm256_or_si256(_mm256_packus_epi16(out_lo, out_hi), alphamask);
+			}
+		}
+
+		FORCEINLINE static __m256i VECTORCALL BlendChannels(__m256i fgcolor, __m256i bgcolor, __m256i fgalpha, __m256i bgalpha)
+		{
+			using namespace DrawSpan32TModes;
+
+			fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+			bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+			__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+			__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+			__m256i out_lo, out_hi;
+			if (BlendT::Mode == (int)SpanBlendModes::SubClamp)
+			{
+				out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+			}
+			else if (BlendT::Mode == (int)SpanBlendModes::RevSubClamp)
+			{
+				out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+				out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+			}
+			else
+			{
+				out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+			}
+
+			out_lo = _mm256_srai_epi32(out_lo, 8);
+			out_hi = _mm256_srai_epi32(out_hi, 8);
+			return _mm256_packs_epi32(out_lo, out_hi);
+		}
+	};
+
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::OpaqueSpan> DrawSpan32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::MaskedSpan> DrawSpanMasked32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::TranslucentSpan> DrawSpanTranslucent32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::AddClampSpan> DrawSpanAddClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::SubClampSpan> DrawSpanSubClamp32AVX2Command;
+	typedef DrawSpan32AVX2T<DrawSpan32TModes::RevSubClampSpan> DrawSpanRevSubClamp32AVX2Command;
+}
@@ -0,0 +1,66 @@
+/*
+**  C++ span drawers for the drawer benchmark
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+// The C++ span drawers are only built when NO_SSE is defined, which leaves r_drawerbench
+// nothing to check the SSE2 and AVX2 drawers against. This file builds them a second time
+// under their own names so the benchmark can run all three on the same span.
+
+#ifndef NO_SSE
+
+#include "doomdef.h"
+#include "v_video.h"
+#include "swrenderer/textures/r_swtexture.h"
+#include "swrenderer/r_renderthread.h"
+#include "r_draw_rgba.h"
+#include "swrenderer/viewport/r_viewport.h"
+
+// r_draw_span32_sse2.h uses the same names in the rest of the renderer
+#define DrawSpan32T DrawSpan32CppT
+#define DrawSpan32TModes DrawSpan32CppTModes
+#include "r_draw_span32.h"
+#undef DrawSpan32T
+#undef DrawSpan32TModes
+
+namespace swrenderer
+{
+	void DrawSpan32Cpp(const SpanDrawerArgs &args)
+	{
+		DrawSpan32Command::DrawColumn(args);
+	}
+
+	void DrawSpanMasked32Cpp(const SpanDrawerArgs &args)
+	{
+		DrawSpanMasked32Command::DrawColumn(args);
+	}
+
+	void DrawSpanTranslucent32Cpp(const SpanDrawerArgs &args)
+	{
+		DrawSpanTranslucent32Command::DrawColumn(args);
+	}
+
+	void DrawSpanAddClamp32Cpp(const SpanDrawerArgs &args)
+	{
+		DrawSpanAddClamp32Command::DrawColumn(args);
+	}
+}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+**  Drawer commands for walls, AVX2 version
+**  Copyright (c) 2016 Magnus Norddahl
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+*/
+
+#pragma once
+
+#include "swrenderer/drawers/r_draw_rgba.h"
+#include "swrenderer/drawers/r_draw_wall32_sse2.h"
+
+// Altered from r_draw_wall32_sse2.h to shade one row of eight neighbouring columns per
+// iteration, so the destination is read and written eight pixels at a time. Each lane
+// has its own texture column, light and texture coordinates. Only include this from
+// r_draw_rgba_avx2.cpp, where it is compiled with AVX2 enabled.
+//
+// Dynamic lights are not supported, DrawWallColumns only batches walls without them.
+// Everything else must stay bit identical to the SSE2 drawer.
+//
+// As in r_draw_span32_avx2.h, 'lo' holds pixels 0, 1, 4 and 5 with 16 bits per channel
+// and 'hi' holds pixels 2, 3, 6 and 7.
+
+namespace swrenderer
+{
+	template<typename BlendT>
+	class DrawWall32AVX2T
+	{
+	public:
+		struct ShadeData
+		{
+			__m256i mlight_lo, mlight_hi;
+			__m256i inv_desaturate;
+			__m256i shade_fade_lo, shade_fade_hi;
+			__m256i shade_light;
+			__m256i desaturate;
+			uint32_t srcalpha;
+			uint32_t destalpha;
+		};
+
+		struct TextureData
+		{
+			const uint32_t *base;	// all lanes index from the first column
+			__m256i offset;
+			__m256i offset2;
+			__m256i height;
+			__m256i one;
+			__m256i texturefracx;
+		};
+
+		static void DrawColumns(const WallColumns8 &columns)
+		{
+			using namespace DrawWall32TModes;
+
+			bool is_nearest_filter = (columns.source2[0] == nullptr);
+			if (columns.shade_constants.simple_shade)
+			{
+				if (is_nearest_filter)
+					Loop<SimpleShade, NearestFilter>(columns);
+				else
+					Loop<SimpleShade, LinearFilter>(columns);
+			}
+			else
+			{
+				if (is_nearest_filter)
+					Loop<AdvancedShade, NearestFilter>(columns);
+				else
+					Loop<AdvancedShade, LinearFilter>(columns);
+			}
+		}
+
+		template<typename ShadeModeT, typename FilterModeT>
+		FORCEINLINE static void VECTORCALL Loop(const WallColumns8 &columns)
+		{
+			using namespace DrawWall32TModes;
+
+			// The columns come from the mipmaps of a single texture, so the lanes can gather
+			// relative to the first one
+			TextureData texdata;
+			texdata.base = columns.source[0];
+			int32_t offset[8], offset2[8];
+			uint32_t one[8], frac[8];
+			for (int i = 0; i < 8; i++)
+			{
+				uint32_t textureheight = columns.textureheight[i];
+				offset[i] = (int32_t)(columns.source[i] - texdata.base);
+				offset2[i] = FilterModeT::Mode == (int)FilterModes::Linear ? (int32_t)(columns.source2[i] - texdata.base) : 0;
+				one[i] = ((0x80000000 + textureheight - 1) / textureheight) * 2 + 1;
+				frac[i] = columns.texturefrac[i];
+				if (FilterModeT::Mode == (int)FilterModes::Linear)
+					frac[i] -= one[i] / 2;
+			}
+			texdata.offset = _mm256_loadu_si256((const __m256i*)offset);
+			texdata.offset2 = _mm256_loadu_si256((const __m256i*)offset2);
+			texdata.height = _mm256_loadu_si256((const __m256i*)columns.textureheight);
+			texdata.one = _mm256_loadu_si256((const __m256i*)one);
+			texdata.texturefracx = _mm256_loadu_si256((const __m256i*)columns.texturefracx);
+
+			// Shade constants
+			const ShadeConstants &shade_constants = columns.shade_constants;
+			__m256i light = _mm256_sub_epi32(_mm256_set1_epi32(256), _mm256_srai_epi32(_mm256_loadu_si256((const __m256i*)columns.light), FRACBITS - 8));
+			__m256i inv_light = _mm256_sub_epi32(_mm256_set1_epi32(256), light);
+
+			ShadeData shade;
+			shade.mlight_lo = _mm256_add_epi16(SplatLoRGB(light), Channels(256, 0, 0, 0));
+			shade.mlight_hi = _mm256_add_epi16(SplatHiRGB(light), Channels(256, 0, 0, 0));
+
+			if (ShadeModeT::Mode == (int)ShadeMode::Advanced)
+			{
+				int inv_desaturate = 256 - shade_constants.desaturate;
+				shade.inv_desaturate = Channels(inv_desaturate, inv_desaturate, inv_desaturate, 256);
+				__m256i shade_fade = Channels(shade_constants.fade_alpha, shade_constants.fade_red, shade_constants.fade_green, shade_constants.fade_blue);
+				shade.shade_fade_lo = _mm256_mullo_epi16(shade_fade, SplatLoRGB(inv_light));
+				shade.shade_fade_hi = _mm256_mullo_epi16(shade_fade, SplatHiRGB(inv_light));
+				shade.shade_light = Channels(shade_constants.light_alpha, shade_constants.light_red, shade_constants.light_green, shade_constants.light_blue);
+				shade.desaturate = _mm256_set1_epi32(shade_constants.desaturate);
+			}
+			else
+			{
+				shade.inv_desaturate = _mm256_setzero_si256();
+				shade.shade_fade_lo = _mm256_setzero_si256();
+				shade.shade_fade_hi = _mm256_setzero_si256();
+				shade.shade_light = _mm256_setzero_si256();
+				shade.desaturate = _mm256_setzero_si256();
+			}
+
+			shade.srcalpha = columns.srcalpha >> (FRACBITS - 8);
+			shade.destalpha = columns.destalpha >> (FRACBITS - 8);
+
+			__m256i texturefrac = _mm256_loadu_si256((const __m256i*)frac);
+			__m256i fracstep = _mm256_loadu_si256((const __m256i*)columns.iscale);
+
+			int count = columns.count;
+			int pitch = columns.pitch;
+			uint32_t *dest = columns.dest;
+			for (int index = 0; index < count; index++)
+			{
+				__m256i bgcolor;
+				if (BlendT::Mode != (int)WallBlendModes::Opaque)
+					bgcolor = _mm256_loadu_si256((const __m256i*)dest);
+				else
+					bgcolor = _mm256_setzero_si256();
+
+				__m256i ifgcolor = Sample<FilterModeT>(texdata, texturefrac);
+				texturefrac = _mm256_add_epi32(texturefrac, fracstep);
+
+				__m256i fgcolor_lo, fgcolor_hi;
+				Shade<ShadeModeT>(ifgcolor, shade, fgcolor_lo, fgcolor_hi);
+				__m256i outcolor = Blend(fgcolor_lo, fgcolor_hi, bgcolor, ifgcolor, shade);
+
+				_mm256_storeu_si256((__m256i*)dest, outcolor);
+				dest += pitch;
+			}
+		}
+
+		// The same value in all four pixels, 16 bits per channel
+		FORCEINLINE static __m256i Channels(int alpha, int red, int green, int blue)
+		{
+			return _mm256_set1_epi64x(((uint64_t)(uint16_t)alpha << 48) | ((uint64_t)(uint16_t)red << 32) | ((uint64_t)(uint16_t)green << 16) | (uint64_t)(uint16_t)blue);
+		}
+
+		// Spreads the low 16 bits of a 32 bit value per pixel over the channels of the lo or hi pixels
+		FORCEINLINE static __m256i VECTORCALL SplatLo(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5, 0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL SplatHi(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13, 8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13));
+		}
+
+		// Same as SplatLo and SplatHi, but leaves the alpha channel zero
+		FORCEINLINE static __m256i VECTORCALL SplatLoRGB(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(0, 1, 0, 1, 0, 1, -128, -128, 4, 5, 4, 5, 4, 5, -128, -128, 0, 1, 0, 1, 0, 1, -128, -128, 4, 5, 4, 5, 4, 5, -128, -128));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL SplatHiRGB(__m256i value)
+		{
+			return _mm256_shuffle_epi8(value, _mm256_setr_epi8(8, 9, 8, 9, 8, 9, -128, -128, 12, 13, 12, 13, 12, 13, -128, -128, 8, 9, 8, 9, 8, 9, -128, -128, 12, 13, 12, 13, 12, 13, -128, -128));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Gather(const uint32_t *source, __m256i index)
+		{
+			return _mm256_i32gather_epi32((const int*)source, index, 4);
+		}
+
+		template<typename FilterModeT>
+		FORCEINLINE static __m256i VECTORCALL Sample(const TextureData &texdata, __m256i frac)
+		{
+			using namespace DrawWall32TModes;
+
+			if (FilterModeT::Mode == (int)FilterModes::Nearest)
+			{
+				__m256i y = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(frac, FRACBITS), texdata.height), FRACBITS);
+				return Gather(texdata.base, _mm256_add_epi32(texdata.offset, y));
+			}
+			else
+			{
+				__m256i frac_y0 = _mm256_mullo_epi32(_mm256_srli_epi32(frac, FRACBITS), texdata.height);
+				__m256i frac_y1 = _mm256_mullo_epi32(_mm256_srli_epi32(_mm256_add_epi32(frac, texdata.one), FRACBITS), texdata.height);
+				__m256i y0 = _mm256_srli_epi32(frac_y0, FRACBITS);
+				__m256i y1 = _mm256_srli_epi32(frac_y1, FRACBITS);
+
+				__m256i p00 = Gather(texdata.base, _mm256_add_epi32(texdata.offset, y0));
+				__m256i p01 = Gather(texdata.base, _mm256_add_epi32(texdata.offset, y1));
+				__m256i p10 = Gather(texdata.base, _mm256_add_epi32(texdata.offset2, y0));
+				__m256i p11 = Gather(texdata.base, _mm256_add_epi32(texdata.offset2, y1));
+
+				__m256i m16 = _mm256_set1_epi32(16);
+				__m256i inv_b = texdata.texturefracx;
+				__m256i inv_a = _mm256_and_si256(_mm256_srli_epi32(frac_y1, FRACBITS - 4), _mm256_set1_epi32(15));
+				__m256i a = _mm256_sub_epi32(m16, inv_a);
+				__m256i b = _mm256_sub_epi32(m16, inv_b);
+
+				// The weights add up to 256, so every channel fits in 16 bits
+				__m256i w00 = _mm256_mullo_epi16(a, b);
+				__m256i w01 = _mm256_mullo_epi16(inv_a, b);
+				__m256i w10 = _mm256_mullo_epi16(a, inv_b);
+				__m256i w11 = _mm256_mullo_epi16(inv_a, inv_b);
+
+				__m256i lo = Bilinear(_mm256_unpacklo_epi8(p00, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p01, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p10, _mm256_setzero_si256()), _mm256_unpacklo_epi8(p11, _mm256_setzero_si256()), SplatLo(w00), SplatLo(w01), SplatLo(w10), SplatLo(w11));
+				__m256i hi = Bilinear(_mm256_unpackhi_epi8(p00, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p01, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p10, _mm256_setzero_si256()), _mm256_unpackhi_epi8(p11, _mm256_setzero_si256()), SplatHi(w00), SplatHi(w01), SplatHi(w10), SplatHi(w11));
+				return _mm256_packus_epi16(lo, hi);
+			}
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Bilinear(__m256i p00, __m256i p01, __m256i p10, __m256i p11, __m256i w00, __m256i w01, __m256i w10, __m256i w11)
+		{
+			__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(p00, w00), _mm256_mullo_epi16(p01, w01));
+			sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p10, w10));
+			sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(p11, w11));
+			return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(127)), 8);
+		}
+
+		template<typename ShadeModeT>
+		FORCEINLINE static void VECTORCALL Shade(__m256i ifgcolor, const ShadeData &shade, __m256i &fgcolor_lo, __m256i &fgcolor_hi)
+		{
+			using namespace DrawWall32TModes;
+
+			__m256i material_lo = _mm256_unpacklo_epi8(ifgcolor, _mm256_setzero_si256());
+			__m256i material_hi = _mm256_unpackhi_epi8(ifgcolor, _mm256_setzero_si256());
+			if (ShadeModeT::Mode == (int)ShadeMode::Simple)
+			{
+				fgcolor_lo = _mm256_srli_epi16(_mm256_mullo_epi16(material_lo, shade.mlight_lo), 8);
+				fgcolor_hi = _mm256_srli_epi16(_mm256_mullo_epi16(material_hi, shade.mlight_hi), 8);
+			}
+			else
+			{
+				// intensity = ((red * 77 + green * 143 + blue * 37) >> 8) * desaturate
+				__m256i weights = Channels(0, 77, 143, 37);
+				__m256i intensity = _mm256_hadd_epi32(_mm256_madd_epi16(material_lo, weights), _mm256_madd_epi16(material_hi, weights));
+				intensity = _mm256_mullo_epi16(_mm256_srli_epi32(intensity, 8), shade.desaturate);
+
+				fgcolor_lo = ShadeAdvanced(material_lo, SplatLoRGB(intensity), shade.mlight_lo, shade.shade_fade_lo, shade);
+				fgcolor_hi = ShadeAdvanced(material_hi, SplatHiRGB(intensity), shade.mlight_hi, shade.shade_fade_hi, shade);
+			}
+
+			// What AddLights leaves of the color without any lights
+			fgcolor_lo = _mm256_min_epi16(fgcolor_lo, _mm256_set1_epi16(255));
+			fgcolor_hi = _mm256_min_epi16(fgcolor_hi, _mm256_set1_epi16(255));
+		}
+
+		FORCEINLINE static __m256i VECTORCALL ShadeAdvanced(__m256i fgcolor, __m256i intensity, __m256i mlight, __m256i shade_fade, const ShadeData &shade)
+		{
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(fgcolor, shade.inv_desaturate), intensity), 8);
+			fgcolor = _mm256_mullo_epi16(fgcolor, mlight);
+			fgcolor = _mm256_srli_epi16(_mm256_add_epi16(shade_fade, fgcolor), 8);
+			fgcolor = _mm256_srli_epi16(_mm256_mullo_epi16(fgcolor, shade.shade_light), 8);
+			return fgcolor;
+		}
+
+		FORCEINLINE static __m256i VECTORCALL Blend(__m256i fgcolor_lo, __m256i fgcolor_hi, __m256i bgcolor, __m256i ifgcolor, const ShadeData &shade)
+		{
+			using namespace DrawWall32TModes;
+
+			__m256i alphamask = _mm256_set1_epi32(0xff000000);
+
+			if (BlendT::Mode == (int)WallBlendModes::Opaque)
+			{
+				return _mm256_or_si256(_mm256_packus_epi16(fgcolor_lo, fgcolor_hi), alphamask);
+			}
+			else if (BlendT::Mode == (int)WallBlendModes::Masked)
+			{
+				__m256i fgcolor = _mm256_packus_epi16(fgcolor_lo, fgcolor_hi);
+				__m256i mask = _mm256_cmpeq_epi32(fgcolor, _mm256_setzero_si256());
+				return _mm256_or_si256(_mm256_blendv_epi8(fgcolor, bgcolor, mask), alphamask);
+			}
+			else
+			{
+				__m256i alpha = _mm256_srli_epi32(ifgcolor, 24);
+				alpha = _mm256_add_epi32(alpha, _mm256_srli_epi32(alpha, 7)); // 255->256
+				__m256i inv_alpha = _mm256_sub_epi32(_mm256_set1_epi32(256), alpha);
+				__m256i m128 = _mm256_set1_epi32(128);
+
+				__m256i bgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(shade.destalpha), alpha);
+				bgalpha = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bgalpha, _mm256_slli_epi32(inv_alpha, 8)), m128), 8);
+				__m256i fgalpha = _mm256_mullo_epi32(_mm256_set1_epi32(shade.srcalpha), alpha);
+				fgalpha = _mm256_srli_epi32(_mm256_add_epi32(fgalpha, m128), 8);
+
+				__m256i out_lo = BlendChannels(fgcolor_lo, _mm256_unpacklo_epi8(bgcolor, _mm256_setzero_si256()), SplatLo(fgalpha), SplatLo(bgalpha));
+				__m256i out_hi = BlendChannels(fgcolor_hi, _mm256_unpackhi_epi8(bgcolor, _mm256_setzero_si256()), SplatHi(fgalpha), SplatHi(bgalpha));
+				return _mm256_or_si256(_mm256_packus_epi16(out_lo, out_hi), alphamask);
+			}
+		}
+
+		FORCEINLINE static __m256i VECTORCALL BlendChannels(__m256i fgcolor, __m256i bgcolor, __m256i fgalpha, __m256i bgalpha)
+		{
+			using namespace DrawWall32TModes;
+
+			fgcolor = _mm256_mullo_epi16(fgcolor, fgalpha);
+			bgcolor = _mm256_mullo_epi16(bgcolor, bgalpha);
+
+			__m256i fg_lo = _mm256_unpacklo_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_lo = _mm256_unpacklo_epi16(bgcolor, _mm256_setzero_si256());
+			__m256i fg_hi = _mm256_unpackhi_epi16(fgcolor, _mm256_setzero_si256());
+			__m256i bg_hi = _mm256_unpackhi_epi16(bgcolor, _mm256_setzero_si256());
+
+			__m256i out_lo, out_hi;
+			if (BlendT::Mode == (int)WallBlendModes::SubClamp)
+			{
+				out_lo = _mm256_sub_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_sub_epi32(fg_hi, bg_hi);
+			}
+			else if (BlendT::Mode == (int)WallBlendModes::RevSubClamp)
+			{
+				out_lo = _mm256_sub_epi32(bg_lo, fg_lo);
+				out_hi = _mm256_sub_epi32(bg_hi, fg_hi);
+			}
+			else
+			{
+				out_lo = _mm256_add_epi32(fg_lo, bg_lo);
+				out_hi = _mm256_add_epi32(fg_hi, bg_hi);
+			}
+
+			out_lo = _mm256_srai_epi32(out_lo, 8);
+			out_hi = _mm256_srai_epi32(out_hi, 8);
+			return _mm256_packs_epi32(out_lo, out_hi);
+		}
+	};
+
+	typedef DrawWall32AVX2T<DrawWall32TModes::OpaqueWall> DrawWall32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::MaskedWall> DrawWallMasked32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::AddClampWall> DrawWallAddClamp32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::SubClampWall> DrawWallSubClamp32AVX2Command;
+	typedef DrawWall32AVX2T<DrawWall32TModes::RevSubClampWall> DrawWallRevSubClamp32AVX2Command;
+}
@@ -55,6 +55,7 @@
 #include "swrenderer/drawers/r_draw_rgba.h"
 #include "r_thread.h"
 #include "r_memory.h"
+#include "tracecapture.h"
 #include "swrenderer/r_renderthread.h"
 #include "swrenderer/things/r_playersprite.h"
 #include <chrono>
@@ -63,10 +64,20 @@ EXTERN_CVAR(Int, r_clearbuffer)
 EXTERN_CVAR(Int, r_debug_draw)
 
 CVAR(Int, r_scene_multithreaded, 1, 0);
+CVAR(Bool, r_scene_adaptive, true, 0);
 CVAR(Bool, r_models, true, CVAR_ARCHIVE | CVAR_GLOBALCONFIG);
 
 namespace swrenderer
 {
+	// Per-thread timings of the last player view for the swthreads stat
+	struct SliceStat
+	{
+		int X1, X2;
+		double Busy;
+	};
+	static std::vector<SliceStat> SliceStats;
+	static double SliceWallTime;
+
 	cycle_t WallCycles, PlaneCycles, MaskedCycles;
 	
 	RenderScene::RenderScene()
@@ -186,18 +197,32 @@ namespace swrenderer
 			StartThreads(numThreads);
 		}
 
+		// Camera textures get an even split and must not disturb the layout of the player view
+		bool canvas = MainThread()->Viewport->RenderingToCanvas;
+		if (!canvas)
+			UpdateSliceEdges(numThreads);
+
 		// Setup threads:
 		std::unique_lock<std::mutex> start_lock(start_mutex);
 		for (int i = 0; i < numThreads; i++)
 		{
 			*Threads[i]->Viewport = *MainThread()->Viewport;
 			*Threads[i]->Light = *MainThread()->Light;
-			Threads[i]->X1 = viewwidth * i / numThreads;
-			Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			if (canvas)
+			{
+				Threads[i]->X1 = viewwidth * i / numThreads;
+				Threads[i]->X2 = viewwidth * (i + 1) / numThreads;
+			}
+			else
+			{
+				Threads[i]->X1 = SliceEdges[i];
+				Threads[i]->X2 = SliceEdges[i + 1];
+			}
 		}
 		run_id++;
 		FSoftwareTexture::CurrentUpdate = run_id;
 		start_lock.unlock();
+		auto start = std::chrono::steady_clock::now();
 
 		// Notify threads to run
 		if (Threads.size() > 1)
@@ -221,6 +246,18 @@ namespace swrenderer
 			finished_threads = 0;
 		}
 
+		if (!canvas)
+		{
+			SliceTimes.resize(numThreads);
+			for (int i = 0; i < numThreads; i++)
+				SliceTimes[i] = Threads[i]->SliceTime;
+
+			SliceStats.resize(numThreads);
+			for (int i = 0; i < numThreads; i++)
+				SliceStats[i] = { Threads[i]->X1, Threads[i]->X2, Threads[i]->SliceTime };
+			SliceWallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
 		// Change main thread back to covering the whole screen for player sprites
 		MainThread()->X1 = 0;
 		MainThread()->X2 = viewwidth;
@@ -228,6 +265,8 @@ namespace swrenderer
 
 	void RenderScene::RenderThreadSlice(RenderThread *thread)
 	{
+		TRACE_SCOPE("RenderThreadSlice", TRACE_Render);
+		auto start = std::chrono::steady_clock::now();
 		thread->FrameMemory->Clear();
 		thread->Clip3D->Cleanup();
 		thread->Clip3D->ResetClip(); // reset clips (floor/ceiling)
@@ -260,6 +299,8 @@ namespace swrenderer
 			thread->TranslucentPass->Render();
 		}
 
+		thread->SliceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
 #if 0 // shows the render slice edges
 		if (thread->Viewport->RenderTarget->IsBgra())
 		{
@@ -293,6 +334,49 @@ namespace swrenderer
 #endif
 	}
 
+	// Moves the slice edges so that every thread gets about the same amount of work,
+	// going by how long each slice took last frame. Within a slice all columns are
+	// assumed to cost the same, and the edges only move halfway towards the new
+	// target each frame so a single odd frame can't throw the layout around.
+	void RenderScene::UpdateSliceEdges(int numThreads)
+	{
+		double total = 0.0;
+		for (double time : SliceTimes)
+			total += time;
+
+		if (!r_scene_adaptive || numThreads == 1 || (int)SliceEdges.size() != numThreads + 1 || (int)SliceTimes.size() != numThreads ||
+			SliceEdges[numThreads] != viewwidth || total <= 0.0)
+		{
+			SliceEdges.resize(numThreads + 1);
+			for (int i = 0; i <= numThreads; i++)
+				SliceEdges[i] = viewwidth * i / numThreads;
+			return;
+		}
+
+		int minwidth = max(viewwidth / (numThreads * 8), 1);
+		std::vector<int> edges(numThreads + 1);
+		edges[0] = 0;
+		edges[numThreads] = viewwidth;
+
+		int slice = 0;
+		double before = 0.0; // cost of the slices left of 'slice'
+		for (int i = 1; i < numThreads; i++)
+		{
+			double target = total * i / numThreads;
+			while (slice < numThreads - 1 && before + SliceTimes[slice] < target)
+			{
+				before += SliceTimes[slice];
+				slice++;
+			}
+
+			double frac = SliceTimes[slice] > 0.0 ? clamp((target - before) / SliceTimes[slice], 0.0, 1.0) : 0.5;
+			double x = SliceEdges[slice] + frac * (SliceEdges[slice + 1] - SliceEdges[slice]);
+			x = (x + SliceEdges[i]) * 0.5;
+			edges[i] = clamp(xs_RoundToInt(x), edges[i - 1] + minwidth, viewwidth - (numThreads - i) * minwidth);
+		}
+		SliceEdges = std::move(edges);
+	}
+
 	void RenderScene::StartThreads(size_t numThreads)
 	{
 		while (Threads.size() < (size_t)numThreads)
@@ -425,6 +509,19 @@ namespace swrenderer
 		return out;
 	}
 
+	ADD_STAT(swthreads)
+	{
+		FString out;
+		out.Format("scene=%04.1f ms", SliceWallTime);
+		for (size_t i = 0; i < SliceStats.size(); i++)
+		{
+			const SliceStat &slice = SliceStats[i];
+			out.AppendFormat("\nthread %d: x=%4d-%4d  busy=%04.1f ms  idle=%04.1f ms", (int)i, slice.X1, slice.X2,
+				slice.Busy, max(SliceWallTime - slice.Busy, 0.0));
+		}
+		return out;
+	}
+
 	CCMD(clearwallcycles)
 	{
 		bestwallcycles = HUGE_VAL;
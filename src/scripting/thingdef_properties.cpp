@@ -189,6 +189,7 @@ bool ModActorFlag(AActor *actor, const FString &flagname, bool set, bool printer
 				if (linkchange) actor->UnlinkFromWorld(&ctx);
 				ModActorFlag(actor, fd, set);
 				if (linkchange) actor->LinkToWorld(&ctx);
+				actor->CheckEffectList();	// the FX flags live in effects
 			}
 
 			if (actor->CountsAsKill() && actor->health > 0) ++Level->total_monsters;
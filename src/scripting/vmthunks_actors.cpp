@@ -1468,6 +1468,16 @@ DEFINE_ACTION_FUNCTION_NATIVE(AActor, CheckSight, P_CheckSight)
 	ACTION_RETURN_BOOL(P_CheckSight(self, target, flags));
 }
 
+DEFINE_ACTION_FUNCTION(AActor, CheckSightMany)
+{
+	PARAM_SELF_PROLOGUE(AActor);
+	PARAM_POINTER(targets, TArray<AActor*>);
+	PARAM_POINTER(results, TArray<int>);
+	PARAM_INT(flags);
+	results->Resize(targets->Size());
+	ACTION_RETURN_INT(P_CheckSightBatch(self, targets->Data(), targets->Size(), results->Data(), flags));
+}
+
 static void GiveSecret(AActor *self, bool printmessage, bool playsound)
 {
 	P_GiveSecret(self->Level, self, printmessage, playsound, -1);
@@ -2002,6 +2012,7 @@ DEFINE_FIELD(AActor, ceilingpic)
 DEFINE_FIELD(AActor, Height)
 DEFINE_FIELD(AActor, radius)
 DEFINE_FIELD(AActor, renderradius)
+DEFINE_FIELD(AActor, TickLOD)
 DEFINE_FIELD(AActor, projectilepassheight)
 DEFINE_FIELD(AActor, tics)
 DEFINE_FIELD_NAMED(AActor, state, curstate)		// clashes with type 'state'.
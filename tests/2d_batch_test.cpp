@@ -0,0 +1,239 @@
+// Checks the command reordering of F2DDrawer::Batch on made-up command lists:
+// which commands are merged, the order of what is left, and that each merged
+// command's indices are contiguous and in drawing order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include "v_2dbatch.h"
+
+// TArray allocates through these, the engine's versions need the GC.
+#ifdef _DEBUG
+void *M_Malloc_Dbg(size_t size, const char *, int) { return malloc(size); }
+void *M_Realloc_Dbg(void *memblock, size_t size, const char *, int) { return realloc(memblock, size); }
+#else
+void *M_Malloc(size_t size) { return malloc(size); }
+void *M_Realloc(void *memblock, size_t size) { return realloc(memblock, size); }
+void *M_Calloc(size_t v1, size_t v2) { return calloc(v1, v2); }
+#endif
+void M_Free(void *memblock) { free(memblock); }
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct TestCommand
+{
+	int mTexture;
+	bool mMovable;		// false stands in for stencil, shape, line and transformed commands
+	int mVertIndex;
+	int mVertCount;
+	int mIndexIndex;
+	int mIndexCount;
+};
+
+struct TestList
+{
+	TArray<FVector2> mVertices;
+	TArray<int> mIndices;
+	TArray<TestCommand> mData;
+
+	// Adds a quad as its own command and returns its first index, which
+	// identifies it after batching.
+	int AddQuad(int texture, float x0, float y0, float x1, float y1, bool movable = true)
+	{
+		int vert = mVertices.Size();
+		mVertices.Push(FVector2(x0, y0));
+		mVertices.Push(FVector2(x1, y0));
+		mVertices.Push(FVector2(x1, y1));
+		mVertices.Push(FVector2(x0, y1));
+
+		int index = mIndices.Size();
+		static const int quad[] = { 0, 1, 2, 0, 2, 3 };
+		for (int i : quad) mIndices.Push(vert + i);
+
+		mData.Push({ texture, movable, vert, 4, index, 6 });
+		return index;
+	}
+
+	void Batch()
+	{
+		Batch2DCommands(mData, mIndices,
+			[](const TestCommand &a, const TestCommand &b) { return a.mTexture == b.mTexture; },
+			[this](const TestCommand &cmd, FVector4 &box)
+			{
+				if (!cmd.mMovable) return false;
+				box = FVector4(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+				for (int i = cmd.mIndexIndex; i < cmd.mIndexIndex + cmd.mIndexCount; i++)
+				{
+					auto &v = mVertices[mIndices[i]];
+					box.X = std::min(box.X, v.X);
+					box.Y = std::min(box.Y, v.Y);
+					box.Z = std::max(box.Z, v.X);
+					box.W = std::max(box.W, v.Y);
+				}
+				return true;
+			});
+	}
+
+	// Does command 'c' draw the quads that started at these original
+	// indices, in this order?
+	bool Draws(unsigned c, std::initializer_list<int> quads)
+	{
+		if (c >= mData.Size()) return false;
+		auto &cmd = mData[c];
+		if (cmd.mIndexCount != 6 * (int)quads.size() || cmd.mVertCount != 4 * (int)quads.size()) return false;
+		int at = cmd.mIndexIndex;
+		for (int quad : quads)
+		{
+			// The vertices are not moved, so the first index still tells the quads apart.
+			if (mIndices[at] != quad / 6 * 4) return false;
+			at += 6;
+		}
+		return true;
+	}
+};
+
+static void TestNonOverlapping()
+{
+	// A B A B side by side: one command per texture.
+	TestList list;
+	int a1 = list.AddQuad(1, 0, 0, 10, 10);
+	int b1 = list.AddQuad(2, 20, 0, 30, 10);
+	int a2 = list.AddQuad(1, 40, 0, 50, 10);
+	int b2 = list.AddQuad(2, 60, 0, 70, 10);
+	list.Batch();
+	CHECK(list.mData.Size() == 2);
+	CHECK(list.Draws(0, { a1, a2 }));
+	CHECK(list.Draws(1, { b1, b2 }));
+	CHECK(list.mIndices.Size() == 24);
+}
+
+static void TestOverlapping()
+{
+	// B covers part of both As, moving the second A in front of it would
+	// change what ends up on top.
+	TestList list;
+	int a1 = list.AddQuad(1, 0, 0, 10, 10);
+	int b = list.AddQuad(2, 5, 5, 15, 15);
+	int a2 = list.AddQuad(1, 0, 0, 10, 10);
+	list.Batch();
+	CHECK(list.mData.Size() == 3);
+	CHECK(list.Draws(0, { a1 }));
+	CHECK(list.Draws(1, { b }));
+	CHECK(list.Draws(2, { a2 }));
+}
+
+static void TestTouchingEdges()
+{
+	TestList list;
+	int a1 = list.AddQuad(1, 0, 0, 10, 10);
+	int b = list.AddQuad(2, 10, 0, 20, 10);
+	int a2 = list.AddQuad(1, 0, 10, 10, 20);
+	list.Batch();
+	CHECK(list.mData.Size() == 2);
+	CHECK(list.Draws(0, { a1, a2 }));
+	CHECK(list.Draws(1, { b }));
+}
+
+static void TestPartialOverlap()
+{
+	// B overlaps the first A but not the second, only the second has to
+	// move in front of B.
+	TestList list;
+	int a1 = list.AddQuad(1, 0, 0, 10, 10);
+	int b = list.AddQuad(2, 5, 5, 15, 15);
+	int a2 = list.AddQuad(1, 100, 100, 110, 110);
+	int c = list.AddQuad(3, 100, 100, 110, 110);
+	int a3 = list.AddQuad(1, 100, 100, 110, 110);
+	list.Batch();
+
+	// a3 overlaps c, which is drawn over a2, so it stays behind c.
+	CHECK(list.mData.Size() == 4);
+	CHECK(list.Draws(0, { a1, a2 }));
+	CHECK(list.Draws(1, { b }));
+	CHECK(list.Draws(2, { c }));
+	CHECK(list.Draws(3, { a3 }));
+}
+
+static void TestBarrier()
+{
+	// Nothing is moved over a command without bounds, even if it doesn't overlap.
+	TestList list;
+	int a1 = list.AddQuad(1, 0, 0, 10, 10);
+	int x = list.AddQuad(2, 50, 50, 60, 60, false);
+	int a2 = list.AddQuad(1, 100, 100, 110, 110);
+	int y = list.AddQuad(3, 50, 50, 60, 60);
+	int a3 = list.AddQuad(1, 0, 0, 10, 10);
+	list.Batch();
+	CHECK(list.mData.Size() == 4);
+	CHECK(list.Draws(0, { a1 }));
+	CHECK(list.Draws(1, { x }));
+	CHECK(list.Draws(2, { a2, a3 }));
+	CHECK(list.Draws(3, { y }));
+}
+
+static void TestLookback()
+{
+	// The match is further back than BATCH_LOOKBACK batches.
+	TestList list;
+	int first = list.AddQuad(1, 0, 0, 1, 1);
+	for (int i = 0; i < BATCH_LOOKBACK; i++)
+	{
+		list.AddQuad(100 + i, 2.f + i * 2, 0, 3.f + i * 2, 1);
+	}
+	int last = list.AddQuad(1, 0, 5, 1, 6);
+	list.Batch();
+	CHECK(list.mData.Size() == BATCH_LOOKBACK + 2);
+	CHECK(list.Draws(0, { first }));
+	CHECK(list.Draws(BATCH_LOOKBACK + 1, { last }));
+
+	// One less and it is found.
+	TestList near;
+	first = near.AddQuad(1, 0, 0, 1, 1);
+	for (int i = 0; i < BATCH_LOOKBACK - 1; i++)
+	{
+		near.AddQuad(100 + i, 2.f + i * 2, 0, 3.f + i * 2, 1);
+	}
+	last = near.AddQuad(1, 0, 5, 1, 6);
+	near.Batch();
+	CHECK(near.mData.Size() == BATCH_LOOKBACK);
+	CHECK(near.Draws(0, { first, last }));
+}
+
+static void TestShortList()
+{
+	TestList list;
+	int a = list.AddQuad(1, 0, 0, 10, 10);
+	int b = list.AddQuad(2, 20, 0, 30, 10);
+	list.Batch();
+	CHECK(list.mData.Size() == 2);
+	CHECK(list.Draws(0, { a }));
+	CHECK(list.Draws(1, { b }));
+}
+
+int main()
+{
+	TestNonOverlapping();
+	TestOverlapping();
+	TestTouchingEdges();
+	TestPartialOverlap();
+	TestBarrier();
+	TestLookback();
+	TestShortList();
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,227 @@
+// Runs ArchipelagoReconnect against a scripted server, the same scenarios
+// archipelago_standin lets you try by hand: drops, a server that is down for
+// a while, one that never sends RoomInfo, one that refuses the slot, and one
+// without SSL. Time is simulated in 100 ms steps.
+
+#include "archipelago_reconnect.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using Clock = ArchipelagoReconnect::Clock;
+using State = ArchipelagoConnectionState;
+using Action = ArchipelagoConnectionAction;
+
+enum class Server { UP, DOWN, MUTE, REFUSE, NO_SSL };
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+// Plays the part of ArchipelagoSocket: starts attempts and reports what the
+// server did with them.
+struct FakeSocket {
+    ArchipelagoReconnect reconnect;
+    ArchipelagoConnectionEvents events;
+    Server server = Server::UP;
+    Clock::time_point now;
+    std::vector<int> attempts;      // ms since the start, for every attempt
+    std::vector<bool> attemptSsl;
+    std::string lastFailure;
+
+    FakeSocket() : now(Clock::now()), start(now) {}
+
+    void Connect(bool ssl, bool sslFallback) {
+        reconnect.Begin(sslFallback);
+        StartAttempt(ssl);
+    }
+
+    void StartAttempt(bool ssl) {
+        events = ArchipelagoConnectionEvents();
+        attempts.push_back(Elapsed());
+        attemptSsl.push_back(ssl);
+        if (server == Server::DOWN) {
+            events.socketError = true;
+        } else if (server == Server::NO_SSL && ssl) {
+            events.socketError = true;
+            events.sslFailed = true;
+        } else {
+            events.open = true;
+            events.authenticated = server == Server::UP || server == Server::NO_SSL;
+            events.refused = server == Server::REFUSE;
+        }
+        reconnect.Attempt(ssl, now);
+    }
+
+    void Drop() {
+        events.open = false;
+        events.authenticated = false;
+    }
+
+    void Update() {
+        switch (reconnect.Update(events, now)) {
+            case Action::NONE:
+                break;
+            case Action::RETRY_WITHOUT_SSL:
+                StartAttempt(false);
+                break;
+            case Action::FAIL:
+                lastFailure = reconnect.GetFailReason();
+                Drop();
+                break;
+            case Action::GIVE_UP:
+                Drop();
+                break;
+            case Action::RETRY:
+                StartAttempt(reconnect.UseSsl());
+                break;
+        }
+    }
+
+    void Run(int ms) {
+        for (int i = 0; i < ms; i += 100) {
+            now += std::chrono::milliseconds(100);
+            Update();
+        }
+    }
+
+    int Elapsed() const {
+        return (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+    }
+
+    // Delays between the attempts made since attempt number 'from'.
+    std::vector<int> Gaps(size_t from) const {
+        std::vector<int> gaps;
+        for (size_t i = from + 1; i < attempts.size(); i++) {
+            gaps.push_back(attempts[i] - attempts[i - 1]);
+        }
+        return gaps;
+    }
+
+private:
+    Clock::time_point start;
+};
+
+static void TestConnectAndDrop() {
+    FakeSocket s;
+    s.Connect(false, false);
+    s.Run(200);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+    CHECK(s.attempts.size() == 1);
+
+    // A dropped connection is retried after the minimum delay.
+    s.Drop();
+    s.Run(100);
+    CHECK(s.reconnect.GetState() == State::RECONNECT_WAIT);
+    CHECK(s.lastFailure == "Connection lost");
+    s.Run(ArchipelagoReconnect::RETRY_MIN_DELAY_MS + 200);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+    CHECK(s.attempts.size() == 2);
+}
+
+static void TestBackoff() {
+    FakeSocket s;
+    s.Connect(false, false);
+    s.Run(200);
+
+    // The server goes away: 1, 2, 4, 8, 16 seconds, then capped at 30.
+    size_t mark = s.attempts.size() - 1;
+    s.server = Server::DOWN;
+    s.Drop();
+    s.Run(150000);
+    std::vector<int> expected = { 1000, 2000, 4000, 8000, 16000, 30000, 30000, 30000 };
+    std::vector<int> gaps = s.Gaps(mark + 1);
+    CHECK(gaps.size() >= expected.size() - 1);
+    for (size_t i = 0; i < gaps.size() && i + 1 < expected.size(); i++) {
+        // Each gap is the delay plus the step in which the attempt failed.
+        CHECK(gaps[i] >= expected[i + 1] && gaps[i] <= expected[i + 1] + 200);
+    }
+    CHECK(s.lastFailure == "Failed to connect to server");
+
+    // The server is back: the next retry connects and the delay starts over.
+    s.server = Server::UP;
+    s.Run(31000);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+    CHECK(s.reconnect.GetRetryDelay() == ArchipelagoReconnect::RETRY_MIN_DELAY_MS);
+
+    mark = s.attempts.size();
+    s.Drop();
+    s.Run(1500);
+    CHECK(s.attempts.size() == mark + 1);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+}
+
+static void TestAuthTimeout() {
+    FakeSocket s;
+    s.server = Server::MUTE;
+    s.Connect(false, false);
+    s.Run(ArchipelagoReconnect::AUTH_TIMEOUT_MS - 500);
+    CHECK(s.reconnect.GetState() == State::AUTHENTICATING);
+    s.Run(600);
+    CHECK(s.reconnect.GetState() == State::RECONNECT_WAIT);
+    CHECK(s.lastFailure == "Authentication timeout");
+}
+
+static void TestRefused() {
+    FakeSocket s;
+    s.server = Server::REFUSE;
+    s.Connect(false, false);
+    s.Run(60000);
+    CHECK(s.reconnect.GetState() == State::DISCONNECTED);
+    CHECK(s.attempts.size() == 1);
+}
+
+static void TestSslFallback() {
+    FakeSocket s;
+    s.server = Server::NO_SSL;
+    s.Connect(true, true);
+    s.Run(300);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+    CHECK(s.attempts.size() == 2);
+    CHECK(s.attemptSsl.size() == 2 && s.attemptSsl[0] && !s.attemptSsl[1]);
+
+    // Reconnects stay on plain ws://
+    s.Drop();
+    s.Run(1500);
+    CHECK(s.reconnect.GetState() == State::CONNECTED);
+    CHECK(!s.attemptSsl.back());
+
+    // wss:// given explicitly: no fallback, just retries.
+    FakeSocket t;
+    t.server = Server::NO_SSL;
+    t.Connect(true, false);
+    t.Run(200);
+    CHECK(t.reconnect.GetState() == State::RECONNECT_WAIT);
+    CHECK(t.attempts.size() == 1);
+}
+
+static void TestConnectTimeout() {
+    FakeSocket s;
+    s.Connect(false, false);
+    s.events = ArchipelagoConnectionEvents();      // the socket never opens
+    s.Run(ArchipelagoReconnect::CONNECT_TIMEOUT_MS + 100);
+    CHECK(s.reconnect.GetState() == State::RECONNECT_WAIT);
+    CHECK(s.lastFailure == "Connection timeout");
+}
+
+int main() {
+    TestConnectAndDrop();
+    TestBackoff();
+    TestAuthTimeout();
+    TestRefused();
+    TestSslFallback();
+    TestConnectTimeout();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}